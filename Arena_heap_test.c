@@ -0,0 +1,140 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			MRX OBES
+* Description: 		off-target test of the arena of a FTP session with the
+*				heap calls counted: the allocations of the FTP commands,
+*				at the sizes of every memory budget, don't reach the
+*				heap once the arena is set up. Only the calls of the
+*				objects linked with --wrap are counted, the ones made
+*				inside obexftp, OpenOBEX and libc are not. Built on the
+*				host with ositech_arena.c and ositech_budget.c:
+*				-DARENA_HEAP_COUNT -Wl,--wrap=malloc,--wrap=calloc,
+*				--wrap=realloc,--wrap=free,--wrap=strdup
+* File Name:			Arena_heap_test.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_arena.h"
+#include "ositech_budget.h"
+
+#define FAILURE	-1
+#define SUCCESS	1
+
+#define TEST_ROUNDS		100		// FTP commands after the first one
+#define TEST_NAME		"a_file_name_of_the_MRx_with_some_length.bin"
+#define TEST_PATH		"\\folder\\sub folder\\another one"
+#define TEST_REQ_SIZE	64		// an async request of ObexRequestStart
+#define TEST_STREAM_SIZE	128		// a MRx stream of a PUT, without its buffer
+
+static int test_failed = 0;
+
+static void Check(const char *name, const int value, const int expected) {
+	printf("%-48s %d, expected %d: %s\n", name, value, expected, (value == expected) ? "PASS" : "FAIL");
+	if(value != expected)
+		test_failed = 1;
+}
+
+// the arena allocations of one FTP command: a name, a path, a request, a PUT stream and its buffer
+static int FtpCommand(arena_t *arena) {
+	const size_t sizes[] = {
+		strlen(TEST_NAME)*2 + 2,
+		strlen(TEST_PATH) + 1,
+		TEST_REQ_SIZE,
+		TEST_STREAM_SIZE,
+		BudgetGet()->chunk,
+	};
+	unsigned int i;
+	char *p;
+
+	for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+		if((p = (char *)ArenaAlloc(arena, sizes[i])) == NULL)
+			return -1;
+		memset(p, 0, sizes[i]);
+	}
+	ArenaReset(arena);
+	return 0;
+}
+
+// the steady state of a session with the sizes of a budget
+static void TestSteady(const unsigned int kb) {
+	char name[64] = {};
+	arena_t arena;
+	int start, i;
+
+	BudgetSet(kb);
+	start = ArenaHeapCalls();
+	if(ArenaInit(&arena, BudgetGet()->session) < 0) {
+		printf("ArenaInit() failed\n");
+		test_failed = 1;
+		return;
+	}
+	snprintf(name, sizeof(name), "budget %u KB: heap calls of ArenaInit", kb);
+	Check(name, ArenaHeapCalls() - start, 1);
+
+	FtpCommand(&arena);
+	start = ArenaHeapCalls();
+	for(i = 0; i < TEST_ROUNDS; i++) {
+		if(FtpCommand(&arena) < 0) {
+			printf("ArenaAlloc() failed\n");
+			test_failed = 1;
+			break;
+		}
+	}
+	snprintf(name, sizeof(name), "budget %u KB: heap calls of %d commands", kb, TEST_ROUNDS);
+	Check(name, ArenaHeapCalls() - start, 0);
+	snprintf(name, sizeof(name), "budget %u KB: overflows", kb);
+	Check(name, (int)arena.overflows, 0);
+
+	ArenaRelease(&arena);
+}
+
+// the counter sees an allocation beyond the arena and its free at the reset
+static void TestOverflow(void) {
+	arena_t arena;
+	int start;
+
+	if(ArenaInit(&arena, 1024) < 0) {
+		printf("ArenaInit() failed\n");
+		test_failed = 1;
+		return;
+	}
+	start = ArenaHeapCalls();
+	ArenaAlloc(&arena, 2048);
+	ArenaReset(&arena);
+	Check("heap calls of an overflow and its reset", ArenaHeapCalls() - start, 2);
+	Check("overflows", (int)arena.overflows, 1);
+
+	start = ArenaHeapCalls();
+	ArenaRelease(&arena);
+	Check("heap calls of ArenaRelease", ArenaHeapCalls() - start, 1);
+}
+
+int main(void) {
+	debuglog_enable = 0;
+	if(ArenaHeapCalls() < 0) {
+		printf("not built with ARENA_HEAP_COUNT\n");
+		return FAILURE;
+	}
+
+	TestSteady(0);
+	TestSteady(BUDGET_MIN_KB);
+	TestSteady(4096);
+	TestOverflow();
+
+	printf("Arena heap test: %s\n", test_failed ? "FAILED" : "PASSED");
+	return test_failed ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			MRX OBES
+* Description: 		off-target test of the LED controller on its stub
+*				backend: redundant transitions are dropped, and the data
+*				activity blink starts on the byte counter and ends once
+*				the counter stops. Built on the host with
+*				ositech_led.c, ositech_timer.c and ositech_budget.c.
+* File Name:			LED_stub_test.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_bt.h"
+#include "ositech_led.h"
+
+#define FAILURE	-1
+#define SUCCESS	1
+
+// the blink ends on the second check without new bytes
+#define ACTIVITY_END_MS	(3*LED_ACTIVITY_POLL)
+
+static int test_failed = 0;
+
+static void Check(const char *name, const unsigned int expected) {
+	unsigned int transitions = LedStubTransitions();
+
+	printf("%-40s %u transitions, expected %u: %s\n", name, transitions, expected, (transitions == expected) ? "PASS" : "FAIL");
+	if(transitions != expected)
+		test_failed = 1;
+}
+
+// the same mode requested again and again is applied once
+static void TestCoalesce(void) {
+	int i;
+
+	for(i = 0; i < 5; i++)
+		LedSetMode(BT_LED_SOLID);
+	Check("SOLID x5", 1);
+
+	LedSetMode(BT_LED_FLASH_INQ);
+	LedSetMode(BT_LED_FLASH_INQ);
+	LedSetMode(BT_LED_SOLID);
+	Check("FLASH_INQ x2, SOLID", 3);
+}
+
+// bytes in SOLID start the blink, the LED is back to SOLID once they stop
+static void TestDataActivity(void) {
+	int i;
+
+	for(i = 0; i < 10; i++) {
+		LedDataActivity(4096);
+		usleep(LED_ACTIVITY_POLL*1000/4);
+	}
+	Check("data activity burst", 4);
+
+	// SOLID again while blinking doesn't stop the blink
+	LedSetMode(BT_LED_SOLID);
+	Check("SOLID while blinking", 4);
+
+	usleep(ACTIVITY_END_MS*1000);
+	Check("blink ended", 5);
+}
+
+// no blink outside of SOLID
+static void TestNoActivity(void) {
+	LedSetMode(BT_LED_FLASH_DISCOVERABLE);
+	LedDataActivity(4096);
+	usleep(ACTIVITY_END_MS*1000);
+	Check("data activity in FLASH_DISCOVERABLE", 6);
+
+	LedSetMode(BT_LED_OFF);
+	Check("OFF", 7);
+}
+
+int main(void) {
+	debuglog_enable = 0;
+	if(LedInit(LED_BACKEND_STUB, NULL) < 0) {
+		printf("LedInit() failed\n");
+		return FAILURE;
+	}
+
+	TestCoalesce();
+	TestDataActivity();
+	TestNoActivity();
+
+	printf("LED stub test: %s\n", test_failed ? "FAILED" : "PASSED");
+	return test_failed ? 1 : 0;
+}
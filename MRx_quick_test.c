@@ -24,6 +24,7 @@
 #include <net/if.h>
 #include <sys/ioctl.h>
 #include <arpa/inet.h>
+#include <time.h>
 
 #define BASE_IP "192.168.171.2"
 #define USING_PORT		2004
@@ -38,6 +39,21 @@
 #define CHAR_LF	0x0A
 
 #define MRX_STREAM_CHUNK 4096
+#define MRX_CHUNK_MAX	32768	// data chunk of the PUT, the largest buffer of the Titan
+#define WORST_PUT_SIZE	(8*1024*1024)
+
+#define HEAP_PUT_SIZE	(64*1024)
+#define HEAP_ROUNDS		3		// CD/PUT/DIR rounds after the warm up one
+
+#define STARTUP_TIMEOUT_MS	60000
+#define STARTUP_RETRY_MS	10
+
+// highest resident size of titan_obex reported by STAT, in KB
+static unsigned int titan_peak_rss = 0;
+static unsigned int titan_budget = 0;
+// heap calls of the titan_obex FTP session from "ARENA ... heap=<n>" of STAT, -1 if not counted
+static int titan_heap = -1;
+static int heap_failed = 0;
 
 /*********************************************************************** 
 * Description:
@@ -72,12 +88,13 @@ static void TestDisplayATString(const char *string) {
 * 
 * Calling Arguments: 
 * Name			Description 
+* print			print out the errors or not
 *
 * Return Value: 
 * int 		socket id
 * <0			error
 ******************************************************************************/
-int TestInitMrxSocket(void) {
+int TestInitMrxSocket(const int print) {
 	int client_sockfd;
 	struct sockaddr_in serv_addr;
 	
@@ -92,7 +109,8 @@ int TestInitMrxSocket(void) {
 	inet_aton(BASE_IP, &serv_addr.sin_addr);
 	
 	if (connect(client_sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
-		printf("%s (%d): connect Error: %s\n", __FUNCTION__, __LINE__, strerror(errno));
+		if (print) printf("%s (%d): connect Error: %s\n", __FUNCTION__, __LINE__, strerror(errno));
+		close(client_sockfd);
 		return (FAILURE);
 	}
 
@@ -324,6 +342,154 @@ end:
 	return ret;	
 }
 
+// wait for a one line response of the PUT data stream
+static int TestWaitResp(const int client_sockfd, const char *expect) {
+	char resp_string[RECV_BUFF_SIZE] = {};
+
+	if(TestReadSocket(client_sockfd, resp_string, 0) <= 0)
+		return 0;
+	return !strncmp(resp_string, expect, strlen(expect));
+}
+
+// FTP PUT of generated data in the largest chunks
+// 1: success
+// 0: failed.
+static int TestSendPUT(const int client_sockfd, char *cmd_string, const int size) {
+	char leng_string[MTU_STRING_LENG] = {};
+	char *data;
+	int total = 0, chunk, wr_sz, sent;
+	int ret = 0;
+
+	if((data = (char *)malloc(MRX_CHUNK_MAX)) == NULL) {
+		printf("Error: malloc()\n");
+		return 0;
+	}
+	memset(data, 'T', MRX_CHUNK_MAX);
+
+	if((TestSendMsg(client_sockfd, cmd_string, 1)) < 0 || !TestWaitResp(client_sockfd, "!")) {
+		printf("%s(%d): PUT refused\n", __FUNCTION__, __LINE__);
+		goto end;
+	}
+	while(total < size) {
+		chunk = (size - total < MRX_CHUNK_MAX) ? size - total : MRX_CHUNK_MAX;
+		memset(leng_string, 0, sizeof(leng_string));	// TestSendMsg() appends the CR in place
+		snprintf(leng_string, sizeof(leng_string), "%d", chunk);
+		if(TestSendMsg(client_sockfd, leng_string, 0) < 0 || !TestWaitResp(client_sockfd, "?"))
+			goto end;
+		for(sent = 0; sent < chunk; sent += wr_sz) {
+			if((wr_sz = send(client_sockfd, data + sent, chunk - sent, 0)) <= 0)
+				goto end;
+		}
+		if(!TestWaitResp(client_sockfd, "!"))
+			goto end;
+		total += chunk;
+	}
+	memset(leng_string, 0, sizeof(leng_string));
+	snprintf(leng_string, sizeof(leng_string), "%d", 0);
+	if(TestSendMsg(client_sockfd, leng_string, 0) > 0 && TestWaitResp(client_sockfd, "200 FTP"))
+		ret = 1;
+
+end:
+	free(data);
+	printf("%d bytes sent\n", total);
+	return ret;
+}
+
+// FTP STAT, the "MEM budget=<KB> rss=<KB> peak=<KB>" line gives the memory use of titan_obex
+// 1: success
+// 0: failed.
+static int TestSendSTAT(const int client_sockfd, char *cmd_string) {
+	char resp_string[RECV_BUFF_SIZE] = {};
+	unsigned int budget, rss, peak;
+	char *pmem;
+
+	titan_heap = -1;
+
+	if((TestSendMsg(client_sockfd, cmd_string, 1)) < 0) {
+		printf("%s(%d): SendMsg Failed\n", __FUNCTION__, __LINE__);
+		return 0;
+	}
+	while (TestReadSocket(client_sockfd, resp_string, 1) > 0) {
+		if((pmem = strstr(resp_string, "MEM budget=")) != NULL &&
+				sscanf(pmem, "MEM budget=%u rss=%u peak=%u", &budget, &rss, &peak) == 3) {
+			titan_budget = budget;
+			if(peak > titan_peak_rss)
+				titan_peak_rss = peak;
+		}
+		if((pmem = strstr(resp_string, " heap=")) != NULL)
+			sscanf(pmem, " heap=%d", &titan_heap);
+		if(strstr(resp_string, "200 FTP"))
+			return 1;
+		else if(strstr(resp_string, " FTP"))
+			return 0;
+		memset(resp_string, 0, sizeof(resp_string));
+	}
+
+	return 0;
+}
+
+// FTP CD
+// 1: success
+// 0: failed.
+static int TestSendCD(const int client_sockfd, char *cmd_string) {
+	if((TestSendMsg(client_sockfd, cmd_string, 1)) < 0) {
+		printf("%s(%d): SendMsg Failed\n", __FUNCTION__, __LINE__);
+		return 0;
+	}
+	return TestWaitResp(client_sockfd, "200 FTP");
+}
+
+/*********************************************************************** 
+* Description:
+* The code of titan_obex in the FTP command loop must not use the heap
+* once it runs, its memory comes from the session arena. After a warm up
+* round of CD/PUT/DIR the heap calls reported by STAT must not change over
+* more rounds. Only the calls of titan_obex itself are counted, the
+* objects of obexftp and OpenOBEX are still allocated by the libraries.
+* Needs titan_obex built with ARENA_HEAP_COUNT, skipped otherwise.
+* 
+* Calling Arguments: 
+* Name			Description 
+* client_sockfd	the open socket id
+*
+* Return Value: 
+* 1			no heap call in the steady state
+* 0			skipped, titan_obex doesn't count the heap calls
+* -1			heap calls found, or a command failed
+******************************************************************************/
+static int TestHeapSteady(const int client_sockfd) {
+	char cmd_string[128] = {};
+	int round, start = -1;
+
+	for(round = 0; round <= HEAP_ROUNDS; round++) {
+		snprintf(cmd_string, sizeof(cmd_string), "%s", "CD \\");
+		if(!TestSendCD(client_sockfd, cmd_string))
+			return -1;
+		memset(cmd_string, 0, sizeof(cmd_string));
+		snprintf(cmd_string, sizeof(cmd_string), "%s", "PUT \"heap_test.bin\"");
+		if(!TestSendPUT(client_sockfd, cmd_string, HEAP_PUT_SIZE))
+			return -1;
+		memset(cmd_string, 0, sizeof(cmd_string));
+		snprintf(cmd_string, sizeof(cmd_string), "%s", "DIR-RAW");
+		if(!TestSendDIR(client_sockfd, cmd_string))
+			return -1;
+		memset(cmd_string, 0, sizeof(cmd_string));
+		snprintf(cmd_string, sizeof(cmd_string), "%s", "STAT");
+		if(!TestSendSTAT(client_sockfd, cmd_string))
+			return -1;
+		memset(cmd_string, 0, sizeof(cmd_string));
+		if(titan_heap < 0) {
+			printf("titan_obex not built with ARENA_HEAP_COUNT, heap check skipped\n");
+			return 0;
+		}
+		if(round == 0)
+			start = titan_heap;
+	}
+
+	printf("Heap calls in %d CD/PUT/DIR rounds: %d\n", HEAP_ROUNDS, titan_heap - start);
+	return (titan_heap == start) ? 1 : -1;
+}
+
 static void TestStartMrxObex(const int client_sockfd, const int titan_mtu, uint8_t times) {
 	char cmd_string[128] = {};
 	
@@ -335,6 +501,27 @@ static void TestStartMrxObex(const int client_sockfd, const int titan_mtu, uint8
 		printf("DIR-RAW Failed.\n");
 	printf("--------\n");
 
+	// worst case of the Titan memory: the largest data chunks, then the memory report
+	memset(cmd_string, 0, sizeof(cmd_string));
+	snprintf(cmd_string, sizeof(cmd_string), "%s", "PUT \"quick_test.bin\"");
+	if(TestSendPUT(client_sockfd, cmd_string, WORST_PUT_SIZE))
+		printf("PUT Finished.\n");
+	else
+		printf("PUT Failed.\n");
+	memset(cmd_string, 0, sizeof(cmd_string));
+	snprintf(cmd_string, sizeof(cmd_string), "%s", "STAT");
+	if(TestSendSTAT(client_sockfd, cmd_string))
+		printf("Peak RSS of titan_obex: %u KB (memory.budget %u KB)\n", titan_peak_rss, titan_budget);
+	else
+		printf("STAT Failed.\n");
+	printf("--------\n");
+
+	if(TestHeapSteady(client_sockfd) < 0) {
+		printf("Heap check Failed.\n");
+		heap_failed = 1;
+	}
+	printf("--------\n");
+
 	sleep(30*times);
 	
 	memset(cmd_string, 0, sizeof(cmd_string));
@@ -343,7 +530,98 @@ static void TestStartMrxObex(const int client_sockfd, const int titan_mtu, uint8
 	printf("Exit from StartMrxObex\n");
 }
 
-int main() {
+static unsigned long long TestNowMs(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// send the AT command and read till its final response
+// 1: OK, 0: BUSY, -1: error
+static int TestSendAT(const int client_sockfd, const char *at_cmd) {
+	char cmd_string[64] = {};
+	char resp_string[RECV_BUFF_SIZE] = {};
+
+	snprintf(cmd_string, sizeof(cmd_string), "%s", at_cmd);
+	if(TestSendMsg(client_sockfd, cmd_string, 0) < 0)
+		return -1;
+	while(TestReadSocket(client_sockfd, resp_string, 0) > 0) {
+		if(strstr(resp_string, "BUSY"))
+			return 0;
+		if(strstr(resp_string, "OK"))
+			return 1;
+		if(strstr(resp_string, "ERROR"))
+			return -1;
+		memset(resp_string, 0, sizeof(resp_string));
+	}
+	return -1;
+}
+
+/*********************************************************************** 
+* Description:
+* Startup benchmark of the Titan. The daemon is started by the given
+* command (or is being started when the benchmark is run), and the time
+* to the MRx listener, to the first AT response and to the adapter ready
+* (AT+BTF? not answered BUSY) is measured.
+* 
+* Calling Arguments: 
+* Name			Description 
+* daemon_cmd		command starting titan_obex, NULL if started elsewhere
+*
+* Return Value: 
+* 0			success
+* -1			the Titan is not ready in time
+******************************************************************************/
+static int TestStartupBench(const char *daemon_cmd) {
+	unsigned long long start = TestNowMs();
+	unsigned long long listen_ms, first_ms;
+	int client_sockfd;
+	int res;
+	pid_t pid;
+
+	if(daemon_cmd) {
+		if((pid = fork()) == 0) {
+			execl("/bin/sh", "sh", "-c", daemon_cmd, (char *)NULL);
+			_exit(127);
+		} else if(pid < 0) {
+			printf("fork() failed: %s\n", strerror(errno));
+			return -1;
+		}
+	}
+
+	while((client_sockfd = TestInitMrxSocket(0)) < 0) {
+		if(TestNowMs() - start > STARTUP_TIMEOUT_MS) {
+			printf("No MRx listener after %d ms\n", STARTUP_TIMEOUT_MS);
+			return -1;
+		}
+		usleep(STARTUP_RETRY_MS*1000);
+	}
+	listen_ms = TestNowMs() - start;
+
+	if(TestSendAT(client_sockfd, "ATE0") < 0) {
+		printf("ATE0 failed\n");
+		close(client_sockfd);
+		return -1;
+	}
+	first_ms = TestNowMs() - start;
+
+	while((res = TestSendAT(client_sockfd, "AT+BTF?")) == 0) {
+		if(TestNowMs() - start > STARTUP_TIMEOUT_MS)
+			break;
+		usleep(STARTUP_RETRY_MS*1000);
+	}
+	close(client_sockfd);
+
+	printf("Listener: %llu ms, first AT response: %llu ms, ", listen_ms, first_ms);
+	if(res > 0)
+		printf("adapter ready: %llu ms\n", TestNowMs() - start);
+	else
+		printf("adapter NOT ready\n");
+	return (res > 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
 	int client_sockfd;
 	int send_sz = 0;
 	int recv_sz = 0;
@@ -360,8 +638,12 @@ int main() {
 
 	printf("Version: %.1f\n", VERSION);
 	printf("*************\n");
+
+	// -b [command starting titan_obex]: startup benchmark only
+	if(argc > 1 && !strcmp(argv[1], "-b"))
+		return TestStartupBench(argc > 2 ? argv[2] : NULL) ? 1 : 0;
 	
-	client_sockfd = TestInitMrxSocket();
+	client_sockfd = TestInitMrxSocket(1);
 	if (client_sockfd <= 0)
 		goto exit;
 
@@ -432,9 +714,11 @@ int main() {
 	}
 	
 exit:
+	if(titan_peak_rss)
+		printf("Peak RSS of titan_obex: %u KB (memory.budget %u KB)\n", titan_peak_rss, titan_budget);
 	printf("End of MRx simulation.\n");
 	shutdown(client_sockfd, SHUT_RDWR);
 	free(cmd_string);
-	return 0;
+	return heap_failed ? 1 : 0;
 }
 
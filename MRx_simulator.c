@@ -14,6 +14,7 @@
 * Changes:
 **********************************************************************/
 
+#define _FILE_OFFSET_BITS 64	// files beyond 2GB
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -338,14 +339,28 @@ static int ReadSocket(const int sock_fd, char *resp_string, const int print) {
 * Return Value: 
 * void
 ******************************************************************************/
-static void DisplayProgress(const int filesize, const int sentsize) {
-	int percent = 0;
+static void DisplayProgress(const long long filesize, const long long sentsize) {
+	int percent = 100;
 
-	percent = (float)sentsize / filesize * 100;
+	if(filesize > 0)
+		percent = sentsize * 100 / filesize;
 	printf("%d%%\b\b%c", percent, (percent<10) ? '\0':'\b');
 	fflush(stdout);
 }
 
+// CRC32 (IEEE) of the sent data, to check the digest returned in the PUT result
+static unsigned int MRxCrc32(unsigned int crc, const unsigned char *p, int leng) {
+	int i;
+
+	crc = ~crc;
+	while(leng--) {
+		crc ^= *p++;
+		for(i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
 /*********************************************************************** 
 * Description:
 * The followings are the command sent to the Titan to accomplish the bluetooth operation.
@@ -361,12 +376,16 @@ static void DisplayProgress(const int filesize, const int sentsize) {
 static int PutFile(const int client_sockfd, const char *filename, const int mtu, const int error_test) {
 	int fd;
 	char *buff = NULL;
-	char resp[32] = {};
+	char resp[RECV_BUFF_SIZE] = {};
 	char data__leng[MTU_STRING_LENG] = {}; // max is mtu which could be a 32 int at the max
-	int rd_sz, wr_sz, recv_sz, total_wr;
+	char crc_string[MTU_STRING_LENG] = {};
+	char *pcrc;
+	unsigned int crc = 0;
+	int rd_sz, wr_sz, recv_sz;
+	long long total_wr = 0;
 	int diff = 0;
 	int ret = 0;
-	int file_size = 0;
+	long long file_size = 0;
 
 	buff = (char *)malloc(mtu*sizeof(char));
 	if (!buff) {
@@ -387,7 +406,7 @@ static int PutFile(const int client_sockfd, const char *filename, const int mtu,
 	printf("Sending file of size ...");
 	fflush(stdout);
 	total_wr = 0;
-	while((rd_sz = read(fd, buff, mtu))) { 
+	while((rd_sz = read(fd, buff, mtu)) > 0) { 
 		DisplayProgress(file_size, total_wr);
 	//	printf("total_rd: %d\n", total_rd += rd_sz);
 
@@ -437,6 +456,7 @@ static int PutFile(const int client_sockfd, const char *filename, const int mtu,
 			break;
 		}
 
+		crc = MRxCrc32(crc, (unsigned char *)buff, wr_sz);
 		total_wr += wr_sz;
 //		printf("total_wr: %d\n", total_wr += wr_sz);
 //		printf("-------\n");
@@ -465,6 +485,15 @@ done:
 			if(!strncmp(resp, "200 FTP", strlen("200 FTP")))	{
 				printf("PUT %s done\n", filename);
 				ret = 1;
+				// "200 FTP <bytes> CRC32:<hex>" if the Titan computes the CRC32 digest
+				snprintf(crc_string, sizeof(crc_string), "%lld CRC32:%08x", total_wr, crc);
+				if((pcrc = strstr(resp, "CRC32:")) != NULL) {
+					if(strncmp(resp + strlen("200 FTP "), crc_string, strlen(crc_string))) {
+						printf("Digest mismatch, sent %s\n", crc_string);
+						ret = 0;
+					} else
+						printf("Digest verified\n");
+				}
 			}
 		}	 	
 		else if (rd_sz < 0)
@@ -475,6 +504,28 @@ done:
 //	exit(ret);
 }
 
+// the statistics are sent line by line, ended by the FTP response
+static int SendSTAT(const int client_sockfd, char *cmd_string) {
+	char resp_string[RECV_BUFF_SIZE] = {};
+	int recv_sz = 0;
+
+	if((SendMsg(client_sockfd, cmd_string, 1)) < 0) {
+		printf("%s(%d): SendMsg Failed\n", __FUNCTION__, __LINE__);
+		return 0;
+	}
+	while ((recv_sz = ReadSocket(client_sockfd, resp_string, 1)) > 0) {
+		if(strstr(resp_string, "200 FTP"))
+			return 1;
+		else if(strstr(resp_string, " FTP"))
+			return 0;
+		memset(resp_string, 0, sizeof(resp_string));
+	}
+	if (recv_sz < 0)
+		printf("ReadSocket Failed\n");
+
+	return 0;
+}
+
 static void SendOther(const int client_sockfd, char *cmd_string) {
 	char resp_string[RECV_BUFF_SIZE] = {};
 	int recv_sz = 0;
@@ -899,6 +950,11 @@ static void StartMrxObex(const int client_sockfd, const int titan_mtu) {
 				printf("ABORT Success.\n");
 			else
 				printf("ABORT Failed.\n");
+		}
+		// FTP STAT
+		else if(!strcmp(up_cmd, "STAT")) {
+			if(!SendSTAT(client_sockfd, cmd_string))
+				printf("STAT Failed.\n");
 		} else {
 			SendOther(client_sockfd, cmd_string);
 		}
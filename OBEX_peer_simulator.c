@@ -0,0 +1,635 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+/***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			MRX OBES
+* Description: 		minimal OBEX FTP server standing in for the phone, over
+*				TCP or a socketpair, to run titan_obex and wl_bluetooth_tool
+*				without Bluetooth hardware.
+* File Name:			OBEX_peer_simulator.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#define _FILE_OFFSET_BITS 64	// files beyond 2GB
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openobex/obex.h>
+#include <openobex/obex_const.h>
+
+#define PEER_PORT		650		// OBEX over TCP
+#define PEER_ROOT_TEMPLATE	"/tmp/obex_peer.XXXXXX"
+#define PEER_NAME_LENG	256
+#define PEER_CONNECTION_ID	1
+#define PEER_FOLDER_LISTING	"x-obex/folder-listing"
+
+#define FAILURE	-1
+#define SUCCESS	1
+
+// Folder Browsing target of the OBEX FTP service
+static const uint8_t PEER_UUID_FBS[16] = {0xF9, 0xEC, 0x7B, 0xC4, 0x95, 0x3C, 0x11, 0xD2, 0x98, 0x4E, 0x52, 0x54, 0x00, 0xDC, 0x9E, 0x09};
+
+typedef struct peer_option {
+	int port;
+	int mtu;
+	unsigned int latency_ms;		// before every response
+	unsigned int packet_delay_us;	// on every OBEX packet
+	char root[PATH_MAX];
+	const char *exec_cmd;		// run over a socketpair instead of TCP
+} peer_option;
+
+typedef struct peer_session {
+	char cwd[PATH_MAX];	// relative to the root, "" at the root
+	int connected;
+	int done;
+	int put_fd;
+	char put_name[PEER_NAME_LENG];
+	unsigned long long put_bytes;
+	// benchmark of the session
+	struct timeval start;
+	unsigned long long rx_bytes;
+	unsigned long long tx_bytes;
+	unsigned int packets;
+	unsigned int puts, gets, setpaths;
+} peer_session;
+
+static peer_option opt = {
+	.port = PEER_PORT,
+	.mtu = OBEX_DEFAULT_MTU,
+};
+
+static void Usage(void) {
+	printf("OBEX_peer_simulator [-p port] [-m mtu] [-l latency_ms] [-d packet_delay_us] [-r root] [-e cmd]\n");
+	printf("\t-p\tTCP port, default %d\n", PEER_PORT);
+	printf("\t-m\tOBEX MTU, default %d\n", OBEX_DEFAULT_MTU);
+	printf("\t-l\tdelay in ms before every response\n");
+	printf("\t-d\tdelay in us on every OBEX packet\n");
+	printf("\t-r\tdirectory storing the files, default a new %s\n", PEER_ROOT_TEMPLATE);
+	printf("\t-e\trun cmd with $OBEX_PEER_FD connected to the simulator through a socketpair,\n");
+	printf("\t\te.g. -e 'wl_bluetooth_tool -t fd:$OBEX_PEER_FD -f 00:00:00:00:00:01 put test.txt'\n");
+}
+
+static unsigned long long ElapsedMs(const struct timeval *start) {
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000ULL + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+/***********************************************************************
+* Description:
+* Build the path of a name in the current folder. The names come from
+* the client, anything leaving the folder is refused.
+*
+* Calling Arguments:
+* Name			Description
+* session		the session
+* name		the name, NULL for the current folder itself
+* path		store the full path
+* path_leng	the size of path
+*
+* Return Value:
+* 0: success
+* -1: the name is invalid
+******************************************************************************/
+static int PeerPath(const peer_session *session, const char *name, char *path, const int path_leng) {
+	if(name && (!strlen(name) || strchr(name, '/') || !strcmp(name, ".") || !strcmp(name, "..")))
+		return -1;
+
+	snprintf(path, path_leng, "%s%s%s%s%s", opt.root, strlen(session->cwd) ? "/" : "", session->cwd, name ? "/" : "", name ? name : "");
+	return 0;
+}
+
+// NAME and TYPE headers of the request, "" if there is none
+static void PeerGetHeaders(obex_t *handle, obex_object_t *object, char *name, const int name_leng, char *type, const int type_leng) {
+	obex_headerdata_t hv;
+	uint8_t hi;
+	uint32_t hlen;
+
+	*name = '\0';
+	if(type)
+		*type = '\0';
+	while(OBEX_ObjectGetNextHeader(handle, object, &hi, &hv, &hlen)) {
+		if(hi == OBEX_HDR_NAME && hlen > 0 && hlen/2 < name_leng)
+			OBEX_UnicodeToChar((uint8_t *)name, hv.bs, hlen);
+		else if(hi == OBEX_HDR_TYPE && type && hlen < type_leng) {
+			memcpy(type, hv.bs, hlen);
+			type[hlen] = '\0';
+		}
+	}
+}
+
+static void PeerConnect(obex_t *handle, obex_object_t *object, peer_session *session) {
+	obex_headerdata_t hv;
+	uint8_t hi;
+	uint32_t hlen;
+	int target = 0;
+
+	while(OBEX_ObjectGetNextHeader(handle, object, &hi, &hv, &hlen)) {
+		if(hi == OBEX_HDR_TARGET && hlen == sizeof(PEER_UUID_FBS) && !memcmp(hv.bs, PEER_UUID_FBS, hlen))
+			target = 1;
+	}
+	if(!target) {
+		printf("CONNECT without the Folder Browsing target\n");
+		OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_ACCEPTABLE, OBEX_RSP_NOT_ACCEPTABLE);
+		return;
+	}
+
+	hv.bs = PEER_UUID_FBS;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_WHO, hv, sizeof(PEER_UUID_FBS), OBEX_FL_FIT_ONE_PACKET);
+	hv.bq4 = PEER_CONNECTION_ID;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_CONNECTION, hv, sizeof(uint32_t), OBEX_FL_FIT_ONE_PACKET);
+	OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+
+	session->connected = 1;
+	session->cwd[0] = '\0';
+	printf("CONNECT\n");
+}
+
+/***********************************************************************
+* Description:
+* SETPATH. flags bit 0 goes to the parent folder, bit 1 forbids to
+* create the folder. No name at all goes back to the root.
+******************************************************************************/
+static void PeerSetPath(obex_t *handle, obex_object_t *object, peer_session *session) {
+	char name[PEER_NAME_LENG] = {};
+	char path[PATH_MAX];
+	uint8_t *nonhdr = NULL;
+	uint8_t flags = 0;
+	struct stat st;
+	char *pslash;
+
+	session->setpaths++;
+	if(OBEX_ObjectGetNonHdrData(object, &nonhdr) >= 2)
+		flags = nonhdr[0];
+	PeerGetHeaders(handle, object, name, sizeof(name), NULL, 0);
+	printf("SETPATH flags 0x%02x \"%s\"\n", flags, name);
+
+	if(flags & 0x01) {
+		if((pslash = strrchr(session->cwd, '/')) != NULL)
+			*pslash = '\0';
+		else
+			session->cwd[0] = '\0';
+		OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+		return;
+	}
+	if(!strlen(name)) {
+		session->cwd[0] = '\0';
+		OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+		return;
+	}
+
+	if(PeerPath(session, name, path, sizeof(path)) < 0) {
+		OBEX_ObjectSetRsp(object, OBEX_RSP_FORBIDDEN, OBEX_RSP_FORBIDDEN);
+		return;
+	}
+	if(stat(path, &st) < 0) {
+		if((flags & 0x02) || mkdir(path, 0755) < 0) {
+			OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_FOUND, OBEX_RSP_NOT_FOUND);
+			return;
+		}
+	} else if(!S_ISDIR(st.st_mode)) {
+		OBEX_ObjectSetRsp(object, OBEX_RSP_FORBIDDEN, OBEX_RSP_FORBIDDEN);
+		return;
+	}
+
+	if(strlen(session->cwd) + strlen(name) + 2 > sizeof(session->cwd)) {
+		OBEX_ObjectSetRsp(object, OBEX_RSP_FORBIDDEN, OBEX_RSP_FORBIDDEN);
+		return;
+	}
+	if(strlen(session->cwd))
+		strcat(session->cwd, "/");
+	strcat(session->cwd, name);
+	OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+}
+
+/***********************************************************************
+* Description:
+* Body of a PUT. The body is streamed straight into the file, the file is
+* created on the first chunk, once the NAME header is known.
+******************************************************************************/
+static void PeerPutData(obex_t *handle, obex_object_t *object, peer_session *session) {
+	char path[PATH_MAX];
+	const uint8_t *buf = NULL;
+	int leng;
+
+	if((leng = OBEX_ObjectReadStream(handle, object, &buf)) < 0)
+		return;
+
+	if(session->put_fd < 0 && !session->put_name[0]) {
+		PeerGetHeaders(handle, object, session->put_name, sizeof(session->put_name), NULL, 0);
+		if(PeerPath(session, session->put_name, path, sizeof(path)) < 0 ||
+				(session->put_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+			printf("PUT \"%s\" can't be created\n", session->put_name);
+			OBEX_ObjectSetRsp(object, OBEX_RSP_FORBIDDEN, OBEX_RSP_FORBIDDEN);
+			return;
+		}
+	}
+	if(session->put_fd < 0 || leng == 0)
+		return;
+
+	if(write(session->put_fd, buf, leng) != leng) {
+		printf("PUT \"%s\" write() failed -- %s\n", session->put_name, strerror(errno));
+		close(session->put_fd);
+		session->put_fd = -1;
+		OBEX_ObjectSetRsp(object, OBEX_RSP_INTERNAL_SERVER_ERROR, OBEX_RSP_INTERNAL_SERVER_ERROR);
+		return;
+	}
+	session->put_bytes += leng;
+	session->rx_bytes += leng;
+}
+
+static void PeerPutDone(obex_t *handle, obex_object_t *object, peer_session *session) {
+	char path[PATH_MAX];
+
+	session->puts++;
+	if(session->put_fd >= 0) {
+		close(session->put_fd);
+		session->put_fd = -1;
+		printf("PUT \"%s\" %llu bytes\n", session->put_name, session->put_bytes);
+		OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+	} else if(!session->put_name[0]) {
+		// no body at all, it's a DELETE
+		PeerGetHeaders(handle, object, session->put_name, sizeof(session->put_name), NULL, 0);
+		if(PeerPath(session, session->put_name, path, sizeof(path)) < 0 || (unlink(path) < 0 && rmdir(path) < 0))
+			OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_FOUND, OBEX_RSP_NOT_FOUND);
+		else
+			OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+		printf("DELETE \"%s\"\n", session->put_name);
+	}
+	session->put_name[0] = '\0';
+	session->put_bytes = 0;
+}
+
+// x-obex/folder-listing of the current folder
+static char *PeerFolderListing(const peer_session *session, size_t *leng) {
+	char path[PATH_MAX];
+	char file[PATH_MAX];
+	char modified[32];
+	struct dirent *entry;
+	struct stat st;
+	FILE *listing;
+	char *buf = NULL;
+	DIR *dir;
+
+	PeerPath(session, NULL, path, sizeof(path));
+	if((dir = opendir(path)) == NULL)
+		return NULL;
+	if((listing = open_memstream(&buf, leng)) == NULL) {
+		closedir(dir);
+		return NULL;
+	}
+
+	fprintf(listing, "<?xml version=\"1.0\"?>\n<!DOCTYPE folder-listing SYSTEM \"obex-folder-listing.dtd\">\n<folder-listing version=\"1.0\">\n");
+	if(strlen(session->cwd))
+		fprintf(listing, "<parent-folder/>\n");
+	while((entry = readdir(dir)) != NULL) {
+		if(entry->d_name[0] == '.')
+			continue;
+		snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+		if(stat(file, &st) < 0)
+			continue;
+		strftime(modified, sizeof(modified), "%Y%m%dT%H%M%SZ", gmtime(&st.st_mtime));
+		fprintf(listing, "<%s name=\"%s\" size=\"%llu\" modified=\"%s\"/>\n", S_ISDIR(st.st_mode) ? "folder" : "file",
+			entry->d_name, (unsigned long long)st.st_size, modified);
+	}
+	fprintf(listing, "</folder-listing>\n");
+
+	fclose(listing);
+	closedir(dir);
+	return buf;
+}
+
+static void PeerGet(obex_t *handle, obex_object_t *object, peer_session *session) {
+	char name[PEER_NAME_LENG] = {};
+	char type[64] = {};
+	char path[PATH_MAX];
+	obex_headerdata_t hv;
+	struct stat st;
+	char *buf = NULL;
+	size_t leng = 0;
+	int fd;
+
+	session->gets++;
+	PeerGetHeaders(handle, object, name, sizeof(name), type, sizeof(type));
+	printf("GET \"%s\" type \"%s\"\n", name, type);
+
+	if(!strcmp(type, PEER_FOLDER_LISTING)) {
+		buf = PeerFolderListing(session, &leng);
+	} else if(PeerPath(session, name, path, sizeof(path)) == 0 && (fd = open(path, O_RDONLY)) >= 0) {
+		// a GET body is built in memory, far below the 4GB of a header
+		if(fstat(fd, &st) == 0 && st.st_size < UINT32_MAX && (buf = (char *)malloc(st.st_size + 1)) != NULL) {
+			if(read(fd, buf, st.st_size) == st.st_size)
+				leng = st.st_size;
+			else {
+				free(buf);
+				buf = NULL;
+			}
+		}
+		close(fd);
+	}
+
+	if(buf == NULL) {
+		OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_FOUND, OBEX_RSP_NOT_FOUND);
+		return;
+	}
+
+	hv.bq4 = leng;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_LENGTH, hv, sizeof(uint32_t), 0);
+	hv.bs = (const uint8_t *)buf;
+	OBEX_ObjectAddHeader(handle, object, OBEX_HDR_BODY, hv, leng, 0);
+	OBEX_ObjectSetRsp(object, OBEX_RSP_CONTINUE, OBEX_RSP_SUCCESS);
+	session->tx_bytes += leng;
+	free(buf);
+}
+
+static void PeerRequest(obex_t *handle, obex_object_t *object, const int obex_cmd, peer_session *session) {
+	if(opt.latency_ms)
+		usleep(opt.latency_ms * 1000);
+
+	switch(obex_cmd) {
+		case OBEX_CMD_CONNECT:
+			PeerConnect(handle, object, session);
+			break;
+		case OBEX_CMD_DISCONNECT:
+			printf("DISCONNECT\n");
+			OBEX_ObjectSetRsp(object, OBEX_RSP_SUCCESS, OBEX_RSP_SUCCESS);
+			break;
+		case OBEX_CMD_SETPATH:
+			PeerSetPath(handle, object, session);
+			break;
+		case OBEX_CMD_PUT:
+			PeerPutDone(handle, object, session);
+			break;
+		case OBEX_CMD_GET:
+			PeerGet(handle, object, session);
+			break;
+		default:
+			OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_IMPLEMENTED, OBEX_RSP_NOT_IMPLEMENTED);
+			break;
+	}
+}
+
+static void PeerAbort(peer_session *session) {
+	char path[PATH_MAX];
+
+	printf("ABORT\n");
+	if(session->put_fd >= 0) {
+		close(session->put_fd);
+		session->put_fd = -1;
+		if(PeerPath(session, session->put_name, path, sizeof(path)) == 0)
+			unlink(path);
+	}
+	session->put_name[0] = '\0';
+	session->put_bytes = 0;
+}
+
+static void PeerEvent(obex_t *handle, obex_object_t *object, int mode, int event, int obex_cmd, int obex_rsp) {
+	peer_session *session = (peer_session *)OBEX_GetUserData(handle);
+	obex_t *conn;
+
+	switch(event) {
+		case OBEX_EV_ACCEPTHINT:
+			// one client at a time, the next one waits in the listen queue
+			if((conn = OBEX_ServerAccept(handle, PeerEvent, NULL)) != NULL) {
+				OBEX_SetTransportMTU(conn, opt.mtu, opt.mtu);
+				*(obex_t **)OBEX_GetUserData(handle) = conn;
+			}
+			break;
+		case OBEX_EV_REQHINT:
+			switch(obex_cmd) {
+				case OBEX_CMD_PUT:
+					OBEX_ObjectReadStream(handle, object, NULL);	// stream the body into the file
+					// no break
+				case OBEX_CMD_CONNECT:
+				case OBEX_CMD_DISCONNECT:
+				case OBEX_CMD_SETPATH:
+				case OBEX_CMD_GET:
+					OBEX_ObjectSetRsp(object, OBEX_RSP_CONTINUE, OBEX_RSP_SUCCESS);
+					break;
+				default:
+					OBEX_ObjectSetRsp(object, OBEX_RSP_NOT_IMPLEMENTED, OBEX_RSP_NOT_IMPLEMENTED);
+					break;
+			}
+			break;
+		case OBEX_EV_REQCHECK:
+			OBEX_ObjectSetRsp(object, OBEX_RSP_CONTINUE, OBEX_RSP_SUCCESS);
+			break;
+		case OBEX_EV_STREAMAVAIL:
+			PeerPutData(handle, object, session);
+			break;
+		case OBEX_EV_REQ:
+			PeerRequest(handle, object, obex_cmd, session);
+			break;
+		case OBEX_EV_REQDONE:
+			if(obex_cmd == OBEX_CMD_DISCONNECT)
+				session->done = 1;
+			break;
+		case OBEX_EV_PROGRESS:
+			session->packets++;
+			if(opt.packet_delay_us)
+				usleep(opt.packet_delay_us);
+			break;
+		case OBEX_EV_ABORT:
+			PeerAbort(session);
+			break;
+		case OBEX_EV_LINKERR:
+		case OBEX_EV_PARSEERR:
+			printf("Link error %d, the session is closed\n", event);
+			PeerAbort(session);
+			session->done = 1;
+			break;
+	}
+}
+
+static void PeerSessionInit(peer_session *session) {
+	memset(session, 0, sizeof(peer_session));
+	session->put_fd = -1;
+	gettimeofday(&session->start, NULL);
+}
+
+static void PeerSessionReport(const peer_session *session) {
+	unsigned long long msec = ElapsedMs(&session->start);
+
+	printf("Session: %llu ms, rx %llu bytes, tx %llu bytes, %u packets, %u PUT, %u GET, %u SETPATH, %llu kbps\n",
+		msec, session->rx_bytes, session->tx_bytes, session->packets, session->puts, session->gets, session->setpaths,
+		msec ? (session->rx_bytes + session->tx_bytes) * 8 / msec : 0);
+	printf("--------\n");
+}
+
+// serve the session on the connected handle until it's closed
+static void PeerServe(obex_t *conn, peer_session *session) {
+	while(!session->done) {
+		if(OBEX_HandleInput(conn, 1) < 0) {
+			printf("OBEX_HandleInput failed, the session is closed\n");
+			break;
+		}
+	}
+	PeerSessionReport(session);
+}
+
+static int RunInet(void) {
+	struct sockaddr_in addr;
+	peer_session session;
+	obex_t *server;
+	obex_t *conn = NULL;
+
+	if((server = OBEX_Init(OBEX_TRANS_INET, PeerEvent, 0)) == NULL) {
+		printf("Error: OBEX_Init()\n");
+		return FAILURE;
+	}
+	OBEX_SetUserData(server, &conn);
+	OBEX_SetTransportMTU(server, opt.mtu, opt.mtu);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(opt.port);
+	if(OBEX_ServerRegister(server, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		printf("Error: OBEX_ServerRegister() port %d -- %s\n", opt.port, strerror(errno));
+		OBEX_Cleanup(server);
+		return FAILURE;
+	}
+	printf("Waiting for OBEX clients on port %d\n", opt.port);
+
+	while(1) {
+		if(OBEX_HandleInput(server, 1) < 0)
+			break;
+		if(conn == NULL)
+			continue;
+
+		PeerSessionInit(&session);
+		OBEX_SetUserData(conn, &session);
+		PeerServe(conn, &session);
+		OBEX_Cleanup(conn);
+		conn = NULL;
+	}
+
+	OBEX_Cleanup(server);
+	return FAILURE;
+}
+
+/***********************************************************************
+* Description:
+* Run the given command with one end of a socketpair in $OBEX_PEER_FD, and
+* serve the other end. No TCP stack in the way, the link is as fast as the
+* box can copy.
+******************************************************************************/
+static int RunSocketpair(const char *cmd) {
+	peer_session session;
+	char fd_string[16] = {};
+	obex_t *conn;
+	int sv[2];
+	pid_t pid;
+	int status = -1;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		printf("Error: socketpair() -- %s\n", strerror(errno));
+		return FAILURE;
+	}
+
+	if((pid = fork()) < 0) {
+		printf("Error: fork() -- %s\n", strerror(errno));
+		return FAILURE;
+	}
+	if(pid == 0) {
+		close(sv[0]);
+		snprintf(fd_string, sizeof(fd_string), "%d", sv[1]);
+		setenv("OBEX_PEER_FD", fd_string, 1);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	close(sv[1]);
+
+	if((conn = OBEX_Init(OBEX_TRANS_FD, PeerEvent, 0)) == NULL) {
+		printf("Error: OBEX_Init()\n");
+		goto end;
+	}
+	PeerSessionInit(&session);
+	OBEX_SetUserData(conn, &session);
+	if(FdOBEX_TransportSetup(conn, sv[0], sv[0], opt.mtu) < 0) {
+		printf("Error: FdOBEX_TransportSetup()\n");
+		OBEX_Cleanup(conn);
+		goto end;
+	}
+	PeerServe(conn, &session);
+	OBEX_Cleanup(conn);
+
+end:
+	close(sv[0]);
+	while(waitpid(pid, &status, 0) < 0 && errno == EINTR);
+	printf("%s exits %d\n", cmd, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+	return WIFEXITED(status) && !WEXITSTATUS(status) ? SUCCESS : FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+	int c;
+
+	while((c = getopt(argc, argv, "d:e:hl:m:p:r:")) != -1) {
+		switch(c) {
+			case 'd':
+				opt.packet_delay_us = atoi(optarg);
+				break;
+			case 'e':
+				opt.exec_cmd = optarg;
+				break;
+			case 'l':
+				opt.latency_ms = atoi(optarg);
+				break;
+			case 'm':
+				opt.mtu = atoi(optarg);
+				if(opt.mtu < 255 || opt.mtu > OBEX_MAXIMUM_MTU) {
+					printf("MTU must be within 255 and %d\n", OBEX_MAXIMUM_MTU);
+					exit(1);
+				}
+				break;
+			case 'p':
+				opt.port = atoi(optarg);
+				break;
+			case 'r':
+				snprintf(opt.root, sizeof(opt.root), "%s", optarg);
+				break;
+			case 'h':
+			default:
+				Usage();
+				exit(1);
+		}
+	}
+
+	if(!strlen(opt.root)) {
+		snprintf(opt.root, sizeof(opt.root), "%s", PEER_ROOT_TEMPLATE);
+		if(mkdtemp(opt.root) == NULL) {
+			printf("Error: mkdtemp() -- %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+	signal(SIGPIPE, SIG_IGN);
+	printf("Files are stored in %s. MTU %d, latency %u ms, packet delay %u us\n", opt.root, opt.mtu, opt.latency_ms, opt.packet_delay_us);
+
+	if(opt.exec_cmd)
+		return RunSocketpair(opt.exec_cmd) == SUCCESS ? 0 : 1;
+
+	return RunInet() == SUCCESS ? 0 : 1;
+}
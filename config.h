@@ -17,6 +17,7 @@
 #define _CONFIG_H
 
 #define CONFIG_FILE	"/mnt/flash/config/conf/bt_obex.conf"
+#define READY_FILE	"/var/run/titan_obex.ready"	// "<pid> <ms to ready>", written once the adapter is ready
 
 // inactive.timeout
 #define ONE_MINUTE	60
@@ -27,6 +28,35 @@
 #define DEBUGLOG_OFF	0
 #define DEFAULT_DEBUGLOG_ENABLE	DEBUGLOG_ON
 
+// led.backend, led.path
+#define LED_BACKEND_KEY_EXEC	"exec"
+#define LED_BACKEND_KEY_SYSFS	"sysfs"
+#define LED_BACKEND_KEY_STUB	"stub"
+
+// obex.transport
+#define OBEX_TRANSPORT_KEY_BT	"bt"
+#define OBEX_TRANSPORT_KEY_INET	"inet"
+#define OBEX_TRANSPORT_KEY_FD	"fd"
+
+// obex.channel, the RFCOMM channel in the OBEX File Transfer record
+#define DEFAULT_OBEX_CHANNEL	10
+
+// digest.type
+#define DIGEST_KEY_CRC32	"crc32"
+#define DIGEST_KEY_SHA256	"sha256"
+#define DIGEST_KEY_NONE	"none"
+
+// memory.budget, in KB
+#define DEFAULT_MEMORY_BUDGET	0	// not bounded
+
+// inquiry.results, inquiry.length in units of 1.28 s
+#define DEFAULT_INQUIRY_RESULTS	16
+#define DEFAULT_INQUIRY_LENGTH	8
+
+// discovery.interval, discovery.age in s
+#define DEFAULT_DISCOVERY_INTERVAL	0	// no discovery in the background
+#define DEFAULT_DISCOVERY_AGE	0	// 3 intervals
+
 int debuglog_enable;
 
 #endif
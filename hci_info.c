@@ -26,6 +26,8 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <poll.h>
+#include <pthread.h>
 #include <debuglog.h>
 
 #include <bluetooth/bluetooth.h>
@@ -35,10 +37,35 @@
 #include "ositech_bt.h"
 #include "ositech_communication.h"
 #include "config.h"
+#include "ositech_budget.h"
 #include "hci_info.h"
 
 #define HCI_INFO_STRING_SIZE	64
 #define HCI_INFO_FILENAME_SIZE	64
+#define HCI_INFO_EVENT_SIZE		HCI_MAX_EVENT_SIZE + 1
+
+/*
+ the adapter as last read from the kernel. The lookups are served from here,
+ the HCI monitor drops it when the adapter is added, removed, brought up or
+ down, or when its scan mode or state is changed, and the next lookup reads
+ it again.
+*/
+typedef struct hci_state {
+	int dev_id;		// -1: no adapter
+	bdaddr_t bdaddr;
+	uint32_t flags;
+	char dir[HCI_INFO_FILENAME_SIZE];	// STORAGEDIR/<adapter address>
+} hci_state_t;
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t monitor_once = PTHREAD_ONCE_INIT;
+static hci_state_t state;
+static int state_valid = 0;
+static unsigned int state_gen = 0;		// bumped by every invalidation
+static int monitor_running = 0;		// the cache is only kept while the monitor runs
+
+static int GetHciState(hci_state_t *cur);
+
 /*********************************************************************** 
 * Description:
 * Open a Bluetooth HCI socket.
@@ -86,36 +113,261 @@ static void CloseHCISocket(const int ctl) {
 * di		the varible to store the get device information
 *
 * Return Value: 
-* 0:		error
+* 0:		error or no adapter
 * 1: 		success
 ******************************************************************************/
 static int GetHCIDevInfo(const int ctl, struct hci_dev_info *di) {
 	int i;
-	struct hci_dev_list_req *dl;
-	struct hci_dev_req *dr;
+	struct {
+		uint16_t dev_num;
+		struct hci_dev_req dev_req[BT_DEV_NUM];
+	} dl;
 
-	if (!(dl = malloc(HCI_MAX_DEV * sizeof(struct hci_dev_req) + sizeof(uint16_t)))) {
-		perror("Can't allocate memory");
-		return 0;
-	}
-	memset(dl, 0, BT_DEV_NUM*sizeof(struct hci_dev_req) + sizeof(uint16_t));
-	dl->dev_num = BT_DEV_NUM;
-	dr = dl->dev_req;
+	memset(&dl, 0, sizeof(dl));
+	dl.dev_num = BT_DEV_NUM;
 	
-	if (ioctl(ctl, HCIGETDEVLIST, (void *) dl) < 0) {
+	if (ioctl(ctl, HCIGETDEVLIST, (void *) &dl) < 0) {
 		perror("Can't get device list");
-		free(dl);
 		return 0;
 	}
 
-	for (i = 0; i< dl->dev_num; i++) {
-		di->dev_id = (dr+i)->dev_id;
-		if (ioctl(ctl, HCIGETDEVINFO, (void *) di) < 0) {
-			continue;
+	for (i = 0; i < dl.dev_num; i++) {
+		di->dev_id = dl.dev_req[i].dev_id;
+		if (ioctl(ctl, HCIGETDEVINFO, (void *) di) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+// read the adapter from the kernel, the only place doing syscalls for a lookup
+static void HciStateLoad(hci_state_t *load) {
+	struct hci_dev_info di;
+	char btaddr_string[HCI_INFO_STRING_SIZE] = {};
+	int ctl;
+
+	memset(load, 0, sizeof(hci_state_t));
+	load->dev_id = -1;
+	if((ctl = OpenHCISocket())) {
+		memset(&di, 0, sizeof(di));
+		if(GetHCIDevInfo(ctl, &di)) {
+			load->dev_id = di.dev_id;
+			bacpy(&load->bdaddr, &di.bdaddr);
+			load->flags = di.flags;
+			ba2str(&di.bdaddr, btaddr_string);
 		}
+		CloseHCISocket(ctl);
 	}
+	snprintf(load->dir, sizeof(load->dir), "%s/%s", STORAGEDIR, btaddr_string);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci%d %s flags 0x%x\n", __FUNCTION__, load->dev_id, btaddr_string, load->flags);
+}
 
-	return 1;
+/*********************************************************************** 
+* Description:
+* Drop the cached adapter, the next lookup reads it from the kernel. Called
+* by the HCI monitor, and by the code changing the adapter on its own so the
+* change is seen at once.
+* 
+* Calling Arguments: 
+* Name			Description 
+* none
+*
+* Return Value: 
+* none
+******************************************************************************/
+void HciStateInvalidate(void) {
+	pthread_mutex_lock(&state_lock);
+	state_valid = 0;
+	state_gen++;
+	pthread_mutex_unlock(&state_lock);
+}
+
+// an event changing the cached adapter
+static int HciEventChangesState(const unsigned char *buf, const int len) {
+	hci_event_hdr *hdr;
+	evt_cmd_complete *cc;
+	evt_stack_internal *si;
+	uint16_t ocf;
+
+	if(len < 1 + HCI_EVENT_HDR_SIZE || buf[0] != HCI_EVENT_PKT)
+		return 0;
+	hdr = (hci_event_hdr *)(buf + 1);
+
+	switch(hdr->evt) {
+		case EVT_STACK_INTERNAL:
+			si = (evt_stack_internal *)(buf + 1 + HCI_EVENT_HDR_SIZE);
+			return (len >= 1 + HCI_EVENT_HDR_SIZE + EVT_STACK_INTERNAL_SIZE && si->type == EVT_SI_DEVICE);
+		case EVT_CMD_COMPLETE:
+			if(len < 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_COMPLETE_SIZE)
+				return 0;
+			cc = (evt_cmd_complete *)(buf + 1 + HCI_EVENT_HDR_SIZE);
+			if(cmd_opcode_ogf(btohs(cc->opcode)) != OGF_HOST_CTL)
+				return 0;
+			ocf = cmd_opcode_ocf(btohs(cc->opcode));
+			return (ocf == OCF_WRITE_SCAN_ENABLE || ocf == OCF_WRITE_AUTH_ENABLE ||
+				ocf == OCF_WRITE_ENCRYPT_MODE || ocf == OCF_RESET);
+		default:
+			return 0;
+	}
+}
+
+// raw HCI socket bound to dev_id (HCI_DEV_NONE for the device events), only passing evt
+static int OpenHCIMonitor(const int dev_id, const int evt) {
+	struct sockaddr_hci addr;
+	struct hci_filter flt;
+	int sk;
+
+	if((sk = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI)) < 0)
+		return -1;
+
+	hci_filter_clear(&flt);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &flt);
+	hci_filter_set_event(evt, &flt);
+	memset(&addr, 0, sizeof(addr));
+	addr.hci_family = AF_BLUETOOTH;
+	addr.hci_dev = dev_id;
+	if(setsockopt(sk, SOL_HCI, HCI_FILTER, &flt, sizeof(flt)) < 0 ||
+		bind(sk, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sk);
+		return -1;
+	}
+
+	return sk;
+}
+
+/*********************************************************************** 
+* Description:
+* HCI monitor. The device events (added, removed, up, down) only reach a
+* socket bound to no adapter, the command completes only one bound to the
+* adapter, so there is one socket for each. The adapter socket follows the
+* adapter as it comes and goes.
+* 
+* Calling Arguments: 
+* Name			Description 
+* arg		the socket of the device events
+*
+* Return Value: 
+* NULL
+******************************************************************************/
+static void *HciMonitor(void *arg) {
+	unsigned char buf[HCI_INFO_EVENT_SIZE];
+	struct pollfd pfd[2];
+	hci_state_t cur;
+	int dev_sk = -1, dev_bound = -1;
+	int len, i;
+
+	pfd[0].fd = (int)(long)arg;
+	pfd[0].events = POLLIN;
+
+	for(;;) {
+		GetHciState(&cur);
+		if(cur.dev_id != dev_bound) {
+			if(dev_sk >= 0)
+				close(dev_sk);
+			dev_sk = -1;
+			// without the adapter socket a scan mode change would be missed
+			if(cur.dev_id >= 0 && (dev_sk = OpenHCIMonitor(cur.dev_id, EVT_CMD_COMPLETE)) < 0)
+				break;
+			dev_bound = cur.dev_id;
+			// events missed while the socket was opened
+			HciStateInvalidate();
+		}
+		pfd[1].fd = dev_sk;
+		pfd[1].events = POLLIN;
+		pfd[0].revents = pfd[1].revents = 0;
+
+		if(poll(pfd, 2, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		if(pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+			break;
+
+		for(i = 0; i < 2; i++) {
+			if(!(pfd[i].revents & POLLIN))
+				continue;
+			if((len = read(pfd[i].fd, buf, sizeof(buf))) > 0 && HciEventChangesState(buf, len))
+				HciStateInvalidate();
+		}
+		// the adapter went away, HCI_DEV_UNREG on the other socket tells which one is next
+		if(dev_sk >= 0 && (pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+			close(dev_sk);
+			dev_sk = -1;
+			dev_bound = -1;
+			HciStateInvalidate();
+		}
+	}
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s stops, adapter lookups go to the kernel\n", __FUNCTION__);
+	pthread_mutex_lock(&state_lock);
+	monitor_running = 0;
+	state_valid = 0;
+	pthread_mutex_unlock(&state_lock);
+	if(dev_sk >= 0)
+		close(dev_sk);
+	close(pfd[0].fd);
+	return NULL;
+}
+
+static void HciMonitorStart(void) {
+	pthread_attr_t attr;
+	pthread_t thread;
+	int sk;
+
+	if((sk = OpenHCIMonitor(HCI_DEV_NONE, EVT_STACK_INTERNAL)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s HCI monitor socket failed, the adapter is not cached\n", __FUNCTION__);
+		return;
+	}
+
+	// set before the thread starts, its first lookup fills the cache
+	monitor_running = 1;
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, HciMonitor, (void *)(long)sk) != 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s pthread_create() failed, the adapter is not cached\n", __FUNCTION__);
+		monitor_running = 0;
+		close(sk);
+	}
+	pthread_attr_destroy(&attr);
+}
+
+/*********************************************************************** 
+* Description:
+* Get the adapter. It comes from memory while the HCI monitor runs and no
+* event has changed the adapter; otherwise it is read from the kernel, and
+* kept unless the adapter was changed during the read.
+* 
+* Calling Arguments: 
+* Name			Description 
+* cur		store the adapter
+*
+* Return Value: 
+* 0:	success
+* -1:	no adapter, cur->dev_id is -1
+******************************************************************************/
+static int GetHciState(hci_state_t *cur) {
+	unsigned int gen;
+
+	pthread_once(&monitor_once, HciMonitorStart);
+
+	pthread_mutex_lock(&state_lock);
+	if(!state_valid) {
+		gen = state_gen;
+		pthread_mutex_unlock(&state_lock);
+		HciStateLoad(cur);
+		pthread_mutex_lock(&state_lock);
+		if(gen == state_gen && monitor_running) {
+			state = *cur;
+			state_valid = 1;
+		}
+	} else {
+		*cur = state;
+	}
+	pthread_mutex_unlock(&state_lock);
+
+	return (cur->dev_id < 0) ? -1 : 0;
 }
 
 /*********************************************************************** 
@@ -131,21 +383,12 @@ static int GetHCIDevInfo(const int ctl, struct hci_dev_info *di) {
 * 1: 		discoverable
 ******************************************************************************/
 int GetBTDevDiscov(void) {
-	int ctl, disc = 0;
-	struct hci_dev_info di;
+	hci_state_t cur;
 
-	if((ctl = OpenHCISocket())) {	
-		if (GetHCIDevInfo(ctl, &di)) {
-		//	if(di.flags & BT_ISCAN_BIT || di.flags & BT_PSCAN_BIT)
-			if(di.flags & BT_ISCAN_BIT)
-				disc = 1;
-			else
-				disc = 0;
-		}
-		CloseHCISocket(ctl);
-	}
-
-	return disc;
+	if(GetHciState(&cur) < 0)
+		return 0;
+//	if(cur.flags & BT_ISCAN_BIT || cur.flags & BT_PSCAN_BIT)
+	return (cur.flags & BT_ISCAN_BIT) ? 1 : 0;
 }
 /*********************************************************************** 
 * Description:
@@ -160,20 +403,10 @@ int GetBTDevDiscov(void) {
 * void
 ******************************************************************************/
 void GetBTFilePath(char *fullpath, const char *filename) {
-	struct hci_dev_info di;
-	char btaddr_string[HCI_INFO_STRING_SIZE] = {};
-	int ctl, ret;
-	
-	if((ctl = OpenHCISocket())) {
-		ret = GetHCIDevInfo(ctl, &di);
-		ba2str(&di.bdaddr, btaddr_string);
-	//	if (ret) 
-	//		printf("HCI device: %s\n", btaddr_string);
+	hci_state_t cur;
 
-		CloseHCISocket(ctl);
-	}
-	
-	snprintf(fullpath, HCI_INFO_FILENAME_SIZE*sizeof(char), "%s/%s/%s", STORAGEDIR, btaddr_string, filename);
+	GetHciState(&cur);
+	snprintf(fullpath, HCI_INFO_FILENAME_SIZE*sizeof(char), "%s/%s", cur.dir, filename);
 }
 
 /*********************************************************************** 
@@ -189,36 +422,19 @@ void GetBTFilePath(char *fullpath, const char *filename) {
 * else: 	dev_id
 ******************************************************************************/
 int GetBTDevID(void) {
-	int ctl;
-	int ret = -1;
-	struct hci_dev_info di;
+	hci_state_t cur;
 
-	if((ctl = OpenHCISocket())) {
-		ret = GetHCIDevInfo(ctl, &di);
-		
-		if (ret) {
-		//	printf("HCI device: %s\n", di.name);
-			ret = di.dev_id;
-		}
-		CloseHCISocket(ctl);
-	}
-
-	return ret;
+	GetHciState(&cur);
+	return cur.dev_id;
 }
 
 int GetBTDevAdd(bdaddr_t *addr) {
-	int ctl,  ret= 0;
-	struct hci_dev_info di;
+	hci_state_t cur;
 
-	if((ctl = OpenHCISocket())) {	
-		ret = GetHCIDevInfo(ctl, &di);
-		if (ret) {
-			bacpy(addr, &di.bdaddr);	
-		}
-		CloseHCISocket(ctl);
-	}
-
-	return ret;
+	if(GetHciState(&cur) < 0)
+		return 0;
+	bacpy(addr, &cur.bdaddr);
+	return 1;
 }
 /*********************************************************************** 
 * Description:
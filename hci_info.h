@@ -29,5 +29,6 @@ extern int GetBTDevID(void);
 extern void GetBTFilePath(char *fullpath, const char *filename);
 extern int GetBTDevDiscov(void);
 extern int GetBTDevAdd(bdaddr_t *addr);
+extern void HciStateInvalidate(void);
 
 #endif
\ No newline at end of file
@@ -23,11 +23,28 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/un.h>
 #include <debuglog.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+#include <bluetooth/sdp.h>
+#include <bluetooth/sdp_lib.h>
 
 #include "ositech_communication.h"
 #include "ositech_obex.h"
 #include "ositech_bt.h"
+#include "ositech_led.h"
+#include "ositech_digest.h"
+#include "ositech_fanout.h"
+#include "ositech_budget.h"
+#include "ositech_stats.h"
+#include "ositech_inquiry.h"
+#include "ositech_discovery.h"
+#include "ositech_pair.h"
+#include "sdp_op.h"
 #include "config.h"
 
 #define FAILURE	-1
@@ -41,6 +58,8 @@
 #define AT_ARG_LENG	512
 #define FTP_SUCC_SIZE	128
 
+#define ADAPTER_RETRY_MS	500		// wait for the Bluetooth adapter to come up
+
 static char *BT_cmd_string[] = {
 	NULL,
 	"Disable Echo",
@@ -54,9 +73,183 @@ static char *BT_cmd_string[] = {
 	"List Trusted Devices",
 	"Initiate Pairing",
 	"Start FTP Session",
-	"Load Friendly Name"
+	"Load Friendly Name",
+	"Fan-out PUT"
 };
 
+// OBEX sessions at the same time of AT+BTFAN, 0 for the most the adapter has
+static int fanout_links = 0;
+
+// discovery in the background, started once the adapter is ready
+static int discovery_interval = DEFAULT_DISCOVERY_INTERVAL;
+static int discovery_age = DEFAULT_DISCOVERY_AGE;
+static int obex_channel = DEFAULT_OBEX_CHANNEL;
+
+// the adapter is initialized in the background, commands needing it are answered BUSY till then
+static pthread_mutex_t adapter_lock = PTHREAD_MUTEX_INITIALIZER;
+static int adapter_ready = 0;
+static unsigned long long start_us = 0;
+
+/***********************************************************************
+* Description:
+* Tell the init system about the state of the daemon. The sd_notify()
+* datagram is sent if NOTIFY_SOCKET is set, and READY_FILE is written once
+* the daemon is ready, for an init script waiting on it.
+*
+* Calling Arguments:
+* Name			Description
+* state		"STATUS=..." or "READY=1"
+*
+* Return Value:
+* None
+******************************************************************************/
+static void NotifyInit(const char *state) {
+	const char *path = getenv("NOTIFY_SOCKET");
+	struct sockaddr_un sun;
+	FILE *ready_file;
+	int fd;
+
+	if(path && (*path == '/' || *path == '@') && strlen(path) < sizeof(sun.sun_path) &&
+			(fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) >= 0) {
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		memcpy(sun.sun_path, path, strlen(path));
+		if(*path == '@')
+			sun.sun_path[0] = '\0';	// abstract socket
+		sendto(fd, state, strlen(state), MSG_NOSIGNAL, (struct sockaddr *)&sun, offsetof(struct sockaddr_un, sun_path) + strlen(path));
+		close(fd);
+	}
+
+	if(!strcmp(state, "READY=1") && (ready_file = fopen(READY_FILE, "w")) != NULL) {
+		fprintf(ready_file, "%d %llu\n", getpid(), (StatsNow() - start_us) / 1000);
+		fclose(ready_file);
+	}
+}
+
+static int AdapterIsReady(void) {
+	int ready;
+
+	pthread_mutex_lock(&adapter_lock);
+	ready = adapter_ready;
+	pthread_mutex_unlock(&adapter_lock);
+	return ready;
+}
+
+// echo, S-registers and hang up are answered without the adapter
+static int AdapterNeeded(const int cmd) {
+	return cmd != BT_NO_ECHO && cmd != BT_REGISTERS && cmd != BT_HANG && cmd != BT_CMD_UNKNOWN;
+}
+
+/***********************************************************************
+* Description:
+* Initialize the Bluetooth adapter while the MRx listener already takes
+* connections: wait for the adapter, set the friendly name and register
+* the OBEX FTP record. A missing adapter doesn't stall the daemon, it's
+* waited for.
+*
+* Calling Arguments:
+* Name			Description
+* arg		not used
+*
+* Return Value:
+* NULL
+******************************************************************************/
+static void *AdapterInit(void *arg) {
+	char *pname = NULL;
+	int waiting = 0;
+	int ret;
+
+	// off Bluetooth (obex.transport=) the OBEX peer doesn't need the adapter
+	while(ObexTransportIsBT() && hci_get_route(NULL) < 0) {
+		if(!waiting++) {
+			printf("Waiting for the Bluetooth adapter\n");
+			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: no Bluetooth adapter, waiting for it\n", __FUNCTION__);
+		}
+		usleep(ADAPTER_RETRY_MS*1000);
+	}
+
+	ret = BTLoadName(&pname);
+	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s BTLoadName() returns %d\n", __FUNCTION__, ret);
+	if (ret > 0) {
+		BTSetName(pname);
+		free(pname);
+		pname = NULL;
+	}
+
+	// the session to the SDP server stays open, the OBEX FTP record is registered over it for every FTP session
+	if(SdpLocalConnect(obex_channel) < 0)
+		printf("Register OBEX FTP service failed. Using add_obex_service.\n");
+
+	if(ObexTransportIsBT() && DiscoveryStart(discovery_interval, discovery_age) < 0)
+		printf("The setting of discovery.interval is too small. Using %d s.\n", DISCOVERY_INTERVAL_MIN);
+
+	pthread_mutex_lock(&adapter_lock);
+	adapter_ready = 1;
+	pthread_mutex_unlock(&adapter_lock);
+
+	printf("Bluetooth adapter ready in %llu ms\n", (StatsNow() - start_us) / 1000);
+	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Bluetooth adapter ready in %llu ms\n", __FUNCTION__, (StatsNow() - start_us) / 1000);
+	NotifyInit("READY=1");
+	return NULL;
+}
+
+/***********************************************************************
+* Description:
+* AT+BTFAN=<file>,<addr>,<addr>... PUT a local file to every given device.
+* A "FAN <addr> <FTP code> <stage> <ms>" line is sent for every device.
+*
+* Calling Arguments:
+* Name			Description
+* cli_sockfd		the open socket id
+* arg		the argument of the AT command
+*
+* Return Value:
+* None
+******************************************************************************/
+static void FanoutCmd(const int cli_sockfd, char *arg) {
+	fanout_result results[FANOUT_MAX_PEERS];
+	char resp[RESP_BUFF_SIZE] = {};
+	char *pfile, *paddr, *psave = NULL;
+	int npeers = 0, index, code;
+
+	memset(results, 0, sizeof(results));
+	arg[strcspn(arg, "\r\n")] = '\0';
+	if((pfile = strtok_r(arg, ",", &psave)) == NULL) {
+		SendResponse(cli_sockfd, "ERROR 02");
+		return;
+	}
+	while((paddr = strtok_r(NULL, ",", &psave)) != NULL && npeers < FANOUT_MAX_PEERS) {
+		snprintf(results[npeers].addr, sizeof(results[npeers].addr), "%s", paddr);
+		if(!strchr(results[npeers].addr, ':'))
+			AddrStringAddColumn(results[npeers].addr);
+		npeers++;
+	}
+	if(!npeers) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BT device is not given.\n", __FUNCTION__);
+		SendResponse(cli_sockfd, "ERROR 01");
+		return;
+	}
+
+	if(FanoutPut(pfile, results, npeers, fanout_links) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: %s can't be read.\n", __FUNCTION__, pfile);
+		SendResponse(cli_sockfd, "ERROR 02");
+		return;
+	}
+
+	for(index = 0; index < npeers; index++) {
+		if(results[index].res > 0)
+			code = BT_FTP_SERVICE_SUCCESS;
+		else if(results[index].res == 0)
+			code = BT_FTP_SERVICE_UNAUTHORIZED;
+		else
+			code = BT_FTP_SERVICE_INTERNAL_SERVER_ERROR;
+		snprintf(resp, sizeof(resp), "FAN %s %d %s %u", results[index].addr, code,
+			FanoutStageString(results[index].stage), results[index].ms);
+		SendResponse(cli_sockfd, resp);
+	}
+	SendResponse(cli_sockfd, "OK");
+}
+
 /*********************************************************************** 
 * Description:
 * Parsing the AT command issued by the user to the Titan unit accordingly.
@@ -75,6 +268,7 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 	char ftp_succ[FTP_SUCC_SIZE] = {};
 	char arg[AT_ARG_LENG] = {};
 	int led_org = 0;
+	int ret = 0;
 	
 	while((cmd = RecvCmd(cli_sockfd, arg, 0)) > 0) {
 #ifdef DEBUG
@@ -91,7 +285,11 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Command - Unknown\n", __FUNCTION__);
 		}
 			
-		switch (cmd) {
+		// the MRx retries the command once the adapter is ready
+		if(!AdapterIsReady() && AdapterNeeded(cmd)) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Bluetooth adapter is not ready.\n", __FUNCTION__);
+			SendResponse(cli_sockfd, "BUSY");
+		} else switch (cmd) {
 			case BT_NO_ECHO:
 				SendResponse(cli_sockfd, "OK");
 				break;
@@ -165,9 +363,12 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 			case BT_INQUIRE:
 				led_org = GetCurBTLed();
 				SetBTLed(BT_LED_FLASH_INQ);
-				if(BTGetInq(cli_sockfd)) {
+				if((ret = BTGetInq(cli_sockfd, arg)) > 0) {
 					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTGetInq() is done successfully.\n", __FUNCTION__);
 					SendResponse(cli_sockfd, "OK");
+				} else if(ret < 0) {
+					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTGetInq() is failed because the given Argument is invalid.\n", __FUNCTION__);
+					SendResponse(cli_sockfd, "ERROR 02");
 				} else {
 					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTGetInq() is failed because the BT hardware is not found.\n", __FUNCTION__);
 					SendResponse(cli_sockfd, "ERROR 05");
@@ -201,52 +402,39 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 				break;
 			case BT_INIT_PAIR:
 			{
-				int init = 0, res = 0;
-				char resp[128] = {};
+				int res = 0, progress = 0;
 				char addr[BT_ADDR_LENGTH] = {};
-				char *pstring = NULL;
+				char *popt = NULL;
 
+				// AT+BTW=<addr>[,PROGRESS], PROGRESS for the "PAIRING" lines of the stages
+				if((popt = strchr(arg, ',')) != NULL) {
+					*popt++ = '\0';
+					progress = !strcmp(popt, "PROGRESS");
+				}
 				snprintf(addr, sizeof(addr), "%s", arg);
 				AddrStringAddColumn(addr);
 				if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Pairing BT device address %s.\n", __FUNCTION__, addr);
-			//	res = BTInitPair(arg, &init);
-				if((pstring = GetPairingDeviceName(addr)) == NULL) {
-					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Get friendly name of %s failed\n", __FUNCTION__, addr);
-					printf("WARNING: Get friendly name of %s Failed\n", addr);
-				}
-				
-				led_org = GetCurBTLed();
-				usleep(1000);
-				
-				SetBTLed(BT_LED_SOLID);
-				res = BTInitPair(addr, &init);
-				if (init) {
-					SendResponse(cli_sockfd, "OK"); // start pairing
-					if(debuglog_enable) {
-						if(res == 0)  {
-							debuglog(LOG_INFO, "[titan_obex] %s: BTInitPair() is done successfully.\n", __FUNCTION__);
-							//sleep(20);
-							if(pstring) UpdatePairedDevice(addr, pstring);
-						} else 
-							debuglog(LOG_INFO, "[titan_obex] %s: BTInitPair() is failed in PAIRing.\n", __FUNCTION__);
-					}
-					if (res > 2) res = 2;
-					snprintf(resp, sizeof(resp), "PAIR %d %s%s", res, arg, (!res)?" 00" : "\0");		
-					SendResponse(cli_sockfd, resp); 
+				// the page, the name and the authentication go on in the background, "PAIR" is sent when they are done
+				if((res = BTInitPair(cli_sockfd, addr, arg, progress)) == 0) {
+					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTInitPair() is started successfully.\n", __FUNCTION__);
+				} else if(res == 1) {
+					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTInitPair() is failed because a pairing is running.\n", __FUNCTION__);
+					SendResponse(cli_sockfd, "BUSY");
 				} else {
 					if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: BTInitPair() is failed because the given Address is invalid.\n", __FUNCTION__);
 					SendResponse(cli_sockfd, "ERROR 01"); // didn't start pairing
 				}
-				if(!access(PINCODE_FILE, F_OK))
-					unlink(PINCODE_FILE); // delete PIN code file, no matter if the pairing is successed or not.
-
-				SetBTLed(led_org);
-				if(pstring) free(pstring);
 				break;
 			}
 			case BT_START_FTP:
 				ftp_start = 1;
 				break;
+			case BT_FANOUT_PUT:
+				led_org = GetCurBTLed();
+				SetBTLed(BT_LED_SOLID);
+				FanoutCmd(cli_sockfd, arg);
+				SetBTLed(led_org);
+				break;
 			default:
 				if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: The issued AT command is unknown.\n", __FUNCTION__);
 				SendResponse(cli_sockfd, "ERROR 00");
@@ -255,7 +443,7 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 		if (ftp_start) {
 			unsigned char *client = NULL;
 			char addr[BT_ADDR_LENGTH] = {};
-			int res = 0;
+			int res = 0, sdp_script = 0;
 
 			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Starting FTP session.\n", __FUNCTION__);
 			if(ParseATDArg(arg, addr) < 0) {
@@ -276,7 +464,10 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 			
 			led_org = GetCurBTLed();
 			SetBTLed(BT_LED_SOLID);
-			if((res = SearchBTwithObex(addr, &chanel)) < 0) {
+			// no SDP off Bluetooth, the OBEX peer is given by obex.transport
+			if(!ObexTransportIsBT())
+				chanel = 0;
+			else if((res = SearchBTwithObex(addr, &chanel)) < 0) {
 				ftp_start = 0;
 				printf("Search OBEX service on %s failed\n", arg);
 				if (res == ERROR) {
@@ -303,10 +494,13 @@ static void connection_handler(int cli_sockfd, const uint inactive_timeout) {
 			snprintf(ftp_succ, sizeof(ftp_succ), "BTUP %s", arg);
 			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Start FTP session is Done successfully.\n", __FUNCTION__);
 			SendResponse(cli_sockfd, ftp_succ);
-			system("add_obex_service");
-			StartFTPSession(cli_sockfd, client, inactive_timeout, led_org);	// once the StartFTPSession returns, it indicates the FTP Quit.
+			// the record is only advertised during the session, by the scripts if the SDP server can't be reached
+			if((sdp_script = (SetObexServiceAvailable(1) < 0)))
+				system("add_obex_service");
+			StartFTPSession(cli_sockfd, client, addr, inactive_timeout, led_org);	// once the StartFTPSession returns, it indicates the FTP Quit.
 			client = NULL;
-			system("del_obex_service");
+			if(sdp_script || SetObexServiceAvailable(0) < 0)
+				system("del_obex_service");
 			if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s: Quit from FTP session successfully.\n", __FUNCTION__);
 			SendResponse(cli_sockfd, "BTDOWN");
 next:
@@ -379,14 +573,22 @@ int main(void) {
 	int serv_sockfd, cli_sockfd;
 	unsigned int clilen;
 	struct sockaddr_in cli_addr;
-	char *pname = NULL;
-	int ret;
+	pthread_t adapter_thread;
+	pthread_attr_t attr;
 	int error;
 	uint inactive_timeout = 0;
+	uint memory_budget = DEFAULT_MEMORY_BUDGET;
+	int inquiry_results = DEFAULT_INQUIRY_RESULTS;
+	int inquiry_length = DEFAULT_INQUIRY_LENGTH;
+	int led_backend = LED_BACKEND_EXEC;
+	char led_path[LED_PATH_LENG] = {};
 	char entry[128] = {};
 	char *pvalue;
-	FILE *config_fd = fopen(CONFIG_FILE, "r");
-	
+	FILE *config_fd;
+
+	start_us = StatsNow();
+	unlink(READY_FILE);
+	config_fd = fopen(CONFIG_FILE, "r");
 	if (config_fd == NULL) {
 		perror("Open /mnt/flash/config/conf/bt_obex.conf failed. Using default.");
 		inactive_timeout = DEFAULT_INACTIVE_TIMEOUT;
@@ -409,6 +611,58 @@ int main(void) {
 					debuglog_enable = DEBUGLOG_OFF;
 				else
 					debuglog_enable = DEBUGLOG_ON;
+			} else if (!strncmp(entry, "led.backend=", strlen("led.backend="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				if (!strncmp(pvalue, LED_BACKEND_KEY_SYSFS, strlen(LED_BACKEND_KEY_SYSFS)))
+					led_backend = LED_BACKEND_SYSFS;
+				else if (!strncmp(pvalue, LED_BACKEND_KEY_STUB, strlen(LED_BACKEND_KEY_STUB)))
+					led_backend = LED_BACKEND_STUB;
+				else
+					led_backend = LED_BACKEND_EXEC;
+			} else if (!strncmp(entry, "obex.channel=", strlen("obex.channel="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				obex_channel = atoi(pvalue);
+			} else if (!strncmp(entry, "obex.transport=", strlen("obex.transport="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				if (ObexSetTransport(pvalue) < 0)
+					printf("The setting of obex.transport is invalid. Using Bluetooth.\n");
+			} else if (!strncmp(entry, "digest.type=", strlen("digest.type="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				ObexSetDigest(DigestParse(pvalue));
+			} else if (!strncmp(entry, "memory.budget=", strlen("memory.budget="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				memory_budget = atoi(pvalue);
+			} else if (!strncmp(entry, "fanout.links=", strlen("fanout.links="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				fanout_links = atoi(pvalue);
+			} else if (!strncmp(entry, "inquiry.results=", strlen("inquiry.results="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				inquiry_results = atoi(pvalue);
+			} else if (!strncmp(entry, "inquiry.length=", strlen("inquiry.length="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				inquiry_length = atoi(pvalue);
+			} else if (!strncmp(entry, "discovery.interval=", strlen("discovery.interval="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				discovery_interval = atoi(pvalue);
+			} else if (!strncmp(entry, "discovery.age=", strlen("discovery.age="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				discovery_age = atoi(pvalue);
+			} else if (!strncmp(entry, "led.path=", strlen("led.path="))) {
+				pvalue = strchr(entry, '=');
+				pvalue += 1;
+				pvalue[strcspn(pvalue, "\r\n")] = '\0';
+				if (strlen(pvalue))
+					snprintf(led_path, sizeof(led_path), "%s", pvalue);
 			}
 			
 			memset(entry, 0, sizeof(entry));
@@ -418,21 +672,31 @@ int main(void) {
 	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] ** Start titan_obex now **\n");
 	printf("Debuglog: %s, Inactive.timeout: %d\n", debuglog_enable? "Enable" : "Disable", inactive_timeout);
 	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] ** debuglog: %s, inactive.timeout: %d **\n", debuglog_enable? "Enable" : "Disable", inactive_timeout);
+	// the listener first, the MRx gets BUSY instead of no answer while the rest is set up
 	if((serv_sockfd = InitMrxListener()) < 0) {
 		printf("Init the Mrx listener Failed\n");
 		if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] Error: %s Init the Mrx listener Failed\n", __FUNCTION__);
 		return -1;
 	}
+	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] ** listening in %llu ms **\n", (StatsNow() - start_us) / 1000);
+	NotifyInit("STATUS=Listening, waiting for the Bluetooth adapter");
+
+	if (BudgetSet(memory_budget) < 0)
+		printf("The setting of memory.budget is too small. Using %d KB.\n", BUDGET_MIN_KB);
+	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] ** memory.budget: %u KB **\n", BudgetGet()->kb);
+	LedInit(led_backend, led_path);
+	if (InqSetParams(inquiry_results, inquiry_length) < 0)
+		printf("The setting of inquiry.results or inquiry.length is invalid. Using %d devices, %d x 1.28 s.\n", DEFAULT_INQUIRY_RESULTS, DEFAULT_INQUIRY_LENGTH);
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&adapter_thread, &attr, AdapterInit, NULL) != 0) {
+		perror("pthread_create() of the adapter initialization failed");
+		AdapterInit(NULL);
+	}
+	pthread_attr_destroy(&attr);
 
-	ret = BTLoadName(&pname);
-	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s BTLoadName() returns %d\n", __FUNCTION__, ret);
-	if (ret > 0) {
-		BTSetName(pname);
-		free(pname);
-		pname = NULL;
-	} else if (ret < 0)
-		return -1;
-	
 	while(1) {
 		clilen = sizeof(cli_addr);
 		if((cli_sockfd = accept(serv_sockfd, (struct sockaddr *)&cli_addr, &clilen)) < 0)  {
@@ -445,6 +709,7 @@ int main(void) {
 		printf("A connection: %s:%d is connecting.\n", inet_ntoa(cli_addr.sin_addr), cli_addr.sin_port);
 		if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] A connection: %s:%d is connecting.\n", inet_ntoa(cli_addr.sin_addr), cli_addr.sin_port);
 		connection_handler(cli_sockfd, inactive_timeout);
+		PairDetach(cli_sockfd);
 //		shutdown(cli_sockfd, SHUT_RDWR);
 	} 
 
@@ -0,0 +1,175 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		bump allocator of a FTP session, emptied after every FTP
+*				command
+* File Name:			ositech_arena.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_arena.h"
+
+// allocation which doesn't fit in the arena
+struct arena_block {
+	struct arena_block *pnext;
+	size_t size;
+};
+
+#define ARENA_ROUND(size)	(((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+#ifdef ARENA_HEAP_COUNT
+// Test build: link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,--wrap=strdup
+// so the heap calls of titan_obex itself, not of the libraries, are counted
+// per thread. STAT reports the count of the FTP session thread.
+static __thread unsigned int heap_calls;
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t nmemb, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+extern void __real_free(void *ptr);
+extern char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size) {
+	heap_calls++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	heap_calls++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	heap_calls++;
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+	if(ptr)
+		heap_calls++;
+	__real_free(ptr);
+}
+
+char *__wrap_strdup(const char *s) {
+	heap_calls++;
+	return __real_strdup(s);
+}
+#endif
+
+/***********************************************************************
+* Description:
+* Allocate the memory of the arena, the only malloc() of the arena as long
+* as the FTP commands fit in it.
+*
+* Calling Arguments:
+* Name			Description
+* arena		the arena
+* size		bytes available between two resets
+*
+* Return Value:
+* 0: success
+* -1: fail, every allocation goes to the overflow list
+******************************************************************************/
+int ArenaInit(arena_t *arena, const size_t size) {
+	memset(arena, 0, sizeof(arena_t));
+	if((arena->base = (char *)malloc(size)) == NULL) {
+		perror("ArenaInit: malloc() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s malloc() %u bytes failed\n", __FUNCTION__, (unsigned int)size);
+		return -1;
+	}
+	arena->size = size;
+	arena->mallocs = 1;
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Take memory from the arena. Nothing is freed one by one, the memory is
+* valid until the next ArenaReset().
+*
+* Calling Arguments:
+* Name			Description
+* arena		the arena
+* size		bytes requested
+*
+* Return Value:
+* the memory, aligned on ARENA_ALIGN
+* NULL: fail
+******************************************************************************/
+void *ArenaAlloc(arena_t *arena, const size_t size) {
+	size_t round = ARENA_ROUND(size);
+	arena_block *block;
+	void *p;
+
+	if(arena->base && round <= arena->size - arena->used) {
+		p = arena->base + arena->used;
+		arena->used += round;
+		if(arena->used > arena->peak)
+			arena->peak = arena->used;
+		return p;
+	}
+
+	// too big for what's left, keep it on the overflow list till the reset
+	if((block = (arena_block *)malloc(ARENA_ROUND(sizeof(arena_block)) + round)) == NULL)
+		return NULL;
+	block->size = round;
+	block->pnext = arena->overflow;
+	arena->overflow = block;
+	arena->overflows++;
+	arena->mallocs++;
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %u bytes beyond the arena\n", __FUNCTION__, (unsigned int)size);
+
+	return (char *)block + ARENA_ROUND(sizeof(arena_block));
+}
+
+void ArenaReset(arena_t *arena) {
+	arena_block *block;
+
+	while((block = arena->overflow) != NULL) {
+		arena->overflow = block->pnext;
+		free(block);
+	}
+	arena->used = 0;
+}
+
+void ArenaRelease(arena_t *arena) {
+	ArenaReset(arena);
+	free(arena->base);
+	arena->base = NULL;
+	arena->size = 0;
+}
+
+/***********************************************************************
+* Description:
+* Heap calls made by titan_obex on the calling thread, only counted when
+* built with ARENA_HEAP_COUNT.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* >=0: malloc/calloc/realloc/free/strdup calls so far
+* -1: not counted
+******************************************************************************/
+int ArenaHeapCalls(void) {
+#ifdef ARENA_HEAP_COUNT
+	return (int)heap_calls;
+#else
+	return -1;
+#endif
+}
@@ -0,0 +1,41 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_arena.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_ARENA_H
+#define __OSITECH_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN	8
+
+typedef struct arena_block arena_block;
+
+typedef struct arena {
+	char *base;
+	size_t size;
+	size_t used;
+	size_t peak;			// highest use of a FTP command
+	arena_block *overflow;	// allocations beyond size, freed on reset
+	unsigned int overflows;	// number of overflow allocations so far
+	unsigned int mallocs;	// calls to malloc() since ArenaInit
+} arena_t;
+
+extern int ArenaInit(arena_t *arena, const size_t size);
+extern void *ArenaAlloc(arena_t *arena, const size_t size);
+extern void ArenaReset(arena_t *arena);
+extern void ArenaRelease(arena_t *arena);
+extern int ArenaHeapCalls(void);
+
+#endif
@@ -40,6 +40,13 @@
 #include "ositech_communication.h"
 #include "config.h"
 #include "hci_info.h"
+#include "ositech_led.h"
+#include "ositech_trust.h"
+#include "ositech_journal.h"
+#include "ositech_inquiry.h"
+#include "ositech_discovery.h"
+#include "ositech_names.h"
+#include "ositech_pair.h"
 
 #define FILENAME_SIZE	64
 
@@ -200,7 +207,8 @@ int GetCurBTLed(void) {
 
 /*********************************************************************** 
 * Description:
-* Set the Bluetooth LED operation
+* Set the Bluetooth LED operation. The LED controller drops the request
+* if the LED is already in the given mode.
 * 
 * Calling Arguments: 
 * Name			Description 
@@ -210,11 +218,7 @@ int GetCurBTLed(void) {
 * none
 ******************************************************************************/
 void SetBTLed(const int mode) {
-	char led_cmd[32] = "titan3_led bt";
-
-	snprintf(led_cmd+strlen(led_cmd), sizeof(led_cmd)-strlen(led_cmd), " %d", mode);
-//	printf("%s\n", led_cmd);
-	system(led_cmd);
+	LedSetMode(mode);
 }
 
 /*********************************************************************** 
@@ -350,50 +354,69 @@ int BTSetName(const char *name)
 // 0: no name is set
 // 1: load name successfully
 int BTLoadName(char **pname) {
-	FILE *file_stream;
-	int sz;
-	
-	file_stream = OpenFile("friendlyname", "r");
-	if (file_stream) {
-		fseek(file_stream, 0L, SEEK_END);
-		sz = ftell(file_stream);
-		fseek(file_stream, 0L, SEEK_SET);
-	} else {
+	char name[BT_NAME_LENGTH] = {};
+
+	if(!JournalGetName(name, sizeof(name))) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: friendly name is not set\n", __FUNCTION__);
 		return 0;
 	}
-	
-	if (sz) {
-		*pname = (char *)malloc((sz+1)*sizeof(char));
-		if (!*pname) {
-			perror("BTLoadName(): malloc()");
-			return -1;
-		}
+	if((*pname = strdup(name)) == NULL) {
+		perror("BTLoadName(): strdup()");
+		return -1;
 	}
-	fgets(*pname, (sz+1)*sizeof(char), file_stream);
 	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: friendly name is %s\n", __FUNCTION__, *pname);
-	CloseFile(file_stream);
-	
+
 	return 1;
 }
 
-// store the friendly name
+// store the friendly name, one record of the journal
 void StoreName(const char *pname) {
-	FILE *file_stream;
-	
-	file_stream = OpenFile("friendlyname", "w");
-	fwrite(pname, sizeof(char), strlen(pname), file_stream);
-	CloseFile(file_stream);
+	JournalSetName(pname);
 }
 
 void DelNameFile(void) {
-	char fullpath[FILENAME_SIZE] = {};
+	JournalSetName(NULL);
+}
 
-	GetBTFilePath(fullpath, "friendlyname");
-	if(access(fullpath, F_OK) < 0)
-		printf("%s not existed\n", fullpath);
-	else 
-		unlink(fullpath);
+// the MRx of an AT+BTIN and its filters
+typedef struct inq_reply {
+	int cli;
+	inq_filter filter;
+} inq_reply;
+
+// "<address without ':'>,<class>,\"<name>\"", "*<address>" for the name if it can't be read
+static void SendInqResult(const inq_dev *dev, void *arg) {
+	inq_reply *reply = (inq_reply *)arg;
+	char addr[BT_ADDR_LENGTH];
+	char inq_res[BT_ADDR_LENGTH+BT_NAME_LENGTH+16] = {};
+
+	ba2str(&dev->bdaddr, addr);
+	AddrStringRmColumn(addr);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: find BT %s, name %s\n", __FUNCTION__, addr, (dev->name_state == INQ_NAME_DONE) ? dev->name : "unknown");
+
+	snprintf(inq_res, sizeof(inq_res), "%s,%2.2x%2.2x%2.2x,",
+		addr,
+		dev->dev_class[2],
+		dev->dev_class[1],
+		dev->dev_class[0]);
+	if (dev->name_state == INQ_NAME_DONE)
+		snprintf(inq_res+strlen(inq_res), sizeof(inq_res) - strlen(inq_res), "\"%s\"", dev->name);
+	else
+		snprintf(inq_res+strlen(inq_res), sizeof(inq_res) - strlen(inq_res), "\"*%s\"", addr);
+	printf("%s\n", inq_res);
+	SendResponse(reply->cli, inq_res);
+}
+
+// the discovery table holds every device, the filters are checked here
+static void SendSeenInqResult(const inq_dev *dev, void *arg) {
+	if(InqFilterMatch(&((inq_reply *)arg)->filter, dev, 1))
+		SendInqResult(dev, arg);
+}
+
+// a device of a live scan is kept for the next AT+BTIN too
+static void SendLiveInqResult(const inq_dev *dev, void *arg) {
+	DiscoveryUpdate(dev);
+	SendInqResult(dev, arg);
 }
 
 /*********************************************************************** 
@@ -403,74 +426,47 @@ void DelNameFile(void) {
 * Calling Arguments: 
 * Name			Description 
 * cli		device id of the bluetooth adaptor
+* arg		the filters of AT+BTIN=, see InqFilterParse()
 *
 * Return Value: 
+* -1:	the filters are invalid
 * 0:	error
 * 1: 	success
 ******************************************************************************/
-int BTGetInq(const int cli)
+int BTGetInq(const int cli, const char *arg)
 {
-	inquiry_info *info = NULL;
-	uint8_t lap[3] = { 0x33, 0x8b, 0x9e };
-	int dev_id, dd;
-	int i, num_rsp;
+	inq_reply reply;
+	int dev_id;
 	int ret;
-	char addr[18];
-	char inq_res[128];
-	char dev_name[64];
 
-	printf("Inquiring ...\n");
+	reply.cli = cli;
+	if(InqFilterParse(arg, &reply.filter) < 0)
+		return -1;
 
 	if((dev_id = GetBTDevID()) < 0) {
 		perror("Error: Get Bluetooth Device failed.");
 		return 0;
 	}
-	
-	num_rsp = hci_inquiry(dev_id, BT_INQ_LIST_DEV_NUM, 0, lap, &info, IREQ_CACHE_FLUSH);
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_inquiry() find %d BT devs\n", __FUNCTION__, num_rsp);
-	if (num_rsp < 0) {
-		perror("Inquiry failed.");
-		return 0;
-	}
-	
-	if((dd = hci_open_dev(dev_id)) < 0) {
-		perror("HCI device open failed");
-		goto end;
-	}
 
-	for (i = 0; i < num_rsp; i++) {
-		memset(inq_res, 0, sizeof(inq_res));
-		memset(dev_name, 0, sizeof(dev_name));
-		ba2str(&(info+i)->bdaddr, addr);
-		AddrStringRmColumn(addr);
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: find BT #%d: %s\n", __FUNCTION__, i, addr);
-
-		snprintf(inq_res, sizeof(inq_res), "%s,%2.2x%2.2x%2.2x,",
-			addr,
-			(info+i)->dev_class[2],
-			(info+i)->dev_class[1],
-			(info+i)->dev_class[0]);
-		
-		if (hci_read_remote_name(dd, &(info+i)->bdaddr, sizeof(dev_name), dev_name, 25000) == 0)
-			snprintf(inq_res+strlen(inq_res), sizeof(inq_res) - strlen(inq_res), "\"%s\"", dev_name);
-		else {
-			snprintf(inq_res+strlen(inq_res), sizeof(inq_res) - strlen(inq_res), "\"*%s\"", addr);
-		}
-		printf("%s\n", inq_res);
-		SendResponse(cli, inq_res);
-	}
-	
-	hci_close_dev(dd);
-	ret = 1;
-	
-end:
-	bt_free(info);	
-	return ret;
+	// the devices seen lately by the discovery, unless there are none yet. A target is looked for live.
+	if(!reply.filter.live && !reply.filter.ntargets && DiscoveryList(SendSeenInqResult, &reply) > 0)
+		return 1;
+
+	printf("Inquiring ...\n");
+	// every line is sent as soon as the name of its device is known
+	DiscoveryPause();
+	if(reply.filter.ping)
+		ret = InqPing(dev_id, &reply.filter, SendInqResult, &reply);
+	else
+		ret = InqRun(dev_id, 0, 0, &reply.filter, SendLiveInqResult, &reply);
+	DiscoveryResume();
+	return (ret < 0) ? 0 : 1;
 }
 
 /*********************************************************************** 
 * Description:
-* save the pin code of pairing
+* save the pin code of pairing. bluetoothd sends the PIN Code Request to
+* the system agent, which answers with PINCODE_FILE, for AT+BTW as well.
 * 
 * Calling Arguments: 
 * Name			Description 
@@ -482,31 +478,24 @@ end:
 ******************************************************************************/
 int BTSetPIN(const char *pin_code) {
 	int fd;
-	int wr_sz;
-	unsigned int retry = 0;
-	int pin_code_leng = strlen(pin_code);
-	
+	int pin_code_leng;
+
 	if(!pin_code)
 		return 0;
+	pin_code_leng = strlen(pin_code);
 
 	printf("PIN code: %s\n", pin_code);
-	if((fd = open(PINCODE_FILE, O_WRONLY | O_CREAT)) < 0) {
+
+	if((fd = open(PINCODE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0) {
 		printf("Error: %s(%d) open()\n", __FUNCTION__, __LINE__);
 		return 0;
 	}
-
-	do {
-		printf("Saving the PIN code...\n");
-		if((wr_sz = write(fd, pin_code, pin_code_leng)) < 0) {
-			printf("Error: %s(%d) write()\n", __FUNCTION__, __LINE__);
-			return 0;
-		}
-
-		if (retry++ >= RETRY_TIMES)
-			break;
-		
-	} while(wr_sz < pin_code_leng);	//wr_sz < pin_code length, rewrite
-
+	if(write(fd, pin_code, pin_code_leng) != pin_code_leng) {
+		printf("Error: %s(%d) write()\n", __FUNCTION__, __LINE__);
+		close(fd);
+		return 0;
+	}
+	close(fd);
 	return 1;
 }
 
@@ -534,76 +523,61 @@ static void PageScan(int dev_id, const int scan_switch) {
 	}
 
 	close(ctl);
+	HciStateInvalidate();
 }
 /*********************************************************************** 
 * Description:
-* get the inquery result of the bluetooth adaptor
+* start pairing with the remote device. "OK" is sent once the pairing is
+* started, and "PAIR <code> <tag>" when it is done, without waiting here.
 * 
 * Calling Arguments: 
 * Name			Description 
+* cli		the socket of the MRx
 * arg	remote bluetooth device address
-* start_pait 	state of pairing
+* tag		the address as the MRx gave it
+* progress	1 for the "PAIRING" lines of the stages
 *
 * Return Value: 
-* 0: success
-* 1: timeout
+* 0: started
+* 1: a pairing is running
 * 2: otherwise
 ******************************************************************************/
-int BTInitPair(const char *arg, int *start_pair) {
-	bdaddr_t bdaddr;
-	int dd, dev_id;
-	uint16_t handle;
-	unsigned int ptype = HCI_DM1 | HCI_DM3 | HCI_DM5 | HCI_DH1 | HCI_DH3 | HCI_DH5;
+int BTInitPair(const int cli, const char *arg, const char *tag, const int progress) {
+	int ret;
 
 	if(!arg) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: pairing BT device address is not given\n", __FUNCTION__);
-		return 0;
+		return 2;
 	}
 	printf("Pairing to %s...\n", arg);
 	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: Pairing to %s....\n", __FUNCTION__, arg);
 	if(!ValidAddr(arg)) {
-		*start_pair = 0;
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: pairing BT device address %s is invalid (code 2)\n", __FUNCTION__, arg);
 		return 2;
-	} else {
-		*start_pair = 1;
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: BT device address %s is Valid.\n", __FUNCTION__, arg);
 	}
-	
-	str2ba(arg, &bdaddr);
 
-	dev_id = hci_get_route(&bdaddr);
-	if (dev_id < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_get_route() local BT device Failed\n", __FUNCTION__);
-		return 2;
+	if((ret = PairStart(cli, arg, tag, progress)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: the pairing is not started (%d)\n", __FUNCTION__, ret);
+		return (ret == -1) ? 1 : 2;
 	}
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_get_route() local BT device SUCCESS\n", __FUNCTION__);
-
-	// enable page scan 
-//	PageScan(dev_id, 1);
+	return 0;
+}
 
-	dd = hci_open_dev(dev_id);
-	if (dd < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_open_dev() local BT device Failed\n", __FUNCTION__);
-		return 2;
-	}
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_open_dev() local BT device SUCCESS\n", __FUNCTION__);
+// "<address without ':'>,\"<name>\"" of a trusted device, the address if the name is unknown
+static void SendTrustDev(const char *addr, const char *name, void *arg) {
+	char read_bt_add[BT_ADDR_LENGTH] = {};
+	char resp_string[BT_ADDR_LENGTH+BT_NAME_LENGTH] = {};
 
-	
-	if (hci_create_connection(dd, &bdaddr, htobs(ptype), htobs(0x0000), SLAVE_ROLE, &handle, 25000) < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_create_connection() remote BT device Failed\n", __FUNCTION__);
-		return 2;
+	snprintf(read_bt_add, sizeof(read_bt_add), "%s", addr);
+	AddrStringRmColumn(read_bt_add);
+	if(!name) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: friendly name is not found.\n", __FUNCTION__);
+		name = read_bt_add;
 	}
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_create_connection() remote BT device SUCCESS\n", __FUNCTION__);
-
-	// disable page scan
-//	sleep(10);
-//	PageScan(dev_id, 0);
-	
-	hci_close_dev(dd);
+	snprintf(resp_string, sizeof(resp_string), "%s,\"%s\"", read_bt_add, name);
 
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s returns success\n", __FUNCTION__);
-	return 0;
+	printf("Trust Dev: %s\n", resp_string);
+	SendResponse((int)(long)arg, resp_string);
 }
 
 /*********************************************************************** 
@@ -618,75 +592,7 @@ int BTInitPair(const char *arg, int *start_pair) {
 *none
 ******************************************************************************/
 void GetTrustList(const int sockfd) {
-	FILE *linkkey_file_stream, *paireddev_file_stream;
-	char linkkey_read_buff[BUFF_SIZE] = {};
-	char paireddev_read_buff[BUFF_SIZE] = {};
-	
-	char read_bt_add[BT_ADDR_LENGTH] = {};
-	char read_bt_name[BT_NAME_LENGTH] = {};
-	char resp_string[BT_ADDR_LENGTH+BT_NAME_LENGTH] = {};
-	int found = 0;
-/*
-	int dev_id, dd;
-	bdaddr_t bdaddr;
-	
-	if ((dev_id =  hci_get_route(NULL)) < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_get_route() failed\n", __FUNCTION__);
-		return;
-	}
-	
-	if((dd = hci_open_dev(dev_id)) < 0) {	// open the local hci dev for sending request
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_open_dev() failed\n", __FUNCTION__);
-		return;
-	}
-*/
-	if((linkkey_file_stream = OpenFile("linkkeys", "r")) == NULL)
-		return;
-
-	while(fgets(linkkey_read_buff, sizeof(linkkey_read_buff), linkkey_file_stream)) {
-		memset(read_bt_add, 0 , sizeof(read_bt_add));
-		snprintf(read_bt_add, sizeof(read_bt_add), "%s", linkkey_read_buff);
-		//AddrStringRmColumn(read_bt_add);
-		if((paireddev_file_stream = OpenFile("paireddevice", "r")) == NULL)
-			return;
-		while(fgets(paireddev_read_buff, sizeof(paireddev_read_buff), paireddev_file_stream)) {
-			//printf("finding %s in %s", read_bt_add, paireddev_read_buff);
-			found = FindAddr(paireddev_read_buff, read_bt_add);
-			if(found) {
-				//printf("found = %d\n", found);
-				snprintf(read_bt_name, sizeof(read_bt_name), "%s", paireddev_read_buff+strlen(read_bt_add)+1);
-				break;
-			}
-			memset(paireddev_read_buff, 0, sizeof(paireddev_read_buff));
-		}
-		fclose(paireddev_file_stream);
-/*		
-		str2ba(read_bt_add, &bdaddr);
-		memset(read_bt_name, 0, sizeof(read_bt_name));
-		
-		if(hci_read_remote_name(dd, &bdaddr, sizeof(read_bt_name), read_bt_name, 25000) < 0) {
-			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_read_remote_name() failed\n", __FUNCTION__);
-			memset(read_bt_name, 0, sizeof(read_bt_name));
-			snprintf(read_bt_name, sizeof(read_bt_name), "%s", "Unknown");
-		}
-*/		
-		AddrStringRmColumn(read_bt_add);
-		if(!found) {
-			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: friendly name is not found.\n", __FUNCTION__);
-			snprintf(read_bt_name, sizeof(read_bt_name), "%s", read_bt_add);
-		}
-		if(*(read_bt_name+strlen(read_bt_name) - 1) == '\n')
-			*(read_bt_name+strlen(read_bt_name) -1) = '\0';
-		snprintf(resp_string, sizeof(resp_string), "%s,\"%s\"", read_bt_add, read_bt_name);
-		
-		printf("Trust Dev: %s\n", resp_string);
-		SendResponse(sockfd, resp_string);
-		memset(resp_string, 0, sizeof(resp_string));
-		memset(linkkey_read_buff, 0, sizeof(linkkey_read_buff));
-		found = 0;
-	}
-
-	fclose(linkkey_file_stream);
+	TrustList(SendTrustDev, (void *)(long)sockfd);
 }
 
 /*********************************************************************** 
@@ -702,32 +608,10 @@ void GetTrustList(const int sockfd) {
 * 1: 	success
 */
 int SearchPairedDev(const char *addr) {
-	FILE *file_stream;
-	char read_buff[BUFF_SIZE] = {};
-	long int file_size = 0;
-	int found = 0;
-
 	if(!ValidAddr(addr)) 
 		return 0;
-	
-	if((file_stream = OpenFile("linkkeys", "r")) == NULL)
-		return 0;
-
-	fseek(file_stream, 0, SEEK_END);
-	file_size = ftell(file_stream);
-	fseek(file_stream, 0, SEEK_SET);
 
-	if (file_size <= 0)
-		return 0;
-
-	while(fgets(read_buff, sizeof(read_buff), file_stream)) {
-		found = FindAddr(read_buff, addr);
-		if(found) 
-			break;
-		memset(read_buff, 0, sizeof(read_buff));
-	}
-
-	return found;
+	return TrustIsLinked(addr);
 }
 
 /*********************************************************************** 
@@ -758,8 +642,10 @@ int RmTrustDev(const char *addr) {
 		printf("Error: Invalid BT device address (%s)\n", addr);
 		return 0;
 	}
+	// linkkeys belongs to bluetoothd and is rewritten, paireddevice only gets a record
 	BTFindandDel("linkkeys", addr, NULL);
-	BTFindandDel("paireddevice", addr, NULL);
+	JournalRemovePaired(addr);
+	TrustRemove(addr);
 	return 1;
 /*	
 	if((file_stream = OpenFile("linkkeys", "r")) == NULL)
@@ -823,179 +709,101 @@ void RmAllTrustDev(void) {
 	else 
 		unlink(fullpath);
 
-	GetBTFilePath(fullpath, "paireddevice");
-	if(access(fullpath, F_OK) < 0)
-		printf("%s not existed\n", fullpath);
-	else 
-		unlink(fullpath);
+	JournalRemovePaired(NULL);
+	TrustRemoveAll();
 }
 
 static void BTFindandDel(const char *filename, const char *addr, const char *new_string) {
 	BTFindandReplace(filename, addr, NULL);
 }
 
+/***********************************************************************
+* Description:
+* remove the line of the given device from the file, and append the new
+* line if it's given. The file is copied line by line into a temporary
+* file which replaces the file, only a line is kept in memory.
+*
+* Calling Arguments:
+* Name			Description
+* filename	the file in the directory of the adaptor
+* addr		the address of the device
+* new_string	the line appended to the file, NULL if none
+*
+* Return Value:
+* 0: success
+* 1: the file can't be rewritten
+******************************************************************************/
 static int BTFindandReplace(const char *filename, const char *addr, const char *new_string) {
-	FILE *file_stream;
+	FILE *file_stream, *new_stream = NULL;
 	char read_buff[BUFF_SIZE] = {};
-	char *pnewfile = NULL;
-	long int file_size = 0;
+	char tmpname[FILENAME_SIZE] = {};
+	char fullpath[FILENAME_SIZE] = {};
+	char tmppath[FILENAME_SIZE] = {};
+	int line_start = 1;
+	int skip = 0;
 	int found = 0;
 	int res = 0;
-	char bt_addr[BT_ADDR_LENGTH] = {};
 
-	
 	if((file_stream = OpenFile(filename, "r"))== NULL) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OpenFile() %s failed\n", __FUNCTION__, filename);
+		res = 1;
 		goto end;
 	}
 
-	fseek(file_stream, 0, SEEK_END);
-	file_size = ftell(file_stream);
-	fseek(file_stream, 0, SEEK_SET);
-
-	if (file_size <= 0) {
+	snprintf(tmpname, sizeof(tmpname), "%s~", filename);	// the full path must fit in FILENAME_SIZE
+	if((new_stream = OpenFile(tmpname, "w")) == NULL) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OpenFile() %s failed\n", __FUNCTION__, tmpname);
+		CloseFile(file_stream);
 		res = 1;
 		goto end;
 	}
-	
 
-	pnewfile = (char *)malloc(file_size);
-	if(!pnewfile) {
-		printf("Error: %s(%d) malloc()\n", __FUNCTION__, __LINE__);
-		return 1;
-	}
-	memset(pnewfile, 0, file_size);
-	
-	sprintf(bt_addr, "%s", addr);
 	while(fgets(read_buff, sizeof(read_buff), file_stream)) {
-	//	printf("read_buff: %s\n", read_buff);
-		if(found)		// if the address is found already, just copy the reading
-			snprintf(pnewfile+strlen(pnewfile), file_size-strlen(pnewfile), "%s", read_buff);
-		else {
-			if(strlen(bt_addr) == 12)
-				AddrStringAddColumn(bt_addr);
-			
-			found = FindAddr(read_buff, addr);
-			if(!found) 	// if the cur reading is not the one looking for.
-				snprintf(pnewfile+strlen(pnewfile), file_size-strlen(pnewfile), "%s", read_buff);
+		// a line longer than the buffer is read in pieces, only its first piece has the address
+		if(line_start) {
+			skip = (!found && FindAddr(read_buff, addr));
+			if(skip)
+				found = 1;
 		}
+		if(!skip)
+			fputs(read_buff, new_stream);
+		line_start = (read_buff[strlen(read_buff)-1] == '\n');
 		memset(read_buff, 0, sizeof(read_buff));
 	}
 	CloseFile(file_stream);
-
+	// on the flash before it replaces the file, a power loss leaves the old or the new file
 	if(found) {
-		file_stream = OpenFile(filename, "w");
-		fwrite(pnewfile, sizeof(char), strlen(pnewfile), file_stream);
-		CloseFile(file_stream);
+		fflush(new_stream);
+		fsync(fileno(new_stream));
 	}
+	CloseFile(new_stream);
 
-	free(pnewfile);
-	pnewfile = NULL;
-	
-end:
-
-	if(new_string)  {// append to the end of the file
-		file_stream = OpenFile(filename, "a");
-		fwrite(new_string, sizeof(char), strlen(new_string), file_stream);
-		CloseFile(file_stream);
-	}
-	return res;
-}
-
-// 0: success
-// -1: fail
-static int GetFriendlyNameFromInq(char *name, const char *bt_addr) {
-	char name_string[BT_NAME_LENGTH] = {};
-	FILE *file_stream = NULL;
-	int file_size = 0;
-	char read_buff[BUFF_SIZE] = {};
-	char bt_addr_full[BT_ADDR_LENGTH] = {};
-	int found = 0;
-	
-	
-	if((file_stream = OpenFile("names", "r"))== NULL) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OpenFile() names failed\n", __FUNCTION__);
-		goto end;
-	}
-
-	fseek(file_stream, 0, SEEK_END);
-	file_size = ftell(file_stream);
-	fseek(file_stream, 0, SEEK_SET);
-
-	if (file_size <= 0) {
-		CloseFile(file_stream);
-		goto end;
-	}
-
-	snprintf(bt_addr_full, sizeof(bt_addr_full), "%s", bt_addr);
-	AddrStringAddColumn(bt_addr_full);
-	while(fgets(read_buff, sizeof(read_buff), file_stream)) {
-		if(found = FindAddr(read_buff, bt_addr_full))
-			break;
-
-		memset(read_buff, 0, sizeof(read_buff));
-	}
-
-	CloseFile(file_stream);
-	
-end:	
+	GetBTFilePath(tmppath, tmpname);
 	if(found) {
-		snprintf(name, BT_NAME_LENGTH*sizeof(char), "%s", read_buff+strlen(bt_addr_full)+1);
-		return 0;
+		GetBTFilePath(fullpath, filename);
+		if(rename(tmppath, fullpath) < 0) {
+			perror("BTFindandReplace: rename()");
+			unlink(tmppath);
+		}
 	} else
-		return -1;
-}
+		unlink(tmppath);
 
-char *GetPairingDeviceName(const char *addr) {
-//	FILE *file = NULL;
-	int dev_id, dd;
-//	char read_buff[BUFF_SIZE] = {};
-	char bt_addr[BT_ADDR_LENGTH] = {};
-	char read_bt_name[BT_NAME_LENGTH] = {};
-	bdaddr_t bdaddr;
-	char *pstring = NULL;
-	int string_leng = 0;
-	
-	// get friendly name
-	if ((dev_id =  hci_get_route(NULL)) < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_get_route() failed\n", __FUNCTION__);
-		return NULL;
-	}
-	
-	if((dd = hci_open_dev(dev_id)) < 0) {	// open the local hci dev for sending request
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_open_dev() failed\n", __FUNCTION__);
-		return NULL;
-	}
+end:
 
-	sprintf(bt_addr, "%s", addr);
-	str2ba(addr, &bdaddr);
-	//printf("|%s|\n", addr);
-	AddrStringRmColumn(bt_addr);
-	
-	if(hci_read_remote_name(dd, &bdaddr, sizeof(read_bt_name), read_bt_name, 25000) < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_read_remote_name() failed\n", __FUNCTION__);
-		memset(read_bt_name, 0, sizeof(read_bt_name));
-		if(GetFriendlyNameFromInq(read_bt_name, bt_addr) < 0) {	// try to get friendly name from the AT+BTIN result. if it's still failed then using *+btaddress
-			memset(read_bt_name, 0, sizeof(read_bt_name));
-			snprintf(read_bt_name, sizeof(read_bt_name), "*%s", bt_addr);
+	if(new_string)  {// append to the end of the file
+		if((file_stream = OpenFile(filename, "a")) != NULL) {
+			fwrite(new_string, sizeof(char), strlen(new_string), file_stream);
+			CloseFile(file_stream);
 		}
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: set Friendly Name of  %s to be *%s\n", __FUNCTION__, bt_addr, read_bt_name);
-	}
-
-	//printf("%s's friendly name: %s\n", addr, read_bt_name);
-	string_leng = strlen(addr) + strlen(read_bt_name) + 3; // format of "bt_addr,friendlyname\n\0"
-	pstring = (char *)malloc(string_leng * sizeof(char));
-	if(pstring == NULL) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: malloc() failed\n", __FUNCTION__);
-		return NULL;
 	}
-	memset(pstring, 0, string_leng * sizeof(char));
-
-	snprintf(pstring, string_leng * sizeof(char), "%s,%s\n", addr, read_bt_name);
-	return pstring;
+	return res;
 }
 
 void UpdatePairedDevice(const char *addr, const char *pstring) {
-	BTFindandReplace("paireddevice", addr, pstring);
+	// pstring is "<addr>,<name>\n"
+	if(strlen(pstring) <= strlen(addr))
+		return;
+	JournalSetPaired(addr, pstring+strlen(addr)+1);
+	TrustSetPaired(addr, pstring+strlen(addr)+1);
 	return;
 }
\ No newline at end of file
@@ -17,11 +17,10 @@
 #ifndef __OSITECH_BT_H
 #define __OSITECH_BT_H
 
-#define BT_INQ_LIST_DEV_NUM	8
 #define RETRY_TIMES	3
 #define BT_ADDR_LENGTH		18
 #define BT_NAME_LENGTH		248
-#define PINCODE_FILE	"/tmp/BT_pincode"
+#define PINCODE_FILE	"/tmp/BT_pincode"	// read by the system agent of bluetoothd
 
 
 #define BT_LED_OFF			0
@@ -34,9 +33,9 @@
 #define SLAVE_ROLE	0x1
 
 extern int BTSetName(const char *name);
-extern int BTGetInq(const int cli);
+extern int BTGetInq(const int cli, const char *arg);
 extern int BTSetPIN(const char *pin_code);
-extern int BTInitPair(const char *arg, int *start_pair);
+extern int BTInitPair(const int cli, const char *arg, const char *tag, const int progress);
 extern void GetTrustList(const int sockfd);
 extern int RmTrustDev(const char *addr);
 extern void RmAllTrustDev(void);
@@ -50,7 +49,6 @@ extern void StoreName(const char *pname);
 extern int BTLoadName(char **pname);
 extern void DelNameFile(void);
 extern int SearchPairedDev(const char *addr);
-extern char *GetPairingDeviceName(const char *addr);
 extern void UpdatePairedDevice(const char *addr, const char *string);
 
 #endif
\ No newline at end of file
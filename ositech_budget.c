@@ -0,0 +1,139 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		memory budget of titan_obex, splits memory.budget= into
+*				the fixed sizes of the sessions, buffers and threads
+* File Name:			ositech_budget.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_budget.h"
+
+#define KB	1024
+
+#define BUDGET_CHUNK_MIN	(4*KB)
+#define BUDGET_CHUNK_MAX	(32*KB)		// buffer of the MRx data, a bigger chunk goes through it in pieces
+#define BUDGET_RING_MIN		(128*KB)	// a whole OBEX packet ahead of obexftp, over partly used pipe pages
+#define BUDGET_RING_MAX		(256*KB)
+#define BUDGET_STACK_MIN	(128*KB)	// SDP and OBEX connection of a fan-out worker
+#define BUDGET_STACK_MAX	(512*KB)
+#define BUDGET_SESSION_EXTRA	(8*KB)	// small allocations of a FTP command
+#define BUDGET_OBEX_BUFFERS	(128*KB)	// receive and send buffers of an OBEX connection
+
+#define BUDGET_CLAMP(value, min, max)	((value) < (min) ? (min) : ((value) > (max) ? (max) : (value)))
+
+static mem_budget budget = {
+	.kb = 0,
+	.session = BUDGET_CHUNK_MAX + BUDGET_SESSION_EXTRA,
+	.chunk = BUDGET_CHUNK_MAX,
+	.ring = BUDGET_RING_MAX,
+	.stack = 0,
+	.copy = UINT_MAX,
+	.sessions = 0,
+};
+
+/***********************************************************************
+* Description:
+* Split the budget. The sizes are fixed from now on, an operation which
+* needs more than its share is done in smaller steps rather than failed:
+* a big MRx chunk goes through the data buffer in several writes, a file
+* beyond the copy share is read by every fan-out session on its own.
+*
+* Calling Arguments:
+* Name			Description
+* kb		memory.budget= in KB, 0 for no budget
+*
+* Return Value:
+* 0: success
+* -1: the budget is below BUDGET_MIN_KB, BUDGET_MIN_KB is used
+******************************************************************************/
+int BudgetSet(const unsigned int kb) {
+	size_t bytes;
+	int ret = 0;
+
+	if(!kb)
+		return 0;
+	if(kb < BUDGET_MIN_KB) {
+		printf("memory.budget=%u is below %u KB\n", kb, BUDGET_MIN_KB);
+		ret = -1;
+	}
+	budget.kb = (kb < BUDGET_MIN_KB) ? BUDGET_MIN_KB : kb;
+	bytes = (size_t)budget.kb * KB;
+
+	budget.chunk = BUDGET_CLAMP(bytes / 64, BUDGET_CHUNK_MIN, BUDGET_CHUNK_MAX);
+	budget.session = budget.chunk + BUDGET_SESSION_EXTRA;
+	budget.ring = BUDGET_CLAMP(bytes / 8, BUDGET_RING_MIN, BUDGET_RING_MAX);
+	budget.stack = BUDGET_CLAMP(bytes / 8, BUDGET_STACK_MIN, BUDGET_STACK_MAX);
+	budget.copy = bytes / 4;
+	budget.sessions = (bytes / 2) / (budget.stack + BUDGET_OBEX_BUFFERS);
+	if(budget.sessions < 1)
+		budget.sessions = 1;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %u KB, session %u chunk %u ring %u stack %u copy %u sessions %d\n", __FUNCTION__,
+		budget.kb, (unsigned int)budget.session, (unsigned int)budget.chunk, (unsigned int)budget.ring,
+		(unsigned int)budget.stack, (unsigned int)budget.copy, budget.sessions);
+	return ret;
+}
+
+const mem_budget *BudgetGet(void) {
+	return &budget;
+}
+
+// stack size of a thread of titan_obex, attr must be initialized
+void BudgetThreadAttr(pthread_attr_t *attr) {
+	if(budget.stack)
+		pthread_attr_setstacksize(attr, budget.stack);
+}
+
+// VmRSS and VmHWM of /proc/self/status, in KB
+static void BudgetRss(unsigned int *rss, unsigned int *peak) {
+	char line[128] = {};
+	FILE *status;
+
+	*rss = *peak = 0;
+	if((status = fopen("/proc/self/status", "r")) == NULL)
+		return;
+	while(fgets(line, sizeof(line), status)) {
+		if(!strncmp(line, "VmRSS:", strlen("VmRSS:")))
+			*rss = strtoul(line + strlen("VmRSS:"), NULL, 10);
+		else if(!strncmp(line, "VmHWM:", strlen("VmHWM:")))
+			*peak = strtoul(line + strlen("VmHWM:"), NULL, 10);
+	}
+	fclose(status);
+}
+
+/***********************************************************************
+* Description:
+* Format the memory use as "MEM budget=<KB> rss=<KB> peak=<KB>", peak is
+* the highest resident size since titan_obex is started.
+*
+* Calling Arguments:
+* Name			Description
+* string		store the formatted line
+* string_leng	the size of string
+*
+* Return Value:
+* length of the string
+******************************************************************************/
+int BudgetReport(char *string, const int string_leng) {
+	unsigned int rss, peak;
+
+	BudgetRss(&rss, &peak);
+	return snprintf(string, string_leng, "MEM budget=%u rss=%u peak=%u", budget.kb, rss, peak);
+}
@@ -0,0 +1,45 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_budget.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_BUDGET_H
+#define __OSITECH_BUDGET_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define BUDGET_MIN_KB	512		// smallest memory.budget= accepted
+#define BUDGET_STRING_LENG	96
+
+/*
+ fixed sizes of the memory used by titan_obex, set once at start from
+ memory.budget= of bt_obex.conf. A budget of 0 keeps the sizes used without
+ a budget.
+*/
+typedef struct mem_budget {
+	unsigned int kb;	// memory.budget=, 0 if not bounded
+	size_t session;		// arena of a FTP session
+	size_t chunk;		// buffer of the MRx data, a bigger MRx chunk is streamed through it
+	size_t ring;		// pipe between the MRx and the OBEX layer
+	size_t stack;		// stack of a thread, 0 for the default of the system
+	size_t copy;		// largest file kept in memory for a fan-out PUT
+	int sessions;		// OBEX sessions at the same time of a fan-out PUT
+} mem_budget;
+
+extern int BudgetSet(const unsigned int kb);
+extern const mem_budget *BudgetGet(void);
+extern void BudgetThreadAttr(pthread_attr_t *attr);
+extern int BudgetReport(char *string, const int string_leng);
+
+#endif
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <errno.h>
 #include <debuglog.h>
 
@@ -29,6 +30,9 @@
 #include "ositech_obex.h"
 #include "config.h"
 
+// the pairing thread answers the MRx too, a line is never split by another
+static pthread_mutex_t resp_lock = PTHREAD_MUTEX_INITIALIZER;
+
 #define CHAR_CR	0x0D
 #define CHAR_LF	0x0A
 #define AT_PREFIX	"AT"
@@ -104,6 +108,14 @@ int SendFTPResponse(int sockfd, const int code) {
 	return SendResponse(sockfd, resp_string);
 }
 
+// "<code> FTP <detail>", the MRx only checks the "<code> FTP" prefix
+int SendFTPResponseDetail(int sockfd, const int code, const char *detail) {
+	char resp_string[FTP_RESP_BUFF_SIZE] = {};
+
+	snprintf(resp_string, sizeof(resp_string), "%d FTP %s", code, detail);
+	return SendResponse(sockfd, resp_string);
+}
+
 /*********************************************************************** 
 * Description:
 * send the string in AT format
@@ -123,7 +135,9 @@ int SendResponse(const int sockfd, const char *resp_string) {
 
 	CreateBtRespsonse(resp_string, send_resp);
 	if(debuglog_enable) debuglog(LOG_INFO, "[titan_obex] %s(%d) send_resp -- %s\n", __FUNCTION__, __LINE__, send_resp);
+	pthread_mutex_lock(&resp_lock);
 	wr_sz = write(sockfd, send_resp, strlen(send_resp));
+	pthread_mutex_unlock(&resp_lock);
 	if (wr_sz < 0) {
 		error = errno;
 		printf("%s(%d) write: %s\n", __FUNCTION__, __LINE__, strerror(error));
@@ -273,7 +287,6 @@ void String2Upper(char *string_tmp, const char *org_string) {
 * 0 : success
 ******************************************************************************/
 int StrapQuote(char *arg) {
-	char *ptmp = NULL;
 	int arg_leng = strlen(arg);
 
 	if (arg_leng < 2) { //at least 2 for the double quote
@@ -286,16 +299,9 @@ int StrapQuote(char *arg) {
 		return -1;
 	}
 	
-	if(!(ptmp = (char *)malloc(arg_leng))) {
-		printf("Error: %s(%d) malloc()\n", __FUNCTION__, __LINE__);
-		return -1;
-	}
-	memset(ptmp, 0, arg_leng);
-	snprintf(ptmp, arg_leng-1, "%s", arg+1);		//strap 2x double quote.
-	memset(arg, 0, arg_leng);
-	snprintf(arg, strlen(ptmp)+1, "%s", ptmp);
-	
-	free(ptmp);
+	// strap 2x double quote in place
+	memmove(arg, arg+1, arg_leng-2);
+	memset(arg+arg_leng-2, 0, 2);
 	return 0;
 }
 
@@ -343,6 +349,10 @@ static int GetGeneralCMD(const char *pup_string, const char *porg_string, char *
 	} 
 	else if (!strcmp(atcmd, "+BTD*"))
 		cmd = BT_REMOVE_PAIRED_DEVS;
+	else if (!strncmp(atcmd, "+BTFAN=", strlen("+BTFAN="))) {
+		cmd = BT_FANOUT_PUT;
+		snprintf(arg, BT_CMD_BUFF_SIZE, "%s", porg_string+strlen("+BTFAN=")+strlen(AT_PREFIX));
+	}
 	else if (!strncmp(atcmd, "+BTF=", strlen("+BTF="))) {
 		cmd = BT_SET_NAME;
 		snprintf(arg, BT_CMD_BUFF_SIZE, "%s", porg_string+strlen("+BTF=")+strlen(AT_PREFIX));
@@ -350,6 +360,10 @@ static int GetGeneralCMD(const char *pup_string, const char *porg_string, char *
 		cmd = BT_LOAD_NAME;
 	else if (!strcmp(atcmd, "+BTIN")) 
 		cmd = BT_INQUIRE;
+	else if (!strncmp(atcmd, "+BTIN=", strlen("+BTIN="))) {
+		cmd = BT_INQUIRE;
+		snprintf(arg, BT_CMD_BUFF_SIZE, "%s", porg_string+strlen("+BTIN=")+strlen(AT_PREFIX));
+	}
 	else if (!strncmp(atcmd, "+BTK=", strlen("+BTK="))) {
 		cmd = BT_SET_PIN;
 		snprintf(arg, BT_CMD_BUFF_SIZE, "%s", porg_string+strlen("+BTK=")+strlen(AT_PREFIX));
@@ -412,6 +426,10 @@ int GetFTPCMD(const char *pup_string, const char *porg_string, char *arg) {
 		return BT_FTP_DIR;
 	} else if (!(strncmp(pup_string, "ABORT", strlen("ABORT")))) {
 		return BT_FTP_ABORT;
+	} else if (!strcmp(pup_string, "ATH")) {
+		return BT_FTP_HANG;
+	} else if (!strcmp(pup_string, "STAT")) {
+		return BT_FTP_STAT;
 	}
 	
 	return BT_FTP_UNKNOW_CMD;
@@ -36,11 +36,13 @@
 #define	BT_INIT_PAIR	0xA
 #define	BT_START_FTP	0xB
 #define	BT_LOAD_NAME	0xC
+#define	BT_FANOUT_PUT	0xD
 
 // BT cmd unknown
 #define 	BT_CMD_UNKNOWN	0xFF
 
 extern int SendFTPResponse(int sockfd, const int code);
+extern int SendFTPResponseDetail(int sockfd, const int code, const char *detail);
 extern int SendResponse(const int sockfd, const char *resp_string);
 extern int RecvCmd(const int sockfd, char *arg, const int ftp_start);
 extern int RecvSocketMsg(const int sockfd, char *buff, const int buff_leng);
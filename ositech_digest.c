@@ -0,0 +1,285 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		digest of the transferred data, computed while the data
+*				flows through the daemon
+* File Name:			ositech_digest.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <debuglog.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "config.h"
+#include "ositech_digest.h"
+
+#define CRC32_POLY	0xEDB88320	// reflected 0x04C11DB7
+
+#define ROTR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+#if !defined(__ARM_FEATURE_CRC32)
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+// tables of the slice-by-8 CRC32, 8KB built once
+static void Crc32TableInit(void) {
+	uint32_t crc;
+	int i, j;
+
+	for(i = 0; i < 256; i++) {
+		crc = i;
+		for(j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (CRC32_POLY & (0 - (crc & 1)));
+		crc_table[0][i] = crc;
+	}
+	for(i = 0; i < 256; i++) {
+		for(j = 1; j < 8; j++)
+			crc_table[j][i] = (crc_table[j-1][i] >> 8) ^ crc_table[0][crc_table[j-1][i] & 0xff];
+	}
+}
+#endif
+
+/***********************************************************************
+* Description:
+* Add the data to the CRC32. The CRC instructions are used when the CPU
+* has them (ARMv8 CRC32 extension), otherwise the slice-by-8 tables take
+* 8 bytes per step.
+*
+* Calling Arguments:
+* Name			Description
+* crc		the running CRC, inverted
+* p			the data
+* leng		length of the data
+*
+* Return Value:
+* the running CRC
+******************************************************************************/
+static uint32_t Crc32Update(uint32_t crc, const uint8_t *p, unsigned int leng) {
+#if defined(__ARM_FEATURE_CRC32)
+	uint64_t word;
+
+	while(leng && ((uintptr_t)p & 7)) {
+		crc = __crc32b(crc, *p++);
+		leng--;
+	}
+	while(leng >= 8) {
+		memcpy(&word, p, 8);
+		crc = __crc32d(crc, word);
+		p += 8;
+		leng -= 8;
+	}
+	while(leng--)
+		crc = __crc32b(crc, *p++);
+#else
+	uint32_t one, two;
+
+	pthread_once(&crc_once, Crc32TableInit);
+	while(leng && ((uintptr_t)p & 3)) {
+		crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		leng--;
+	}
+	while(leng >= 8) {
+		// little endian load, both the targets and the test boxes are LE
+		memcpy(&one, p, 4);
+		memcpy(&two, p + 4, 4);
+		one ^= crc;
+		crc = crc_table[7][one & 0xff] ^ crc_table[6][(one >> 8) & 0xff] ^
+			crc_table[5][(one >> 16) & 0xff] ^ crc_table[4][one >> 24] ^
+			crc_table[3][two & 0xff] ^ crc_table[2][(two >> 8) & 0xff] ^
+			crc_table[1][(two >> 16) & 0xff] ^ crc_table[0][two >> 24];
+		p += 8;
+		leng -= 8;
+	}
+	while(leng--)
+		crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+#endif
+	return crc;
+}
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void Sha256Block(uint32_t *state, const uint8_t *block) {
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	for(i = 0; i < 16; i++)
+		w[i] = (block[i*4] << 24) | (block[i*4+1] << 16) | (block[i*4+2] << 8) | block[i*4+3];
+	for(i = 16; i < 64; i++)
+		w[i] = (ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10)) + w[i-7] +
+			(ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3)) + w[i-16];
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+	for(i = 0; i < 64; i++) {
+		t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void Sha256Update(xfer_digest *digest, const uint8_t *p, unsigned int leng) {
+	unsigned int copy;
+
+	if(digest->sha.fill) {
+		copy = 64 - digest->sha.fill;
+		if(copy > leng)
+			copy = leng;
+		memcpy(digest->sha.block + digest->sha.fill, p, copy);
+		digest->sha.fill += copy;
+		p += copy;
+		leng -= copy;
+		if(digest->sha.fill < 64)
+			return;
+		Sha256Block(digest->sha.state, digest->sha.block);
+		digest->sha.fill = 0;
+	}
+	// whole blocks straight from the caller's buffer
+	while(leng >= 64) {
+		Sha256Block(digest->sha.state, p);
+		p += 64;
+		leng -= 64;
+	}
+	memcpy(digest->sha.block, p, leng);
+	digest->sha.fill = leng;
+}
+
+static void Sha256Final(xfer_digest *digest, uint8_t *hash) {
+	unsigned long long bits = digest->bytes * 8;
+	uint8_t *block = digest->sha.block;
+	unsigned int fill = digest->sha.fill;
+	int i;
+
+	block[fill++] = 0x80;
+	if(fill > 56) {
+		memset(block + fill, 0, 64 - fill);
+		Sha256Block(digest->sha.state, block);
+		fill = 0;
+	}
+	memset(block + fill, 0, 56 - fill);
+	for(i = 0; i < 8; i++)
+		block[56+i] = bits >> (56 - i*8);
+	Sha256Block(digest->sha.state, block);
+
+	for(i = 0; i < 32; i++)
+		hash[i] = digest->sha.state[i/4] >> (24 - (i%4)*8);
+}
+
+// digest.type= of bt_obex.conf
+int DigestParse(const char *spec) {
+	if(!strncmp(spec, DIGEST_KEY_SHA256, strlen(DIGEST_KEY_SHA256)))
+		return DIGEST_SHA256;
+	if(!strncmp(spec, DIGEST_KEY_NONE, strlen(DIGEST_KEY_NONE)))
+		return DIGEST_NONE;
+	return DIGEST_CRC32;
+}
+
+void DigestInit(xfer_digest *digest, const int type) {
+	static const uint32_t sha256_iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memset(digest, 0, sizeof(xfer_digest));
+	digest->type = type;
+	digest->crc = 0xFFFFFFFF;
+	memcpy(digest->sha.state, sha256_iv, sizeof(sha256_iv));
+}
+
+/***********************************************************************
+* Description:
+* Add the data to the digest. Called on the transfer path for every chunk,
+* the data is not copied.
+*
+* Calling Arguments:
+* Name			Description
+* digest		the digest, may be NULL
+* buf		the data
+* leng		length of the data
+*
+* Return Value:
+* none
+******************************************************************************/
+void DigestUpdate(xfer_digest *digest, const void *buf, const unsigned int leng) {
+	if(digest == NULL)
+		return;
+
+	switch(digest->type) {
+		case DIGEST_CRC32:
+			digest->crc = Crc32Update(digest->crc, (const uint8_t *)buf, leng);
+			break;
+		case DIGEST_SHA256:
+			Sha256Update(digest, (const uint8_t *)buf, leng);
+			break;
+	}
+	digest->bytes += leng;
+}
+
+/***********************************************************************
+* Description:
+* Format the digest as "<bytes> CRC32:<hex>" or "<bytes> SHA256:<hex>".
+* The digest can't be updated afterwards.
+*
+* Calling Arguments:
+* Name			Description
+* digest		the digest
+* string		store the formatted digest
+* string_leng	the size of string
+*
+* Return Value:
+* >0: length of the string
+* -1: string is too short, it's left empty rather than holding a cut digest
+******************************************************************************/
+int DigestFinal(xfer_digest *digest, char *string, const int string_leng) {
+	char hex[2*32+1] = {};
+	uint8_t hash[32];
+	int pos = -1, i;
+
+	switch(digest->type) {
+		case DIGEST_CRC32:
+			pos = snprintf(string, string_leng, "%llu CRC32:%08x", digest->bytes, digest->crc ^ 0xFFFFFFFF);
+			break;
+		case DIGEST_SHA256:
+			Sha256Final(digest, hash);
+			for(i = 0; i < 32; i++)
+				sprintf(hex + 2*i, "%02x", hash[i]);
+			pos = snprintf(string, string_leng, "%llu SHA256:%s", digest->bytes, hex);
+			break;
+		default:
+			pos = snprintf(string, string_leng, "%llu", digest->bytes);
+			break;
+	}
+	if(pos < 0 || pos >= string_leng) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %d bytes needed, only %d given\n", __FUNCTION__, pos + 1, string_leng);
+		if(string_leng > 0)
+			string[0] = 0;
+		return -1;
+	}
+	return pos;
+}
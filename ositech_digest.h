@@ -0,0 +1,43 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_digest.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_DIGEST_H
+#define __OSITECH_DIGEST_H
+
+#include <stdint.h>
+
+#define DIGEST_NONE		0
+#define DIGEST_CRC32	1	// IEEE 802.3, same as zlib crc32() and "crc32" of the shell
+#define DIGEST_SHA256	2
+
+#define DIGEST_STRING_LENG	96	// 20 digits of the byte count, " SHA256:", 64 hex digits and NUL
+
+typedef struct xfer_digest {
+	int type;
+	unsigned long long bytes;
+	uint32_t crc;
+	struct {
+		uint32_t state[8];
+		uint8_t block[64];
+		unsigned int fill;
+	} sha;
+} xfer_digest;
+
+extern int DigestParse(const char *spec);
+extern void DigestInit(xfer_digest *digest, const int type);
+extern void DigestUpdate(xfer_digest *digest, const void *buf, const unsigned int leng);
+extern int DigestFinal(xfer_digest *digest, char *string, const int string_leng);
+
+#endif
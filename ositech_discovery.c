@@ -0,0 +1,349 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		discovery in the background. A short inquiry runs
+*				every discovery.interval seconds while no OBEX link is
+*				up, and the devices seen are kept with the time they
+*				were last seen, so AT+BTIN is answered from memory.
+* File Name:			ositech_discovery.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "config.h"
+#include "hci_info.h"
+#include "ositech_budget.h"
+#include "ositech_stats.h"
+#include "ositech_timer.h"
+#include "ositech_discovery.h"
+
+typedef struct disc_entry {
+	inq_dev dev;
+	unsigned long long last_seen;	// StatsNow()
+	int used;
+} disc_entry;
+
+static struct discovery_state {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	disc_entry table[INQ_RESULTS_MAX];
+	int enabled;
+	int interval;		// s between the inquiries
+	int age;			// s a device is fresh after it's seen
+	int paused;			// OBEX links up and live scans running
+	int due;			// an inquiry is waiting for its turn
+	int running;		// the inquiry is on the air
+	int background;		// background jobs of other files on the air, as the name refresh
+	int dev_id;			// the adaptor of the running inquiry
+	bt_timer_t timer;
+} disc = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void DiscoveryTimeout(void *arg) {
+	pthread_mutex_lock(&disc.lock);
+	disc.due = 1;
+	pthread_cond_broadcast(&disc.cond);
+	pthread_mutex_unlock(&disc.lock);
+}
+
+static void DiscoveryResult(const inq_dev *dev, void *arg) {
+	DiscoveryUpdate(dev);
+}
+
+// the inquiries, one every interval, skipped while paused
+static void *DiscoveryThread(void *arg) {
+	int dev_id, found;
+
+	while(1) {
+		pthread_mutex_lock(&disc.lock);
+		while(!disc.due || disc.paused)
+			pthread_cond_wait(&disc.cond, &disc.lock);
+		disc.due = 0;
+		if((dev_id = GetBTDevID()) >= 0) {
+			disc.dev_id = dev_id;
+			disc.running = 1;
+		}
+		pthread_mutex_unlock(&disc.lock);
+
+		if(dev_id >= 0) {
+			found = InqRun(dev_id, DISCOVERY_LENGTH, INQ_RUN_BACKGROUND, NULL, DiscoveryResult, NULL);
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %d BT devs seen\n", __FUNCTION__, found);
+			pthread_mutex_lock(&disc.lock);
+			disc.running = 0;
+			pthread_mutex_unlock(&disc.lock);
+		}
+
+		if(TimerStart(&disc.timer, disc.interval * 1000) < 0) {
+			sleep(disc.interval);
+			DiscoveryTimeout(NULL);
+		}
+	}
+	return NULL;
+}
+
+/***********************************************************************
+* Description:
+* Start the discovery in the background. The first inquiry runs right
+* away.
+*
+* Calling Arguments:
+* Name			Description
+* interval	s between the inquiries, 0 for no discovery
+* age		s a device is given to AT+BTIN after it's seen, 0 for 3 intervals
+*
+* Return Value:
+* 0: success, or no discovery
+* -1: the interval is below DISCOVERY_INTERVAL_MIN and is raised to it,
+*     or the thread can't be started
+******************************************************************************/
+int DiscoveryStart(const int interval, const int age) {
+	pthread_t thread;
+	pthread_attr_t attr;
+	int ret = 0;
+
+	if(interval <= 0 || disc.enabled)
+		return 0;
+
+	disc.interval = interval;
+	if(disc.interval < DISCOVERY_INTERVAL_MIN) {
+		disc.interval = DISCOVERY_INTERVAL_MIN;
+		ret = -1;
+	}
+	disc.age = (age > 0) ? age : 3 * disc.interval;
+	TimerInit(&disc.timer, DiscoveryTimeout, NULL);
+	disc.due = 1;
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, DiscoveryThread, NULL) != 0) {
+		perror("pthread_create() of the discovery failed");
+		pthread_attr_destroy(&attr);
+		return -1;
+	}
+	pthread_attr_destroy(&attr);
+
+	pthread_mutex_lock(&disc.lock);
+	disc.enabled = 1;
+	pthread_mutex_unlock(&disc.lock);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: an inquiry every %d s, devices kept %d s\n", __FUNCTION__, disc.interval, disc.age);
+	return ret;
+}
+
+int DiscoveryEnabled(void) {
+	int enabled;
+
+	pthread_mutex_lock(&disc.lock);
+	enabled = disc.enabled;
+	pthread_mutex_unlock(&disc.lock);
+	return enabled;
+}
+
+/***********************************************************************
+* Description:
+* Keep a device found by an inquiry. A name read before is kept when this
+* inquiry couldn't read it. The device seen the longest ago gives way when
+* the table is full.
+*
+* Calling Arguments:
+* Name			Description
+* dev		the device
+*
+* Return Value:
+* none
+******************************************************************************/
+void DiscoveryUpdate(const inq_dev *dev) {
+	disc_entry *entry = NULL, *oldest = NULL;
+	int i;
+
+	pthread_mutex_lock(&disc.lock);
+	for(i = 0; i < INQ_RESULTS_MAX; i++) {
+		if(!disc.table[i].used) {
+			if(!entry)
+				entry = &disc.table[i];
+			continue;
+		}
+		if(!bacmp(&disc.table[i].dev.bdaddr, &dev->bdaddr)) {
+			entry = &disc.table[i];
+			break;
+		}
+		if(!oldest || disc.table[i].last_seen < oldest->last_seen)
+			oldest = &disc.table[i];
+	}
+	if(!entry)
+		entry = oldest;
+
+	if(entry->used && !bacmp(&entry->dev.bdaddr, &dev->bdaddr) &&
+		entry->dev.name_state == INQ_NAME_DONE && dev->name_state != INQ_NAME_DONE) {
+		memcpy(entry->dev.dev_class, dev->dev_class, sizeof(entry->dev.dev_class));
+		entry->dev.pscan_rep_mode = dev->pscan_rep_mode;
+		entry->dev.clock_offset = dev->clock_offset;
+		entry->dev.rssi = dev->rssi;
+		if(dev->nuuid) {
+			memcpy(entry->dev.uuid16, dev->uuid16, sizeof(entry->dev.uuid16));
+			entry->dev.nuuid = dev->nuuid;
+		}
+	} else
+		entry->dev = *dev;
+	entry->last_seen = StatsNow();
+	entry->used = 1;
+	pthread_mutex_unlock(&disc.lock);
+}
+
+/***********************************************************************
+* Description:
+* Give the devices seen within the age of the discovery to cb, the one
+* seen last first.
+*
+* Calling Arguments:
+* Name			Description
+* cb		called for every device, without the table locked
+* arg		given to cb
+*
+* Return Value:
+* the devices given to cb, 0 if there is no discovery
+******************************************************************************/
+int DiscoveryList(inq_result_cb cb, void *arg) {
+	disc_entry *fresh;
+	disc_entry tmp;
+	unsigned long long now = StatsNow();
+	int num = 0, i, j;
+
+	if((fresh = malloc(sizeof(disc.table))) == NULL)
+		return 0;
+
+	pthread_mutex_lock(&disc.lock);
+	if(disc.enabled) {
+		for(i = 0; i < INQ_RESULTS_MAX; i++) {
+			if(disc.table[i].used && now - disc.table[i].last_seen <= disc.age * 1000000ULL)
+				fresh[num++] = disc.table[i];
+		}
+	}
+	pthread_mutex_unlock(&disc.lock);
+
+	for(i = 1; i < num; i++) {
+		tmp = fresh[i];
+		for(j = i; j > 0 && fresh[j - 1].last_seen < tmp.last_seen; j--)
+			fresh[j] = fresh[j - 1];
+		fresh[j] = tmp;
+	}
+	for(i = 0; i < num; i++)
+		cb(&fresh[i].dev, arg);
+
+	free(fresh);
+	return num;
+}
+
+/***********************************************************************
+* Description:
+* Find a device seen within the age of the discovery, for its page scan
+* mode and clock offset.
+*
+* Calling Arguments:
+* Name			Description
+* bdaddr	the address of the device
+* dev		the device, filled in when it's found
+*
+* Return Value:
+* 0: found
+* -1: not seen lately, or no discovery
+******************************************************************************/
+int DiscoveryLookup(const bdaddr_t *bdaddr, inq_dev *dev) {
+	unsigned long long now = StatsNow();
+	int ret = -1, i;
+
+	pthread_mutex_lock(&disc.lock);
+	for(i = 0; disc.enabled && i < INQ_RESULTS_MAX; i++) {
+		if(disc.table[i].used && !bacmp(&disc.table[i].dev.bdaddr, bdaddr) &&
+			now - disc.table[i].last_seen <= disc.age * 1000000ULL) {
+			*dev = disc.table[i].dev;
+			ret = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&disc.lock);
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Keep the discovery off the air, for an OBEX link or a live scan. The
+* running inquiry and the background jobs are cancelled. Every DiscoveryPause() is followed by a
+* DiscoveryResume().
+*
+* Calling Arguments:
+* Name			Description
+* None
+*
+* Return Value:
+* none
+******************************************************************************/
+void DiscoveryPause(void) {
+	pthread_mutex_lock(&disc.lock);
+	disc.paused++;
+	if((disc.running || disc.background) && InqCancel(disc.dev_id) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the inquiry can't be cancelled\n", __FUNCTION__);
+	}
+	pthread_mutex_unlock(&disc.lock);
+}
+
+void DiscoveryResume(void) {
+	pthread_mutex_lock(&disc.lock);
+	if(disc.paused > 0 && --disc.paused == 0)
+		pthread_cond_broadcast(&disc.cond);
+	pthread_mutex_unlock(&disc.lock);
+}
+
+/***********************************************************************
+* Description:
+* Wait until the discovery isn't paused, then take the adaptor for a
+* background job of another file, as the name refresh. DiscoveryPause()
+* cancels the job as it does the inquiry, so it has to run with
+* INQ_RUN_BACKGROUND. Every job taken is ended by DiscoveryBackgroundEnd().
+*
+* Calling Arguments:
+* Name			Description
+* None
+*
+* Return Value:
+* >=0: the adaptor
+* -1: no adaptor, there is nothing to end
+******************************************************************************/
+int DiscoveryBackgroundBegin(void) {
+	int dev_id;
+
+	pthread_mutex_lock(&disc.lock);
+	while(disc.paused)
+		pthread_cond_wait(&disc.cond, &disc.lock);
+	if((dev_id = GetBTDevID()) >= 0) {
+		disc.dev_id = dev_id;
+		disc.background++;
+	}
+	pthread_mutex_unlock(&disc.lock);
+	return dev_id;
+}
+
+void DiscoveryBackgroundEnd(void) {
+	pthread_mutex_lock(&disc.lock);
+	if(disc.background > 0)
+		disc.background--;
+	pthread_mutex_unlock(&disc.lock);
+}
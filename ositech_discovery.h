@@ -0,0 +1,34 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_discovery.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_DISCOVERY_H
+#define __OSITECH_DISCOVERY_H
+
+#include "ositech_inquiry.h"
+
+#define DISCOVERY_LENGTH		4		// 5.12 s inquiries in the background
+#define DISCOVERY_INTERVAL_MIN	30		// discovery.interval, s, keeps the inquiries under 20% of the air
+
+extern int DiscoveryStart(const int interval, const int age);
+extern int DiscoveryEnabled(void);
+extern void DiscoveryUpdate(const inq_dev *dev);
+extern int DiscoveryList(inq_result_cb cb, void *arg);
+extern int DiscoveryLookup(const bdaddr_t *bdaddr, inq_dev *dev);
+extern void DiscoveryPause(void);
+extern void DiscoveryResume(void);
+extern int DiscoveryBackgroundBegin(void);
+extern void DiscoveryBackgroundEnd(void);
+
+#endif
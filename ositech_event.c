@@ -0,0 +1,145 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		poll() based event loop of one OBEX request. The
+*					request builds it on its stack with the OBEX
+*					connection, the cancel eventfd and the MRx socket,
+*					and runs it until the response; the timer wheel
+*					keeps its own thread.
+* File Name:			ositech_event.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_event.h"
+
+void EventLoopInit(event_loop_t *loop) {
+	memset(loop, 0, sizeof(event_loop_t));
+}
+
+static int EventFind(event_loop_t *loop, const int fd) {
+	int i;
+
+	for(i = 0; i < loop->nfds; i++) {
+		if(loop->pfd[i].fd == fd)
+			return i;
+	}
+	return -1;
+}
+
+/*********************************************************************** 
+* Description:
+* Watch the fd in the loop. The callback is called from EventLoopRun()
+* whenever poll() reports one of the events (or an error) on the fd.
+*
+* Calling Arguments: 
+* Name			Description 
+* loop		the event loop
+* fd		the watched fd
+* events		POLLIN, POLLOUT...
+* cb		the callback
+* arg		argument given to the callback
+*
+* Return Value: 
+* 0: success
+* -1: fail, the loop is full or the fd is already watched
+******************************************************************************/
+int EventAdd(event_loop_t *loop, const int fd, const short events, event_cb cb, void *arg) {
+	int i;
+
+	if(fd < 0 || EventFind(loop, fd) >= 0 || loop->nfds >= EVENT_MAX_FDS) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s can't watch fd %d\n", __FUNCTION__, fd);
+		return -1;
+	}
+
+	i = loop->nfds++;
+	loop->pfd[i].fd = fd;
+	loop->pfd[i].events = events;
+	loop->pfd[i].revents = 0;
+	loop->handler[i].cb = cb;
+	loop->handler[i].arg = arg;
+
+	return 0;
+}
+
+// callbacks may remove any fd, including their own, while the loop is dispatching
+void EventDel(event_loop_t *loop, const int fd) {
+	int i = EventFind(loop, fd);
+
+	if(i < 0)
+		return;
+
+	loop->nfds--;
+	if(i != loop->nfds) {
+		memmove(&loop->pfd[i], &loop->pfd[i+1], (loop->nfds-i)*sizeof(struct pollfd));
+		memmove(&loop->handler[i], &loop->handler[i+1], (loop->nfds-i)*sizeof(event_handler_t));
+	}
+}
+
+void EventLoopStop(event_loop_t *loop) {
+	loop->stop = 1;
+}
+
+/*********************************************************************** 
+* Description:
+* Run the loop until EventLoopStop() is called by a callback, or nothing
+* happens on any fd for idle_msec.
+*
+* Calling Arguments: 
+* Name			Description 
+* loop		the event loop
+* idle_msec		the idle timeout, -1 for none
+*
+* Return Value: 
+* EVENT_STOP: stopped by a callback
+* EVENT_TIMEOUT: idle timeout
+* EVENT_ERROR: poll() failed or nothing is watched anymore
+******************************************************************************/
+int EventLoopRun(event_loop_t *loop, const int idle_msec) {
+	struct pollfd ready[EVENT_MAX_FDS];
+	int i, j, n, res;
+
+	loop->stop = 0;
+	while(!loop->stop) {
+		if(!loop->nfds)
+			return EVENT_ERROR;
+
+		if((res = poll(loop->pfd, loop->nfds, idle_msec)) < 0) {
+			if(errno == EINTR)
+				continue;
+			perror("EventLoopRun: poll() failed");
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s poll() -- %s\n", __FUNCTION__, strerror(errno));
+			return EVENT_ERROR;
+		} else if(!res)
+			return EVENT_TIMEOUT;
+
+		// snapshot the ready fds, the callbacks are free to change the loop
+		n = loop->nfds;
+		memcpy(ready, loop->pfd, n*sizeof(struct pollfd));
+		for(i = 0; i < n && !loop->stop; i++) {
+			if(!ready[i].revents)
+				continue;
+			if((j = EventFind(loop, ready[i].fd)) < 0)
+				continue;
+			loop->handler[j].cb(ready[i].fd, ready[i].revents, loop->handler[j].arg);
+		}
+	}
+
+	return EVENT_STOP;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_event.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_EVENT_H
+#define __OSITECH_EVENT_H
+
+#include <poll.h>
+
+#define EVENT_MAX_FDS	32
+
+// EventLoopRun() results
+#define EVENT_STOP		1
+#define EVENT_TIMEOUT	0
+#define EVENT_ERROR		-1
+
+typedef void (*event_cb)(int fd, short revents, void *arg);
+
+typedef struct event_handler {
+	event_cb cb;
+	void *arg;
+} event_handler_t;
+
+typedef struct event_loop {
+	struct pollfd pfd[EVENT_MAX_FDS];
+	event_handler_t handler[EVENT_MAX_FDS];
+	int nfds;
+	int stop;
+} event_loop_t;
+
+extern void EventLoopInit(event_loop_t *loop);
+extern int EventAdd(event_loop_t *loop, const int fd, const short events, event_cb cb, void *arg);
+extern void EventDel(event_loop_t *loop, const int fd);
+extern void EventLoopStop(event_loop_t *loop);
+extern int EventLoopRun(event_loop_t *loop, const int idle_msec);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		PUT of one file to many peers at the same time. The file
+*				is read once, and every OBEX session sends from the same
+*				memory.
+* File Name:			ositech_fanout.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#define _FILE_OFFSET_BITS 64	// files beyond 2GB
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_obex.h"
+#include "ositech_stats.h"
+#include "ositech_budget.h"
+#include "ositech_fanout.h"
+
+#define FANOUT_NAME_LENG	512
+
+/*
+ the data of the file, shared by the sessions. Every worker holds a reference
+ while it sends, the memory is released with the last reference.
+*/
+typedef struct fanout_source {
+	pthread_mutex_t lock;
+	int refs;
+	const uint8_t *data;	// NULL if every session reads the file on its own
+	uint32_t size;
+	char filename[FANOUT_NAME_LENG];
+	char remotename[FANOUT_NAME_LENG];
+} fanout_src;
+
+typedef struct fanout_job {
+	pthread_mutex_t lock;
+	fanout_src *src;
+	fanout_result *results;
+	int npeers;
+	int next;		// next peer to be taken by a worker
+} fanout_job;
+
+static const uint8_t fanout_empty[1];
+
+static const char *fanout_stage[] = {
+	"NONE",
+	"SDP",
+	"CONNECT",
+	"PUT",
+	"DONE",
+};
+
+const char *FanoutStageString(const int stage) {
+	if(stage < 0 || stage > FANOUT_STAGE_DONE)
+		return fanout_stage[0];
+	return fanout_stage[stage];
+}
+
+static void SourceGet(fanout_src *src) {
+	pthread_mutex_lock(&src->lock);
+	src->refs++;
+	pthread_mutex_unlock(&src->lock);
+}
+
+static void SourcePut(fanout_src *src) {
+	int refs;
+
+	pthread_mutex_lock(&src->lock);
+	refs = --src->refs;
+	pthread_mutex_unlock(&src->lock);
+	if(refs)
+		return;
+
+	if(src->data && src->data != fanout_empty)
+		free((void *)src->data);
+	pthread_mutex_destroy(&src->lock);
+	free(src);
+}
+
+/***********************************************************************
+* Description:
+* Read the file once for all the peers, into memory if it fits in the copy
+* share of the memory budget and can be allocated, otherwise every session
+* reads the file on its own. The file isn't mapped: a file truncated or
+* rewritten during the fan-out must not take the daemon down with a
+* SIGBUS, the sessions send the copy taken here. The OBEX memory source is 32-bit, a file of 4GB or
+* more is refused.
+*
+* Calling Arguments:
+* Name			Description
+* filename	the local file
+*
+* Return Value:
+* the source, with one reference held by the caller
+* NULL: fail
+******************************************************************************/
+static fanout_src *SourceOpen(const char *filename) {
+	fanout_src *src;
+	const char *psplit;
+	struct stat st;
+	uint8_t *buf;
+	ssize_t rd_sz;
+	uint32_t total = 0;
+	int fd;
+
+	if((fd = open(filename, O_RDONLY)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - open() %s failed %s\n", __FUNCTION__, filename, strerror(errno));
+		return NULL;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size > UINT32_MAX) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - %s can't be sent from memory\n", __FUNCTION__, filename);
+		close(fd);
+		return NULL;
+	}
+	if((src = (fanout_src *)calloc(1, sizeof(fanout_src))) == NULL) {
+		close(fd);
+		return NULL;
+	}
+	pthread_mutex_init(&src->lock, NULL);
+	src->refs = 1;
+	src->size = st.st_size;
+	snprintf(src->filename, sizeof(src->filename), "%s", filename);
+	psplit = strrchr(filename, '/');
+	snprintf(src->remotename, sizeof(src->remotename), "%s", psplit ? psplit+1 : filename);
+
+	if(!src->size) {
+		src->data = fanout_empty;
+	} else if(src->size > BudgetGet()->copy) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s is beyond the memory budget, streamed by every session\n", __FUNCTION__, filename);
+	} else if((buf = (uint8_t *)malloc(src->size)) != NULL) {
+		while(total < src->size && (rd_sz = read(fd, buf + total, src->size - total)) != 0) {
+			if(rd_sz < 0) {
+				if(errno == EINTR)
+					continue;
+				break;
+			}
+			total += rd_sz;
+		}
+		src->data = buf;
+		if(total != src->size) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - read() %s failed\n", __FUNCTION__, filename);
+			SourcePut(src);
+			src = NULL;
+		}
+	} else {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: malloc() %u bytes failed, %s streamed by every session\n", __FUNCTION__, (unsigned int)st.st_size, filename);
+	}
+	close(fd);
+
+	return src;
+}
+
+// SDP, connection, PUT and disconnection of one peer
+static void FanoutPeer(fanout_src *src, fanout_result *result) {
+	unsigned long long start = StatsNow();
+	unsigned char *client = NULL;
+	obexftp_client_t *cli;
+	int channel = 0;
+
+	result->stage = FANOUT_STAGE_SDP;
+	if(ObexTransportIsBT() && (result->res = SearchBTwithObex(result->addr, &channel)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: NO OBEX service found on %s\n", __FUNCTION__, result->addr);
+		goto end;
+	}
+
+	result->stage = FANOUT_STAGE_CONNECT;
+	if(EstablisBTConnection(result->addr, channel, &client) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: connect with %s failed\n", __FUNCTION__, result->addr);
+		result->res = NO_CARRIER;
+		goto end;
+	}
+	cli = (obexftp_client_t *)client;
+
+	result->stage = FANOUT_STAGE_PUT;
+	if(src->data)
+		result->res = FTPTransBuffer(cli, src->remotename, src->data, src->size, result->addr);
+	else
+		result->res = FTPTransFile(cli, src->filename, FTPFROMFILE, 0, result->addr);
+	if(result->res > 0)
+		result->stage = FANOUT_STAGE_DONE;
+	ReleasBTConnection(cli);
+
+end:
+	result->ms = (StatsNow() - start) / 1000;
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %s res %d in %u ms\n", __FUNCTION__, result->addr, FanoutStageString(result->stage), result->res, result->ms);
+}
+
+static void *FanoutWorker(void *arg) {
+	fanout_job *job = (fanout_job *)arg;
+	int index;
+
+	SourceGet(job->src);
+	for(;;) {
+		pthread_mutex_lock(&job->lock);
+		index = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if(index >= job->npeers)
+			break;
+		FanoutPeer(job->src, &job->results[index]);
+	}
+	SourcePut(job->src);
+
+	return NULL;
+}
+
+/***********************************************************************
+* Description:
+* PUT one file to many peers. The file is read once, and up to max_links
+* OBEX sessions send it at the same time, each from its own worker. A
+* worker takes the next peer as soon as its session is done, so the total
+* time is close to the one of the slowest peer. max_links is capped by the
+* memory budget, and on Bluetooth by the ACL links of the adapter.
+*
+* Calling Arguments:
+* Name			Description
+* filename	the local file
+* results	one entry per peer, the addr is given by the caller
+* npeers		number of peers
+* max_links	sessions at the same time, 0 for the most the adapter has
+*
+* Return Value:
+* number of peers which got the file
+* -1: the file can't be read
+******************************************************************************/
+int FanoutPut(const char *filename, fanout_result *results, const int npeers, const int max_links) {
+	pthread_t workers[FANOUT_MAX_PEERS];
+	pthread_attr_t attr;
+	fanout_job job;
+	int nworkers = max_links;
+	int index, started = 0, success = 0;
+
+	if(npeers <= 0 || npeers > FANOUT_MAX_PEERS)
+		return -1;
+
+	memset(&job, 0, sizeof(job));
+	if((job.src = SourceOpen(filename)) == NULL)
+		return -1;
+	pthread_mutex_init(&job.lock, NULL);
+	job.results = results;
+	job.npeers = npeers;
+	for(index = 0; index < npeers; index++) {
+		results[index].res = -1;
+		results[index].stage = 0;
+		results[index].ms = 0;
+	}
+
+	if(nworkers <= 0 || (ObexTransportIsBT() && nworkers > FANOUT_MAX_LINKS))
+		nworkers = ObexTransportIsBT() ? FANOUT_MAX_LINKS : npeers;
+	if(BudgetGet()->sessions && nworkers > BudgetGet()->sessions)
+		nworkers = BudgetGet()->sessions;
+	if(nworkers > npeers)
+		nworkers = npeers;
+
+	printf("PUT %s (%u bytes) to %d peers, %d at a time\n", job.src->remotename, job.src->size, npeers, nworkers);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %u bytes to %d peers, %d sessions\n", __FUNCTION__, filename, job.src->size, npeers, nworkers);
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	for(index = 0; index < nworkers; index++) {
+		if(pthread_create(&workers[index], &attr, FanoutWorker, &job)) {
+			perror("FanoutPut: pthread_create() failed");
+			break;
+		}
+		started++;
+	}
+	pthread_attr_destroy(&attr);
+	// no worker at all, send from this thread
+	if(!started)
+		FanoutWorker(&job);
+	for(index = 0; index < started; index++)
+		pthread_join(workers[index], NULL);
+
+	SourcePut(job.src);
+	pthread_mutex_destroy(&job.lock);
+
+	for(index = 0; index < npeers; index++) {
+		if(results[index].res > 0)
+			success++;
+	}
+	return success;
+}
@@ -0,0 +1,40 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_fanout.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_FANOUT_H
+#define __OSITECH_FANOUT_H
+
+#include "ositech_bt.h"
+
+#define FANOUT_MAX_LINKS	7	// active ACL links of a piconet master
+#define FANOUT_MAX_PEERS	32
+
+// where the PUT of a peer stopped
+#define FANOUT_STAGE_SDP		1
+#define FANOUT_STAGE_CONNECT	2
+#define FANOUT_STAGE_PUT		3
+#define FANOUT_STAGE_DONE		4
+
+typedef struct fanout_result {
+	char addr[BT_ADDR_LENGTH];	// given by the caller
+	int res;		// 1: success, 0: refused by the peer, < 0: error
+	int stage;		// FANOUT_STAGE_*
+	unsigned int ms;	// SDP, connection and PUT of the peer
+} fanout_result;
+
+extern int FanoutPut(const char *filename, fanout_result *results, const int npeers, const int max_links);
+extern const char *FanoutStageString(const int stage);
+
+#endif
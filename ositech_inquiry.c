@@ -0,0 +1,933 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		inquiry through the HCI event socket of the adaptor.
+*				The devices are taken from the Inquiry Result events as
+*				they arrive, with their name and services of the
+*				Extended Inquiry Response. The devices without an EIR
+*				name get remote name requests, sent as raw HCI commands,
+*				several at a time, matched by the device address.
+* File Name:			ositech_inquiry.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+#include "config.h"
+#include "ositech_stats.h"
+#include "ositech_communication.h"
+#include "ositech_inquiry.h"
+#include "ositech_names.h"
+
+#define INQ_EVENT_SIZE		(HCI_MAX_EVENT_SIZE + 1)
+#define INQ_STATUS_DISALLOWED	0x0C	// Command Disallowed, too many pages at once
+#define INQ_LENGTH_UNIT_MS	1280	// Inquiry_Length is in units of 1.28 s
+#define INQ_COMPLETE_SLACK_MS	2000	// Inquiry Complete is given up this long after the inquiry length
+#define INQ_MODE_EXTENDED		0x02	// Inquiry Result with RSSI or Extended Inquiry Result
+
+// EIR data types of the Bluetooth assigned numbers
+#define EIR_UUID16_SOME			0x02
+#define EIR_UUID16_ALL			0x03
+#define EIR_UUID32_SOME			0x04
+#define EIR_UUID32_ALL			0x05
+#define EIR_UUID128_SOME		0x06
+#define EIR_UUID128_ALL			0x07
+#define EIR_NAME_SHORT			0x08
+#define EIR_NAME_COMPLETE		0x09
+
+static int inq_results = DEFAULT_INQUIRY_RESULTS;
+static int inq_length = DEFAULT_INQUIRY_LENGTH;
+/*
+ one inquiry or name request session of the daemon at a time. The controller
+ refuses a second inquiry, and the Command Status of a name request doesn't
+ tell which request it's for: a session takes every one seen while its own
+ requests wait for theirs.
+*/
+static pthread_mutex_t inq_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct inq_session {
+	int dd;
+	inq_dev *devs;
+	int ndevs;
+	int max;			// room of devs
+	int inquiring;		// Inquiry Complete not seen yet
+	int flags;			// INQ_RUN_*
+	int cancel_sent;	// our Inquiry Cancel commands not completed
+	const inq_filter *filter;	// NULL: every device
+	unsigned long long inq_deadline;
+	int done;			// devices given to cb
+	int outstanding;	// name requests sent and not completed
+	int limit;			// name requests allowed at the same time
+	int status_wait[INQ_NAME_PARALLEL];	// devices waiting for the Command Status, oldest first
+	int nstatus;
+	inq_result_cb cb;
+	void *arg;
+} inq_session;
+
+static void NameFinish(inq_session *sess, inq_dev *dev, const int state) {
+	if(dev->name_state == INQ_NAME_PENDING)
+		sess->outstanding--;
+	// the shortened name of the EIR, when the complete one can't be read
+	dev->name_state = (state == INQ_NAME_FAILED && strlen(dev->name)) ? INQ_NAME_DONE : state;
+	sess->done++;
+	if(!sess->filter || InqFilterMatch(sess->filter, dev, 1))
+		sess->cb(dev, sess->arg);
+}
+
+static int NameRequest(inq_session *sess, inq_dev *dev) {
+	remote_name_req_cp cp;
+
+	memset(&cp, 0, sizeof(cp));
+	bacpy(&cp.bdaddr, &dev->bdaddr);
+	cp.pscan_rep_mode = dev->pscan_rep_mode;
+	cp.clock_offset = dev->clock_offset;
+
+	if(hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_REMOTE_NAME_REQ, REMOTE_NAME_REQ_CP_SIZE, &cp) < 0)
+		return -1;
+	dev->name_state = INQ_NAME_PENDING;
+	dev->deadline = StatsNow() + INQ_NAME_TIMEOUT_MS * 1000ULL;
+	sess->outstanding++;
+	sess->status_wait[sess->nstatus++] = dev - sess->devs;
+	return 0;
+}
+
+// send name requests up to the limit, the devices are taken in the order found
+static void NameRequestMore(inq_session *sess) {
+	int i;
+
+	for(i = 0; i < sess->ndevs && sess->outstanding < sess->limit && sess->nstatus < INQ_NAME_PARALLEL; i++) {
+		if(sess->devs[i].name_state != INQ_NAME_NONE)
+			continue;
+		if(NameRequest(sess, &sess->devs[i]) < 0) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s hci_send_cmd() failed %s\n", __FUNCTION__, strerror(errno));
+			NameFinish(sess, &sess->devs[i], INQ_NAME_FAILED);
+		}
+	}
+}
+
+static void InquiryStop(inq_session *sess) {
+	if(!sess->inquiring)
+		return;
+	if(hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_INQUIRY_CANCEL, 0, NULL) >= 0)
+		sess->cancel_sent++;
+	sess->inquiring = 0;
+}
+
+// a background inquiry cancelled by someone else gives up its names too
+static void SessionYield(inq_session *sess) {
+	remote_name_req_cancel_cp cp;
+	int i;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: the inquiry is cancelled, %d names not read\n", __FUNCTION__, sess->ndevs - sess->done);
+	sess->inquiring = 0;
+	sess->limit = 0;
+	for(i = 0; i < sess->ndevs; i++) {
+		if(sess->devs[i].name_state == INQ_NAME_PENDING) {
+			bacpy(&cp.bdaddr, &sess->devs[i].bdaddr);
+			hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_REMOTE_NAME_REQ_CANCEL, REMOTE_NAME_REQ_CANCEL_CP_SIZE, &cp);
+			NameFinish(sess, &sess->devs[i], INQ_NAME_FAILED);
+		} else if(sess->devs[i].name_state == INQ_NAME_NONE)
+			NameFinish(sess, &sess->devs[i], INQ_NAME_FAILED);
+	}
+}
+
+static void EirAddUuid(inq_dev *dev, const uint16_t uuid) {
+	int i;
+
+	for(i = 0; i < dev->nuuid; i++) {
+		if(dev->uuid16[i] == uuid)
+			return;
+	}
+	if(dev->nuuid < INQ_EIR_UUIDS)
+		dev->uuid16[dev->nuuid++] = uuid;
+}
+
+/***********************************************************************
+* Description:
+* Parse the Extended Inquiry Response of a device into its name and
+* services. 32-bit and 128-bit UUIDs are kept when they are 16-bit ones
+* on the Bluetooth base UUID.
+*
+* Calling Arguments:
+* Name			Description
+* dev		the device
+* eir		the EIR data, a list of <length><type><data>
+* eir_len	bytes of eir
+*
+* Return Value:
+* 1: the EIR has the complete name
+* 0: no name, or a shortened one
+******************************************************************************/
+static int EirParse(inq_dev *dev, const uint8_t *eir, const int eir_len) {
+	// the Bluetooth base UUID 0000xxxx-0000-1000-8000-00805F9B34FB, little endian
+	static const uint8_t base_uuid[12] = { 0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00 };
+	int pos = 0, field_len, data_len, complete = 0, i;
+	const uint8_t *data;
+
+	while(pos < eir_len && (field_len = eir[pos]) != 0) {
+		if(pos + 1 + field_len > eir_len)
+			break;
+		data = &eir[pos + 2];
+		data_len = field_len - 1;
+		switch(eir[pos + 1]) {
+			case EIR_UUID16_SOME:
+			case EIR_UUID16_ALL:
+				for(i = 0; i + 2 <= data_len; i += 2)
+					EirAddUuid(dev, data[i] | (data[i + 1] << 8));
+				break;
+			case EIR_UUID32_SOME:
+			case EIR_UUID32_ALL:
+				for(i = 0; i + 4 <= data_len; i += 4) {
+					if(!data[i + 2] && !data[i + 3])
+						EirAddUuid(dev, data[i] | (data[i + 1] << 8));
+				}
+				break;
+			case EIR_UUID128_SOME:
+			case EIR_UUID128_ALL:
+				for(i = 0; i + 16 <= data_len; i += 16) {
+					if(!memcmp(&data[i], base_uuid, sizeof(base_uuid)) && !data[i + 14] && !data[i + 15])
+						EirAddUuid(dev, data[i + 12] | (data[i + 13] << 8));
+				}
+				break;
+			case EIR_NAME_SHORT:
+			case EIR_NAME_COMPLETE:
+				if(complete || data_len <= 0)
+					break;
+				if(data_len >= (int)sizeof(dev->name))
+					data_len = sizeof(dev->name) - 1;
+				memcpy(dev->name, data, data_len);
+				dev->name[data_len] = '\0';
+				complete = (eir[pos + 1] == EIR_NAME_COMPLETE);
+				break;
+			default:
+				break;
+		}
+		pos += 1 + field_len;
+	}
+	return complete;
+}
+
+/***********************************************************************
+* Description:
+* Take a device of an Inquiry Result, the same device answers several
+* times. A device not matching the filter is left out before its name is
+* read. A complete name of its EIR, or a name known already, is given
+* without a name request.
+*
+* Calling Arguments:
+* Name			Description
+* sess		the inquiry
+* bdaddr, pscan_rep_mode, dev_class, clock_offset, rssi	of the result
+* eir		the Extended Inquiry Response, NULL for the other results
+* eir_len	bytes of eir
+*
+* Return Value:
+* none
+******************************************************************************/
+static void InquiryAdd(inq_session *sess, const bdaddr_t *bdaddr, const uint8_t pscan_rep_mode,
+	const uint8_t *dev_class, const uint16_t clock_offset, const int8_t rssi, const uint8_t *eir, const int eir_len) {
+	inq_dev *dev;
+	char name[BT_NAME_LENGTH];
+	int complete, i;
+
+	for(i = 0; i < sess->ndevs; i++) {
+		if(!bacmp(&sess->devs[i].bdaddr, bdaddr)) {
+			sess->devs[i].rssi = rssi;
+			return;
+		}
+	}
+	if(sess->ndevs >= sess->max)
+		return;
+
+	dev = &sess->devs[sess->ndevs];
+	memset(dev, 0, sizeof(*dev));
+	bacpy(&dev->bdaddr, bdaddr);
+	memcpy(dev->dev_class, dev_class, sizeof(dev->dev_class));
+	dev->pscan_rep_mode = pscan_rep_mode;
+	dev->clock_offset = clock_offset;
+	dev->rssi = rssi;
+	dev->name_state = INQ_NAME_NONE;
+	complete = eir ? EirParse(dev, eir, eir_len) : 0;
+	// a weak answer is left out, the device may answer again stronger
+	if(sess->filter && !InqFilterMatch(sess->filter, dev, 0))
+		return;
+	sess->ndevs++;
+
+	if(complete) {
+		NamesPut(bdaddr, dev->name);
+		NameFinish(sess, dev, INQ_NAME_DONE);
+	} else if(NamesGet(bdaddr, name, sizeof(name)) == 0) {
+		memcpy(dev->name, name, sizeof(dev->name));
+		NameFinish(sess, dev, INQ_NAME_DONE);
+	}
+	if(sess->ndevs >= sess->max) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %d devices found, the inquiry is cancelled\n", __FUNCTION__, sess->ndevs);
+		InquiryStop(sess);
+	} else if(sess->filter && sess->filter->ntargets && sess->inquiring) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: a target is found, the inquiry is cancelled\n", __FUNCTION__);
+		InquiryStop(sess);
+	}
+}
+
+/***********************************************************************
+* Description:
+* Take the devices of an Inquiry Result event. The standard and the RSSI
+* results carry several devices, the extended result one. Some
+* controllers still put the Page_Scan_Mode in the RSSI result, told apart
+* by the size of a device.
+*
+* Calling Arguments:
+* Name			Description
+* sess		the inquiry
+* evt		the event code
+* ptr		the parameters of the event
+* plen		bytes of ptr
+*
+* Return Value:
+* none
+******************************************************************************/
+static void InquiryResult(inq_session *sess, const uint8_t evt, const unsigned char *ptr, const int plen) {
+	const inquiry_info *info;
+	const inquiry_info_with_rssi *info_rssi;
+	const inquiry_info_with_rssi_and_pscan_mode *info_mode;
+	const extended_inquiry_info *info_ext;
+	int num, i;
+
+	if(!sess->inquiring || plen < 1 || (num = ptr[0]) == 0)
+		return;
+	ptr++;
+
+	switch(evt) {
+		case EVT_INQUIRY_RESULT:
+			if(plen < 1 + num * INQUIRY_INFO_SIZE)
+				return;
+			for(i = 0; i < num; i++) {
+				info = (const inquiry_info *)(ptr + i * INQUIRY_INFO_SIZE);
+				InquiryAdd(sess, &info->bdaddr, info->pscan_rep_mode, info->dev_class, info->clock_offset, 0, NULL, 0);
+			}
+			break;
+		case EVT_INQUIRY_RESULT_WITH_RSSI:
+			if((plen - 1) / num == INQUIRY_INFO_WITH_RSSI_AND_PSCAN_MODE_SIZE) {
+				for(i = 0; i < num; i++) {
+					info_mode = (const inquiry_info_with_rssi_and_pscan_mode *)(ptr + i * INQUIRY_INFO_WITH_RSSI_AND_PSCAN_MODE_SIZE);
+					InquiryAdd(sess, &info_mode->bdaddr, info_mode->pscan_rep_mode, info_mode->dev_class, info_mode->clock_offset, info_mode->rssi, NULL, 0);
+				}
+			} else if(plen >= 1 + num * INQUIRY_INFO_WITH_RSSI_SIZE) {
+				for(i = 0; i < num; i++) {
+					info_rssi = (const inquiry_info_with_rssi *)(ptr + i * INQUIRY_INFO_WITH_RSSI_SIZE);
+					InquiryAdd(sess, &info_rssi->bdaddr, info_rssi->pscan_rep_mode, info_rssi->dev_class, info_rssi->clock_offset, info_rssi->rssi, NULL, 0);
+				}
+			}
+			break;
+		case EVT_EXTENDED_INQUIRY_RESULT:
+			if(plen < 1 + num * EXTENDED_INQUIRY_INFO_SIZE)
+				return;
+			for(i = 0; i < num; i++) {
+				info_ext = (const extended_inquiry_info *)(ptr + i * EXTENDED_INQUIRY_INFO_SIZE);
+				InquiryAdd(sess, &info_ext->bdaddr, info_ext->pscan_rep_mode, info_ext->dev_class, info_ext->clock_offset, info_ext->rssi,
+					info_ext->data, sizeof(info_ext->data));
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static inq_dev *FindPending(inq_session *sess, const bdaddr_t *bdaddr) {
+	int i;
+
+	for(i = 0; i < sess->ndevs; i++) {
+		if(sess->devs[i].name_state == INQ_NAME_PENDING && !bacmp(&sess->devs[i].bdaddr, bdaddr))
+			return &sess->devs[i];
+	}
+	return NULL;
+}
+
+/***********************************************************************
+* Description:
+* Handle an event of the adaptor. A refused name request goes back to the
+* queue with one request less allowed at a time, unless it was the only
+* one outstanding. A refused inquiry ends the inquiry, and a background
+* inquiry ends with its names when another Inquiry Cancel completes.
+*
+* Calling Arguments:
+* Name			Description
+* sess		the inquiry
+* buf		the event, starting with the packet type
+* len		bytes of buf
+*
+* Return Value:
+* none
+******************************************************************************/
+static void HandleEvent(inq_session *sess, const unsigned char *buf, const int len) {
+	const hci_event_hdr *hdr = (const hci_event_hdr *)(buf + 1);
+	const unsigned char *ptr = buf + 1 + HCI_EVENT_HDR_SIZE;
+	const evt_cmd_status *cs;
+	const evt_cmd_complete *cc;
+	const evt_remote_name_req_complete *rn;
+	inq_dev *dev;
+
+	if(len < 1 + HCI_EVENT_HDR_SIZE || buf[0] != HCI_EVENT_PKT || len < 1 + HCI_EVENT_HDR_SIZE + hdr->plen)
+		return;
+
+	switch(hdr->evt) {
+		case EVT_INQUIRY_RESULT:
+		case EVT_INQUIRY_RESULT_WITH_RSSI:
+		case EVT_EXTENDED_INQUIRY_RESULT:
+			InquiryResult(sess, hdr->evt, ptr, hdr->plen);
+			break;
+		case EVT_INQUIRY_COMPLETE:
+			sess->inquiring = 0;
+			break;
+		case EVT_CMD_COMPLETE:
+			cc = (const evt_cmd_complete *)ptr;
+			if(len < 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_COMPLETE_SIZE ||
+				btohs(cc->opcode) != cmd_opcode_pack(OGF_LINK_CTL, OCF_INQUIRY_CANCEL))
+				break;
+			if(sess->cancel_sent)
+				sess->cancel_sent--;
+			else if(sess->flags & INQ_RUN_BACKGROUND)
+				SessionYield(sess);
+			break;
+		case EVT_CMD_STATUS:
+			cs = (const evt_cmd_status *)ptr;
+			if(len < 1 + HCI_EVENT_HDR_SIZE + EVT_CMD_STATUS_SIZE)
+				break;
+			if(btohs(cs->opcode) == cmd_opcode_pack(OGF_LINK_CTL, OCF_INQUIRY)) {
+				if(cs->status && sess->inquiring) {
+					if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the inquiry is refused, status 0x%2.2x\n", __FUNCTION__, cs->status);
+					sess->inquiring = 0;
+				}
+				break;
+			}
+			// none of ours is waiting, it's for a request of bluetoothd or another process
+			if(btohs(cs->opcode) != cmd_opcode_pack(OGF_LINK_CTL, OCF_REMOTE_NAME_REQ) || !sess->nstatus)
+				break;
+			dev = &sess->devs[sess->status_wait[0]];
+			memmove(sess->status_wait, sess->status_wait + 1, --sess->nstatus * sizeof(int));
+			if(!cs->status || dev->name_state != INQ_NAME_PENDING)
+				break;
+			if(cs->status == INQ_STATUS_DISALLOWED && sess->outstanding > 1) {
+				sess->outstanding--;
+				sess->limit = sess->outstanding;
+				dev->name_state = INQ_NAME_NONE;
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: the controller takes %d name requests at a time\n", __FUNCTION__, sess->limit);
+			} else
+				NameFinish(sess, dev, INQ_NAME_FAILED);
+			break;
+		case EVT_REMOTE_NAME_REQ_COMPLETE:
+			rn = (const evt_remote_name_req_complete *)ptr;
+			if(len < 1 + HCI_EVENT_HDR_SIZE + 1 + (int)sizeof(bdaddr_t) || (dev = FindPending(sess, &rn->bdaddr)) == NULL)
+				break;
+			if(!rn->status) {
+				memset(dev->name, 0, sizeof(dev->name));
+				memcpy(dev->name, rn->name, sizeof(dev->name) - 1);	// both HCI_MAX_NAME_LENGTH
+				NamesPut(&dev->bdaddr, dev->name);
+				NameFinish(sess, dev, INQ_NAME_DONE);
+			} else
+				NameFinish(sess, dev, INQ_NAME_FAILED);
+			break;
+		default:
+			break;
+	}
+}
+
+// fail the name requests beyond their deadline, returns ms to the next deadline
+static int CheckDeadlines(inq_session *sess) {
+	unsigned long long now = StatsNow(), next = 0;
+	remote_name_req_cancel_cp cp;
+	inq_dev *dev;
+	int i;
+
+	for(i = 0; i < sess->ndevs; i++) {
+		dev = &sess->devs[i];
+		if(dev->name_state != INQ_NAME_PENDING)
+			continue;
+		if(dev->deadline <= now) {
+			bacpy(&cp.bdaddr, &dev->bdaddr);
+			hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_REMOTE_NAME_REQ_CANCEL, REMOTE_NAME_REQ_CANCEL_CP_SIZE, &cp);
+			NameFinish(sess, dev, INQ_NAME_FAILED);
+		} else if(!next || dev->deadline < next)
+			next = dev->deadline;
+	}
+	return next ? (int)((next - now + 999) / 1000) : -1;
+}
+
+/***********************************************************************
+* Description:
+* Parse the filters of AT+BTIN=, separated by ',':
+* COD=<hex value>[/<hex mask>]	class of device, the mask defaults to the
+*								major and minor class
+* RSSI=<dBm>					the minimum RSSI
+* UUID=<hex>					a 16-bit service class of the EIR
+* NAME=<prefix>					the start of the name, case insensitive
+* ADDR=<addr>					a device looked for, with or without ':',
+*								the inquiry ends as soon as one is seen
+* PING							the ADDR= devices are paged, no inquiry
+* LIVE							a live scan rather than the discovery table
+*
+* Calling Arguments:
+* Name			Description
+* arg		the argument of AT+BTIN=, "" for no filter
+* filter	the filters parsed
+*
+* Return Value:
+* 0: success
+* -1: a filter is invalid
+******************************************************************************/
+int InqFilterParse(const char *arg, inq_filter *filter) {
+	char buff[BT_NAME_LENGTH + 16] = {};
+	char addr[BT_ADDR_LENGTH] = {};
+	char *ptoken, *psave = NULL, *pvalue, *pend;
+	unsigned long value;
+	long rssi;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->min_rssi = INQ_RSSI_ANY;
+	snprintf(buff, sizeof(buff), "%s", arg);
+	buff[strcspn(buff, "\r\n")] = '\0';
+
+	for(ptoken = strtok_r(buff, ",", &psave); ptoken; ptoken = strtok_r(NULL, ",", &psave)) {
+		pvalue = strchr(ptoken, '=');
+		if(!strcasecmp(ptoken, "LIVE")) {
+			filter->live = 1;
+		} else if(!strcasecmp(ptoken, "PING")) {
+			filter->ping = 1;
+		} else if(!strncasecmp(ptoken, "ADDR=", strlen("ADDR="))) {
+			if(filter->ntargets >= INQ_TARGETS || strlen(pvalue + 1) >= sizeof(addr))
+				return -1;
+			snprintf(addr, sizeof(addr), "%s", pvalue + 1);
+			if(!strchr(addr, ':'))
+				AddrStringAddColumn(addr);
+			if(strlen(addr) != BT_ADDR_LENGTH - 1 || str2ba(addr, &filter->target[filter->ntargets]) < 0)
+				return -1;
+			filter->ntargets++;
+		} else if(!strncasecmp(ptoken, "COD=", strlen("COD="))) {
+			value = strtoul(pvalue + 1, &pend, 16);
+			if(pend == pvalue + 1 || value > 0xFFFFFF)
+				return -1;
+			filter->cod_value = value;
+			filter->cod_mask = INQ_COD_MASK_DEFAULT;
+			if(*pend == '/') {
+				pvalue = pend;
+				value = strtoul(pvalue + 1, &pend, 16);
+				if(pend == pvalue + 1 || value > 0xFFFFFF)
+					return -1;
+				filter->cod_mask = value;
+			}
+			if(*pend != '\0')
+				return -1;
+			filter->cod_value &= filter->cod_mask;
+		} else if(!strncasecmp(ptoken, "RSSI=", strlen("RSSI="))) {
+			rssi = strtol(pvalue + 1, &pend, 10);
+			if(pend == pvalue + 1 || *pend != '\0' || rssi < INQ_RSSI_ANY || rssi > 127)
+				return -1;
+			filter->min_rssi = rssi;
+		} else if(!strncasecmp(ptoken, "UUID=", strlen("UUID="))) {
+			value = strtoul(pvalue + 1, &pend, 16);
+			if(pend == pvalue + 1 || *pend != '\0' || !value || value > 0xFFFF)
+				return -1;
+			filter->uuid16 = value;
+		} else if(!strncasecmp(ptoken, "NAME=", strlen("NAME="))) {
+			snprintf(filter->name_prefix, sizeof(filter->name_prefix), "%s", pvalue + 1);
+		} else
+			return -1;
+	}
+	if(filter->ping && !filter->ntargets)
+		return -1;
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Check a device against the filters of AT+BTIN=.
+*
+* Calling Arguments:
+* Name			Description
+* filter	the filters
+* dev		the device
+* with_name	0: the name isn't read yet, NAME= is not checked
+*
+* Return Value:
+* 1: the device matches
+* 0: it doesn't
+******************************************************************************/
+int InqFilterMatch(const inq_filter *filter, const inq_dev *dev, const int with_name) {
+	uint32_t cod = dev->dev_class[0] | (dev->dev_class[1] << 8) | (dev->dev_class[2] << 16);
+	int i;
+
+	if(filter->ntargets) {
+		for(i = 0; i < filter->ntargets && bacmp(&filter->target[i], &dev->bdaddr); i++)
+			;
+		if(i == filter->ntargets)
+			return 0;
+	}
+
+	if((cod & filter->cod_mask) != filter->cod_value)
+		return 0;
+	if(dev->rssi < filter->min_rssi)
+		return 0;
+	if(filter->uuid16) {
+		for(i = 0; i < dev->nuuid && dev->uuid16[i] != filter->uuid16; i++)
+			;
+		if(i == dev->nuuid)
+			return 0;
+	}
+	if(with_name && strlen(filter->name_prefix) &&
+		(dev->name_state != INQ_NAME_DONE || strncasecmp(dev->name, filter->name_prefix, strlen(filter->name_prefix))))
+		return 0;
+	return 1;
+}
+
+// the adaptor with the events of an inquiry, the old filter is kept in of
+static int SessionOpen(inq_session *sess, const int dev_id, struct hci_filter *of) {
+	struct hci_filter nf;
+	socklen_t olen = sizeof(*of);
+
+	if((sess->dd = hci_open_dev(dev_id)) < 0) {
+		perror("HCI device open failed");
+		return -1;
+	}
+	sess->limit = INQ_NAME_PARALLEL;
+
+	getsockopt(sess->dd, SOL_HCI, HCI_FILTER, of, &olen);
+	hci_filter_clear(&nf);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &nf);
+	hci_filter_set_event(EVT_CMD_STATUS, &nf);
+	hci_filter_set_event(EVT_CMD_COMPLETE, &nf);
+	hci_filter_set_event(EVT_REMOTE_NAME_REQ_COMPLETE, &nf);
+	hci_filter_set_event(EVT_INQUIRY_RESULT, &nf);
+	hci_filter_set_event(EVT_INQUIRY_RESULT_WITH_RSSI, &nf);
+	hci_filter_set_event(EVT_EXTENDED_INQUIRY_RESULT, &nf);
+	hci_filter_set_event(EVT_INQUIRY_COMPLETE, &nf);
+	if(setsockopt(sess->dd, SOL_HCI, HCI_FILTER, &nf, sizeof(nf)) < 0) {
+		perror("HCI filter setup failed");
+		hci_close_dev(sess->dd);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Run the events of the adaptor until the inquiry is complete and every
+* device is given to cb. The devices left when the adaptor goes away get
+* no name.
+*
+* Calling Arguments:
+* Name			Description
+* sess		the inquiry, opened by SessionOpen()
+* of		the filter to restore
+*
+* Return Value:
+* none
+******************************************************************************/
+static void SessionRun(inq_session *sess, struct hci_filter *of) {
+	unsigned char buf[INQ_EVENT_SIZE];
+	struct pollfd pfd;
+	unsigned long long now;
+	int len, timeout, inq_timeout;
+
+	pfd.fd = sess->dd;
+	pfd.events = POLLIN;
+	while(sess->inquiring || sess->done < sess->ndevs) {
+		NameRequestMore(sess);
+		timeout = CheckDeadlines(sess);
+		if(sess->inquiring) {
+			now = StatsNow();
+			if(sess->inq_deadline <= now) {
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s no Inquiry Complete\n", __FUNCTION__);
+				InquiryStop(sess);
+				continue;
+			}
+			inq_timeout = (int)((sess->inq_deadline - now + 999) / 1000);
+			if(timeout < 0 || inq_timeout < timeout)
+				timeout = inq_timeout;
+		} else if(timeout < 0 && sess->done >= sess->ndevs)
+			break;
+		if(poll(&pfd, 1, timeout) < 0) {
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		if(pfd.revents & POLLIN) {
+			if((len = read(sess->dd, buf, sizeof(buf))) > 0)
+				HandleEvent(sess, buf, len);
+		} else if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+			break;
+	}
+
+	InquiryStop(sess);
+	for(len = 0; len < sess->ndevs; len++) {
+		if(sess->devs[len].name_state == INQ_NAME_NONE || sess->devs[len].name_state == INQ_NAME_PENDING)
+			NameFinish(sess, &sess->devs[len], INQ_NAME_FAILED);
+	}
+
+	setsockopt(sess->dd, SOL_HCI, HCI_FILTER, of, sizeof(*of));
+	hci_close_dev(sess->dd);
+}
+
+/***********************************************************************
+* Description:
+* Set the inquiry of InqRun().
+*
+* Calling Arguments:
+* Name			Description
+* results	devices of an inquiry at most, 1 to INQ_RESULTS_MAX
+* length	the inquiry length in units of 1.28 s, 1 to INQ_LENGTH_MAX
+*
+* Return Value:
+* 0: success
+* -1: a value is out of range, the default is used for it
+******************************************************************************/
+int InqSetParams(const int results, const int length) {
+	int ret = 0;
+
+	if(results < 1 || results > INQ_RESULTS_MAX) {
+		inq_results = DEFAULT_INQUIRY_RESULTS;
+		ret = -1;
+	} else
+		inq_results = results;
+
+	if(length < 1 || length > INQ_LENGTH_MAX) {
+		inq_length = DEFAULT_INQUIRY_LENGTH;
+		ret = -1;
+	} else
+		inq_length = length;
+
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Inquire the general discoverable devices in the extended inquiry mode.
+* A name request is sent for every device without a name in its EIR, nor
+* in the cache, as soon as its Inquiry Result arrives, up to
+* INQ_NAME_PARALLEL at once, and cb is called for the device as soon as
+* its name arrives, fails, or passes its deadline of INQ_NAME_TIMEOUT_MS.
+* The inquiry is cancelled when the devices set by InqSetParams() are
+* found. Inquiries of the daemon run one at a time.
+*
+* Calling Arguments:
+* Name			Description
+* dev_id	the adaptor
+* length	the inquiry length in units of 1.28 s, 0 for the one of InqSetParams()
+* flags		INQ_RUN_BACKGROUND: give up when InqCancel() is called
+* filter	the devices given to cb, NULL for every device
+* cb		called once for every device matching the filter
+* arg		given to cb
+*
+* Return Value:
+* >=0: the devices found
+* -1: the adaptor can't be opened or refuses the inquiry
+******************************************************************************/
+int InqRun(const int dev_id, const int length, const int flags, const inq_filter *filter, inq_result_cb cb, void *arg) {
+	struct hci_filter of;
+	write_inquiry_mode_cp mode_cp;
+	inquiry_cp cp;
+	inq_session sess;
+	int ret = -1;
+
+	memset(&sess, 0, sizeof(sess));
+	sess.max = inq_results;
+	if((sess.devs = malloc(sess.max * sizeof(inq_dev))) == NULL) {
+		perror("malloc() failed");
+		return -1;
+	}
+	sess.flags = flags;
+	sess.filter = filter;
+	sess.cb = cb;
+	sess.arg = arg;
+	pthread_mutex_lock(&inq_lock);
+	if(SessionOpen(&sess, dev_id, &of) < 0)
+		goto end;
+
+	// RSSI and EIR results, a controller without them refuses and keeps the standard ones
+	mode_cp.mode = INQ_MODE_EXTENDED;
+	hci_send_cmd(sess.dd, OGF_HOST_CTL, OCF_WRITE_INQUIRY_MODE, WRITE_INQUIRY_MODE_CP_SIZE, &mode_cp);
+
+	memset(&cp, 0, sizeof(cp));
+	cp.lap[0] = 0x33;	// GIAC 0x9e8b33
+	cp.lap[1] = 0x8b;
+	cp.lap[2] = 0x9e;
+	cp.length = (length > 0 && length <= INQ_LENGTH_MAX) ? length : inq_length;
+	cp.num_rsp = 0;		// unlimited, a device may answer more than once
+	if(hci_send_cmd(sess.dd, OGF_LINK_CTL, OCF_INQUIRY, INQUIRY_CP_SIZE, &cp) < 0) {
+		perror("Inquiry failed.");
+		setsockopt(sess.dd, SOL_HCI, HCI_FILTER, &of, sizeof(of));
+		hci_close_dev(sess.dd);
+		goto end;
+	}
+	sess.inquiring = 1;
+	sess.inq_deadline = StatsNow() + (cp.length * INQ_LENGTH_UNIT_MS + INQ_COMPLETE_SLACK_MS) * 1000ULL;
+
+	SessionRun(&sess, &of);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %d BT devs found\n", __FUNCTION__, sess.ndevs);
+	ret = sess.ndevs;
+
+end:
+	pthread_mutex_unlock(&inq_lock);
+	free(sess.devs);
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Cancel the inquiry of the adaptor. An InqRun() or an InqResolveNames()
+* with INQ_RUN_BACKGROUND returns without reading the names left.
+*
+* Calling Arguments:
+* Name			Description
+* dev_id	the adaptor
+*
+* Return Value:
+* 0: success
+* -1: the adaptor can't be opened
+******************************************************************************/
+int InqCancel(const int dev_id) {
+	int dd;
+
+	if((dd = hci_open_dev(dev_id)) < 0)
+		return -1;
+	hci_send_cmd(dd, OGF_LINK_CTL, OCF_INQUIRY_CANCEL, 0, NULL);
+	hci_close_dev(dd);
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Read the names of devices found before. Up to INQ_NAME_PARALLEL
+* requests are outstanding at once, and cb is called for each device as
+* soon as its name arrives, fails, or passes its deadline of
+* INQ_NAME_TIMEOUT_MS. It waits for the inquiry or the names of another
+* thread to end first.
+*
+* Calling Arguments:
+* Name			Description
+* dev_id	the adaptor
+* devs		the devices, name_state INQ_NAME_NONE
+* ndevs		number of devices
+* flags		INQ_RUN_BACKGROUND: give up the names left when InqCancel() is called
+* cb		called once for every device
+* arg		given to cb
+*
+* Return Value:
+* 0: success
+* -1: the adaptor can't be opened, cb is not called
+******************************************************************************/
+int InqResolveNames(const int dev_id, inq_dev *devs, const int ndevs, const int flags, inq_result_cb cb, void *arg) {
+	struct hci_filter of;
+	inq_session sess;
+
+	memset(&sess, 0, sizeof(sess));
+	sess.devs = devs;
+	sess.ndevs = ndevs;
+	sess.max = ndevs;
+	sess.flags = flags;
+	sess.cb = cb;
+	sess.arg = arg;
+	pthread_mutex_lock(&inq_lock);
+	if(SessionOpen(&sess, dev_id, &of) < 0) {
+		pthread_mutex_unlock(&inq_lock);
+		return -1;
+	}
+
+	SessionRun(&sess, &of);
+	pthread_mutex_unlock(&inq_lock);
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Take the adaptor for a name request sent outside of this file, as the
+* one of the pairing, so its Command Status isn't taken by a session
+* here. Without waiting: a pairing can't stop answering its events.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* 0: taken, InqUnlock() gives it back
+* -1: an inquiry or a name request session is running
+******************************************************************************/
+int InqTryLock(void) {
+	return pthread_mutex_trylock(&inq_lock) ? -1 : 0;
+}
+
+void InqUnlock(void) {
+	pthread_mutex_unlock(&inq_lock);
+}
+
+// a ping gives the devices which answered only
+typedef struct inq_ping {
+	inq_result_cb cb;
+	void *arg;
+	int answered;
+} inq_ping;
+
+static void PingResult(const inq_dev *dev, void *arg) {
+	inq_ping *ping = (inq_ping *)arg;
+
+	if(dev->name_state != INQ_NAME_DONE)
+		return;
+	ping->answered++;
+	ping->cb(dev, ping->arg);
+}
+
+/***********************************************************************
+* Description:
+* Look for the ADDR= devices of a filter by paging them, without an
+* inquiry. A remote name request pages the device and is dropped once the
+* name is read, so a device in range answers within a page timeout, with
+* its name. The class and the RSSI are not known.
+*
+* Calling Arguments:
+* Name			Description
+* dev_id	the adaptor
+* filter	the devices looked for
+* cb		called for every device which answered
+* arg		given to cb
+*
+* Return Value:
+* >=0: the devices which answered
+* -1: the adaptor can't be opened
+******************************************************************************/
+int InqPing(const int dev_id, const inq_filter *filter, inq_result_cb cb, void *arg) {
+	inq_dev devs[INQ_TARGETS];
+	inq_ping ping;
+	int i;
+
+	memset(devs, 0, sizeof(devs));
+	for(i = 0; i < filter->ntargets; i++) {
+		bacpy(&devs[i].bdaddr, &filter->target[i]);
+		devs[i].pscan_rep_mode = INQ_PSCAN_REP_MODE_R2;
+	}
+	ping.cb = cb;
+	ping.arg = arg;
+	ping.answered = 0;
+	if(InqResolveNames(dev_id, devs, filter->ntargets, 0, PingResult, &ping) < 0)
+		return -1;
+	return ping.answered;
+}
@@ -0,0 +1,84 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_inquiry.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_INQUIRY_H
+#define __OSITECH_INQUIRY_H
+
+#include <stdint.h>
+#include <bluetooth/bluetooth.h>
+
+#include "ositech_bt.h"
+
+#define INQ_NAME_PARALLEL	3		// remote name requests at the same time, fewer if the controller refuses
+#define INQ_NAME_TIMEOUT_MS	6000	// a little beyond the default page timeout of 5.12 s
+#define INQ_RESULTS_MAX		64		// inquiry.results
+#define INQ_LENGTH_MAX		0x30	// inquiry.length, 61.44 s
+#define INQ_EIR_UUIDS		8		// 16-bit service classes kept of the Extended Inquiry Response
+#define INQ_TARGETS			8		// ADDR= of AT+BTIN=
+#define INQ_PSCAN_REP_MODE_R2	0x02	// for a name request without an Inquiry Result
+
+// the class of device field of COD= without a mask, major and minor class
+#define INQ_COD_MASK_DEFAULT	0x001FFC
+#define INQ_RSSI_ANY		(-128)
+
+// AT+BTIN=<filter>,<filter>... the devices reported, every filter given must match
+typedef struct inq_filter {
+	uint32_t cod_value;		// COD=<hex value>[/<hex mask>]
+	uint32_t cod_mask;		// 0: any class
+	int min_rssi;			// RSSI=<dBm>, INQ_RSSI_ANY: any
+	uint16_t uuid16;		// UUID=<hex>, a service class of the EIR, 0: any
+	char name_prefix[BT_NAME_LENGTH];	// NAME=<prefix>, case insensitive, "": any
+	bdaddr_t target[INQ_TARGETS];	// ADDR=<addr>, the inquiry ends when one is seen
+	int ntargets;			// 0: any address
+	int ping;				// PING: the targets are paged instead of inquired
+	int live;				// LIVE: a live scan rather than the discovery table
+} inq_filter;
+
+// flags of InqRun() and InqResolveNames()
+#define INQ_RUN_BACKGROUND	0x01	// the inquiry or the names give way to InqCancel()
+
+// name_state of a device
+#define INQ_NAME_NONE		0
+#define INQ_NAME_PENDING	1
+#define INQ_NAME_DONE		2
+#define INQ_NAME_FAILED		3
+
+typedef struct inq_dev {
+	bdaddr_t bdaddr;
+	uint8_t dev_class[3];
+	uint8_t pscan_rep_mode;
+	uint16_t clock_offset;
+	int8_t rssi;					// dBm, 0 for a result without RSSI
+	uint16_t uuid16[INQ_EIR_UUIDS];	// service classes of the EIR, 0x1106 for OBEX FTP
+	int nuuid;
+	char name[BT_NAME_LENGTH];
+	int name_state;
+	unsigned long long deadline;	// StatsNow() of the name request timeout
+} inq_dev;
+
+// a device is done, with its name or INQ_NAME_FAILED
+typedef void (*inq_result_cb)(const inq_dev *dev, void *arg);
+
+extern int InqSetParams(const int results, const int length);
+extern int InqFilterParse(const char *arg, inq_filter *filter);
+extern int InqFilterMatch(const inq_filter *filter, const inq_dev *dev, const int with_name);
+extern int InqRun(const int dev_id, const int length, const int flags, const inq_filter *filter, inq_result_cb cb, void *arg);
+extern int InqCancel(const int dev_id);
+extern int InqPing(const int dev_id, const inq_filter *filter, inq_result_cb cb, void *arg);
+extern int InqResolveNames(const int dev_id, inq_dev *devs, const int ndevs, const int flags, inq_result_cb cb, void *arg);
+extern int InqTryLock(void);
+extern void InqUnlock(void);
+
+#endif
@@ -0,0 +1,708 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		journal of the Bluetooth state kept on the flash. The
+*				friendly name and the paired devices are changed by
+*				appending one record, the records are synced in batches
+*				and folded into friendlyname and paireddevice now and
+*				then, by a thread of the journal woken by the timer.
+*				titan_obex and wl_bluetooth_tool share the journal, it's
+*				flock()ed and its size taken again for every access.
+* File Name:			ositech_journal.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "config.h"
+#include "hci_info.h"
+#include "ositech_bt.h"
+#include "ositech_budget.h"
+#include "ositech_timer.h"
+#include "ositech_journal.h"
+
+#define JOURNAL_PATH_LENG	64		// the paths of hci_info.c
+#define JOURNAL_ADDR_LENG	17		// xx:xx:xx:xx:xx:xx
+#define JOURNAL_LINE_LENG	(BT_ADDR_LENGTH + BT_NAME_LENGTH + 4)
+
+/*
+ records, one per line. A line without its '\n' is the end of a write cut
+ by a power loss and is ignored.
+*/
+#define JOURNAL_NAME		'N'		// N <friendly name>
+#define JOURNAL_NAME_DEL	'n'		// n
+#define JOURNAL_PAIRED		'P'		// P <addr>,<name>
+#define JOURNAL_UNPAIRED	'R'		// R <addr>
+#define JOURNAL_UNPAIRED_ALL	'X'	// X
+
+typedef void (*journal_rec_cb)(const char op, const char *payload, const size_t leng, void *arg);
+
+typedef struct journal_name {
+	int set;
+	char name[BT_NAME_LENGTH];
+} journal_name;
+
+// last record of a device since the last X, for the compaction
+typedef struct journal_effect {
+	char addr[BT_ADDR_LENGTH];
+	const char *name;	// in the mapped journal, NULL if removed
+	size_t name_leng;
+	unsigned int seq;
+} journal_effect;
+
+typedef struct journal_effects {
+	journal_effect *effect;
+	unsigned int num;
+	unsigned int cap;
+	unsigned int seq;
+	int all_removed;
+} journal_effects;
+
+static struct journal_state {
+	pthread_mutex_t lock;
+	char path[JOURNAL_PATH_LENG];	// the journal of the adaptor in use
+	int fd;
+	off_t size;			// as of the last access, the other process may have changed it
+	int unsynced;		// records not on the flash yet
+	bt_timer_t timer;
+	int timer_init;
+	int exit_hook;
+	int worker;			// the flush thread is running, else the records are synced as written
+	// the timer only wakes the flush thread, the sync may take long on the flash
+	pthread_mutex_t due_lock;
+	pthread_cond_t due_cond;
+	int due;
+} journal = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.fd = -1,
+	.due_lock = PTHREAD_MUTEX_INITIALIZER,
+	.due_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void JournalSyncTimeout(void *arg);
+
+// the path of one of the files of the adaptor
+static void AdaptorPath(char *fullpath, const char *filename) {
+	GetBTFilePath(fullpath, filename);
+}
+
+// addresses are compared as written by AddrStringAddColumn(), upper case
+static void AddrUpper(char *dst, const char *src) {
+	int i;
+
+	for(i = 0; i < JOURNAL_ADDR_LENG && src[i]; i++)
+		dst[i] = toupper((unsigned char)src[i]);
+	dst[i] = '\0';
+}
+
+static int WriteAll(const int fd, const char *buf, size_t leng) {
+	ssize_t wr_sz;
+
+	while(leng) {
+		if((wr_sz = write(fd, buf, leng)) < 0) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += wr_sz;
+		leng -= wr_sz;
+	}
+	return 0;
+}
+
+// walk the records of a map of the journal, the payloads point into the map and are not terminated
+static void JournalWalkMap(const char *map, const size_t size, journal_rec_cb cb, void *arg) {
+	const char *line, *eol, *end = map + size;
+
+	for(line = map; line < end && (eol = (const char *)memchr(line, '\n', end - line)); line = eol + 1) {
+		if(eol - line >= 2 && line[1] == ' ')
+			cb(line[0], line + 2, eol - line - 2, arg);
+		else if(eol - line == 1)
+			cb(line[0], "", 0, arg);
+	}
+}
+
+/***********************************************************************
+* Description:
+* Lock the journal against the other process and take its size of now.
+* The other process may have appended records, or emptied the journal by
+* a compaction, since the last access.
+*
+* Calling Arguments:
+* Name			Description
+* operation	LOCK_SH to read the journal, LOCK_EX to change it
+*
+* Return Value:
+* 0: success
+* -1: fail, the journal isn't locked
+******************************************************************************/
+static int JournalLock(const int operation) {
+	struct stat st;
+
+	while(flock(journal.fd, operation) < 0) {
+		if(errno != EINTR) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - flock() %s failed %s\n", __FUNCTION__, journal.path, strerror(errno));
+			return -1;
+		}
+	}
+	if(fstat(journal.fd, &st) < 0) {
+		flock(journal.fd, LOCK_UN);
+		return -1;
+	}
+	journal.size = st.st_size;
+	return 0;
+}
+
+static void JournalUnlock(void) {
+	flock(journal.fd, LOCK_UN);
+}
+
+/***********************************************************************
+* Description:
+* Walk the records of the journal, called with the journal locked. The
+* journal is mapped for the walk, a payload given to cb is only valid
+* during the call.
+*
+* Calling Arguments:
+* Name			Description
+* cb		called for every complete record
+* arg		given to cb
+*
+* Return Value:
+* 0: success
+* -1: the journal can't be read
+******************************************************************************/
+static int JournalWalk(journal_rec_cb cb, void *arg) {
+	const char *map;
+
+	if(journal.fd < 0)
+		return -1;
+	if(!journal.size)
+		return 0;
+	if((map = (const char *)mmap(NULL, journal.size, PROT_READ, MAP_SHARED, journal.fd, 0)) == MAP_FAILED)
+		return -1;
+	JournalWalkMap(map, journal.size, cb, arg);
+	munmap((void *)map, journal.size);
+	return 0;
+}
+
+static void NameRecord(const char op, const char *payload, const size_t leng, void *arg) {
+	journal_name *name = (journal_name *)arg;
+
+	if(op == JOURNAL_NAME) {
+		snprintf(name->name, sizeof(name->name), "%.*s", (int)leng, payload);
+		name->set = 1;
+	} else if(op == JOURNAL_NAME_DEL) {
+		name->set = 0;
+		memset(name->name, 0, sizeof(name->name));
+	}
+}
+
+// the friendly name kept in friendlyname, the records are applied over it
+static void ReadFriendlyName(journal_name *name) {
+	char fullpath[JOURNAL_PATH_LENG] = {};
+	FILE *file_stream;
+
+	memset(name, 0, sizeof(journal_name));
+	AdaptorPath(fullpath, "friendlyname");
+	if((file_stream = fopen(fullpath, "r")) != NULL) {
+		if(fgets(name->name, sizeof(name->name), file_stream))
+			name->set = 1;
+		fclose(file_stream);
+	}
+}
+
+static void JournalAtExit(void) {
+	JournalFlush();
+}
+
+// the syncs and the compactions, off the timer thread
+static void *JournalThread(void *arg) {
+	while(1) {
+		pthread_mutex_lock(&journal.due_lock);
+		while(!journal.due)
+			pthread_cond_wait(&journal.due_cond, &journal.due_lock);
+		journal.due = 0;
+		pthread_mutex_unlock(&journal.due_lock);
+
+		JournalFlush();
+	}
+	return NULL;
+}
+
+static int JournalThreadStart(void) {
+	pthread_t thread;
+	pthread_attr_t attr;
+	int ret = 0;
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, JournalThread, NULL) != 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s pthread_create() failed, the records are synced as written\n", __FUNCTION__);
+		ret = -1;
+	}
+	pthread_attr_destroy(&attr);
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Open the journal of the adaptor in use, called with the lock held.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* 0: success
+* -1: the journal can't be opened
+******************************************************************************/
+static int JournalOpen(void) {
+	char path[JOURNAL_PATH_LENG] = {};
+	struct stat st;
+
+	AdaptorPath(path, "journal");
+	if(journal.fd >= 0 && !strcmp(path, journal.path))
+		return 0;
+
+	// another adaptor, the records of the previous one are synced first
+	if(journal.fd >= 0) {
+		if(journal.unsynced)
+			fdatasync(journal.fd);
+		close(journal.fd);
+		journal.fd = -1;
+	}
+	journal.unsynced = 0;
+
+	if((journal.fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644)) < 0 || fstat(journal.fd, &st) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - open() %s failed %s\n", __FUNCTION__, path, strerror(errno));
+		if(journal.fd >= 0)
+			close(journal.fd);
+		journal.fd = -1;
+		return -1;
+	}
+	snprintf(journal.path, sizeof(journal.path), "%s", path);
+	journal.size = st.st_size;
+
+	if(!journal.timer_init) {
+		TimerInit(&journal.timer, JournalSyncTimeout, NULL);
+		journal.worker = (JournalThreadStart() == 0);
+		journal.timer_init = 1;
+	}
+	if(!journal.exit_hook)
+		journal.exit_hook = !atexit(JournalAtExit);
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %u bytes\n", __FUNCTION__, path, (unsigned int)journal.size);
+	return 0;
+}
+
+// append one record, it is synced by the timer with the records which follow
+static int JournalAppend(const char op, const char *payload) {
+	char line[JOURNAL_LINE_LENG] = {};
+	int leng;
+
+	if(JournalOpen() < 0)
+		return -1;
+
+	// room is kept for the '\n', a '\n' in the payload would end the record early
+	snprintf(line, sizeof(line) - 1, payload ? "%c %s" : "%c", op, payload);
+	line[strcspn(line, "\n")] = '\0';
+	leng = strlen(line);
+	line[leng++] = '\n';
+
+	// not in the middle of a compaction by the other process
+	if(JournalLock(LOCK_EX) < 0)
+		return -1;
+	if(WriteAll(journal.fd, line, leng) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - write() %s failed %s\n", __FUNCTION__, journal.path, strerror(errno));
+		JournalUnlock();
+		return -1;
+	}
+	journal.size += leng;
+	JournalUnlock();
+	journal.unsynced++;
+	if(!journal.worker || (!TimerPending(&journal.timer) && TimerStart(&journal.timer, JOURNAL_SYNC_MS) < 0))
+		fdatasync(journal.fd);
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Set the friendly name kept for the adaptor, NULL or "" removes it.
+*
+* Calling Arguments:
+* Name			Description
+* name		the friendly name
+*
+* Return Value:
+* 0: success
+* -1: fail
+******************************************************************************/
+int JournalSetName(const char *name) {
+	int ret;
+
+	pthread_mutex_lock(&journal.lock);
+	if(name && strlen(name))
+		ret = JournalAppend(JOURNAL_NAME, name);
+	else
+		ret = JournalAppend(JOURNAL_NAME_DEL, NULL);
+	pthread_mutex_unlock(&journal.lock);
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Get the friendly name kept for the adaptor. It's read every time, the
+* other process may have changed it: friendlyname, then the records.
+*
+* Calling Arguments:
+* Name			Description
+* name		store the friendly name
+* name_leng	the size of name
+*
+* Return Value:
+* 1: set
+* 0: not set
+******************************************************************************/
+int JournalGetName(char *name, const int name_leng) {
+	journal_name current;
+	int set = 0;
+
+	pthread_mutex_lock(&journal.lock);
+	if(JournalOpen() == 0 && JournalLock(LOCK_SH) == 0) {
+		ReadFriendlyName(&current);
+		JournalWalk(NameRecord, &current);
+		JournalUnlock();
+		if(current.set) {
+			snprintf(name, name_leng, "%s", current.name);
+			set = 1;
+		}
+	}
+	pthread_mutex_unlock(&journal.lock);
+	return set;
+}
+
+/***********************************************************************
+* Description:
+* Keep the name of a paired device. The record replaces the line of the
+* device in paireddevice at the next compaction.
+*
+* Calling Arguments:
+* Name			Description
+* addr		xx:xx:xx:xx:xx:xx
+* name		name of the device
+*
+* Return Value:
+* 0: success
+* -1: fail
+******************************************************************************/
+int JournalSetPaired(const char *addr, const char *name) {
+	char payload[JOURNAL_LINE_LENG] = {};
+	char upper[BT_ADDR_LENGTH] = {};
+	int ret;
+
+	AddrUpper(upper, addr);
+	snprintf(payload, sizeof(payload), "%s,%s", upper, name);
+	pthread_mutex_lock(&journal.lock);
+	ret = JournalAppend(JOURNAL_PAIRED, payload);
+	pthread_mutex_unlock(&journal.lock);
+	return ret;
+}
+
+// remove a paired device, or all of them if addr is NULL
+int JournalRemovePaired(const char *addr) {
+	char upper[BT_ADDR_LENGTH] = {};
+	int ret;
+
+	pthread_mutex_lock(&journal.lock);
+	if(addr) {
+		AddrUpper(upper, addr);
+		ret = JournalAppend(JOURNAL_UNPAIRED, upper);
+	} else
+		ret = JournalAppend(JOURNAL_UNPAIRED_ALL, NULL);
+	pthread_mutex_unlock(&journal.lock);
+	return ret;
+}
+
+typedef struct replay_arg {
+	journal_paired_cb cb;
+	void *arg;
+} replay_arg;
+
+static void PairedRecord(const char op, const char *payload, const size_t leng, void *arg) {
+	replay_arg *replay = (replay_arg *)arg;
+	char addr[BT_ADDR_LENGTH] = {};
+	char name[BT_NAME_LENGTH] = {};
+
+	if(op == JOURNAL_UNPAIRED_ALL) {
+		replay->cb(NULL, NULL, replay->arg);
+		return;
+	}
+	if((op != JOURNAL_PAIRED && op != JOURNAL_UNPAIRED) || leng < JOURNAL_ADDR_LENG)
+		return;
+	memcpy(addr, payload, JOURNAL_ADDR_LENG);
+	if(op == JOURNAL_UNPAIRED) {
+		replay->cb(addr, NULL, replay->arg);
+	} else if(leng > JOURNAL_ADDR_LENG) {
+		snprintf(name, sizeof(name), "%.*s", (int)(leng - JOURNAL_ADDR_LENG - 1), payload + JOURNAL_ADDR_LENG + 1);
+		replay->cb(addr, name, replay->arg);
+	}
+}
+
+/***********************************************************************
+* Description:
+* Give the paired devices of the journal, in the order written, to the
+* reader of paireddevice. Applied over paireddevice they give the paired
+* devices of now.
+*
+* Calling Arguments:
+* Name			Description
+* cb		called for every record
+* arg		given to cb
+*
+* Return Value:
+* none
+******************************************************************************/
+void JournalReplayPaired(journal_paired_cb cb, void *arg) {
+	replay_arg replay = { cb, arg };
+
+	pthread_mutex_lock(&journal.lock);
+	if(JournalOpen() == 0 && JournalLock(LOCK_SH) == 0) {
+		JournalWalk(PairedRecord, &replay);
+		JournalUnlock();
+	}
+	pthread_mutex_unlock(&journal.lock);
+}
+
+static void EffectRecord(const char op, const char *payload, const size_t leng, void *arg) {
+	journal_effects *effects = (journal_effects *)arg;
+	journal_effect *effect;
+
+	if(op == JOURNAL_UNPAIRED_ALL) {
+		effects->num = 0;
+		effects->all_removed = 1;
+		return;
+	}
+	if((op != JOURNAL_PAIRED && op != JOURNAL_UNPAIRED) || leng < JOURNAL_ADDR_LENG)
+		return;
+	if(effects->num == effects->cap) {
+		effects->cap = effects->cap ? effects->cap * 2 : 64;
+		if((effect = (journal_effect *)realloc(effects->effect, effects->cap * sizeof(journal_effect))) == NULL) {
+			effects->cap = effects->num;
+			return;
+		}
+		effects->effect = effect;
+	}
+	effect = &effects->effect[effects->num++];
+	AddrUpper(effect->addr, payload);
+	effect->name = NULL;
+	effect->name_leng = 0;
+	if(op == JOURNAL_PAIRED && leng > JOURNAL_ADDR_LENG) {
+		effect->name = payload + JOURNAL_ADDR_LENG + 1;
+		effect->name_leng = leng - JOURNAL_ADDR_LENG - 1;
+	}
+	effect->seq = effects->seq++;
+}
+
+static int EffectCompare(const void *a, const void *b) {
+	const journal_effect *ea = (const journal_effect *)a;
+	const journal_effect *eb = (const journal_effect *)b;
+	int cmp = strcmp(ea->addr, eb->addr);
+
+	if(cmp)
+		return cmp;
+	return (ea->seq > eb->seq) - (ea->seq < eb->seq);
+}
+
+static int EffectFind(const void *key, const void *b) {
+	return strcmp((const char *)key, ((const journal_effect *)b)->addr);
+}
+
+// write, sync and rename tmppath over fullpath
+static int ReplaceFile(const char *tmppath, const char *fullpath, FILE *file_stream) {
+	int ret = 0;
+
+	if(fflush(file_stream) != 0 || fsync(fileno(file_stream)) < 0)
+		ret = -1;
+	if(fclose(file_stream) != 0)
+		ret = -1;
+	if(ret < 0 || rename(tmppath, fullpath) < 0) {
+		unlink(tmppath);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Fold the journal into friendlyname and paireddevice, called with the
+* lock held. The journal is locked against the other process from the
+* walk of the records to the emptying, no record is appended between.
+* Each file is written aside, synced and renamed over the old one, then
+* the journal is emptied. The records are idempotent, so a power loss
+* before the journal is emptied only replays them again.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* 0: success
+* -1: fail, the journal is kept
+******************************************************************************/
+static int JournalCompact(void) {
+	char fullpath[JOURNAL_PATH_LENG] = {};
+	char tmppath[JOURNAL_PATH_LENG] = {};
+	char read_buff[JOURNAL_LINE_LENG] = {};
+	char upper[BT_ADDR_LENGTH] = {};
+	journal_effects effects;
+	journal_effect *effect;
+	journal_name name;
+	FILE *file_stream, *new_stream;
+	const char *map = NULL;
+	size_t map_size;
+	unsigned int i, kept;
+	int dir_fd, line_start = 1, skip = 0, ret = -1;
+
+	memset(&effects, 0, sizeof(effects));
+	if(JournalLock(LOCK_EX) < 0)
+		return -1;
+	// emptied by the other process already
+	if((map_size = journal.size) == 0) {
+		JournalUnlock();
+		return 0;
+	}
+	// the names of the effects point into the map, it is kept until the files are written
+	if((map = (const char *)mmap(NULL, map_size, PROT_READ, MAP_SHARED, journal.fd, 0)) == MAP_FAILED) {
+		map = NULL;
+		goto end;
+	}
+
+	// friendly name
+	ReadFriendlyName(&name);
+	JournalWalkMap(map, map_size, NameRecord, &name);
+	AdaptorPath(fullpath, "friendlyname");
+	AdaptorPath(tmppath, "friendlyname~");
+	if(name.set) {
+		if((new_stream = fopen(tmppath, "w")) == NULL)
+			goto end;
+		fputs(name.name, new_stream);
+		if(ReplaceFile(tmppath, fullpath, new_stream) < 0)
+			goto end;
+	} else
+		unlink(fullpath);
+
+	// paired devices, the last record of each device since the last X
+	JournalWalkMap(map, map_size, EffectRecord, &effects);
+	qsort(effects.effect, effects.num, sizeof(journal_effect), EffectCompare);
+	for(i = 0, kept = 0; i < effects.num; i++) {
+		if(i + 1 < effects.num && !strcmp(effects.effect[i].addr, effects.effect[i+1].addr))
+			continue;
+		effects.effect[kept++] = effects.effect[i];
+	}
+	effects.num = kept;
+
+	AdaptorPath(fullpath, "paireddevice");
+	AdaptorPath(tmppath, "paireddevice~");
+	if((new_stream = fopen(tmppath, "w")) == NULL)
+		goto end;
+	if(!effects.all_removed && (file_stream = fopen(fullpath, "r")) != NULL) {
+		while(fgets(read_buff, sizeof(read_buff), file_stream)) {
+			// a line longer than the buffer is read in pieces, only its first piece has the address
+			if(line_start) {
+				AddrUpper(upper, read_buff);
+				skip = (bsearch(upper, effects.effect, effects.num, sizeof(journal_effect), EffectFind) != NULL);
+			}
+			if(!skip)
+				fputs(read_buff, new_stream);
+			line_start = (read_buff[strlen(read_buff)-1] == '\n');
+			memset(read_buff, 0, sizeof(read_buff));
+		}
+		fclose(file_stream);
+	}
+	for(i = 0; i < effects.num; i++) {
+		effect = &effects.effect[i];
+		if(effect->name)
+			fprintf(new_stream, "%s,%.*s\n", effect->addr, (int)effect->name_leng, effect->name);
+	}
+	if(ReplaceFile(tmppath, fullpath, new_stream) < 0)
+		goto end;
+
+	// the renames reach the flash before the records go away
+	GetBTFilePath(fullpath, "");
+	if((dir_fd = open(fullpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0) {
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+	if(ftruncate(journal.fd, 0) < 0 || fdatasync(journal.fd) < 0)
+		goto end;
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %u bytes of records folded, %u paired devices changed\n", __FUNCTION__, (unsigned int)journal.size, effects.num);
+	journal.size = 0;
+	ret = 0;
+
+end:
+	if(map)
+		munmap((void *)map, map_size);
+	JournalUnlock();
+	free(effects.effect);
+	return ret;
+}
+
+/***********************************************************************
+* Description:
+* Put the records on the flash with one sync, and fold the journal into
+* the files when it has grown beyond JOURNAL_COMPACT_SIZE. Called by the
+* thread of the journal JOURNAL_SYNC_MS after the first record of a
+* batch, and at exit.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* none
+******************************************************************************/
+void JournalFlush(void) {
+	pthread_mutex_lock(&journal.lock);
+	if(journal.fd >= 0 && journal.unsynced) {
+		if(fdatasync(journal.fd) < 0 && debuglog_enable)
+			debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - fdatasync() %s failed %s\n", __FUNCTION__, journal.path, strerror(errno));
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %d records synced\n", __FUNCTION__, journal.unsynced);
+		journal.unsynced = 0;
+	}
+	if(journal.fd >= 0 && journal.size > JOURNAL_COMPACT_SIZE && JournalCompact() < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - compaction of %s failed, the journal is kept\n", __FUNCTION__, journal.path);
+	}
+	pthread_mutex_unlock(&journal.lock);
+}
+
+// on the timer thread, the flush is left to the thread of the journal
+static void JournalSyncTimeout(void *arg) {
+	pthread_mutex_lock(&journal.due_lock);
+	journal.due = 1;
+	pthread_cond_signal(&journal.due_cond);
+	pthread_mutex_unlock(&journal.due_lock);
+}
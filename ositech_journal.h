@@ -0,0 +1,35 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_journal.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_JOURNAL_H
+#define __OSITECH_JOURNAL_H
+
+#define JOURNAL_SYNC_MS		2000		// records reach the flash at most this late
+#define JOURNAL_COMPACT_SIZE	(16*1024)	// the journal is folded into the files beyond this
+
+/*
+ a paired device of the journal, in the order written. addr is NULL when
+ every paired device is removed, name is NULL when addr is removed.
+*/
+typedef void (*journal_paired_cb)(const char *addr, const char *name, void *arg);
+
+extern int JournalSetName(const char *name);
+extern int JournalGetName(char *name, const int name_leng);
+extern int JournalSetPaired(const char *addr, const char *name);
+extern int JournalRemovePaired(const char *addr);
+extern void JournalReplayPaired(journal_paired_cb cb, void *arg);
+extern void JournalFlush(void);
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		persistent controller of the Bluetooth LED
+* File Name:			ositech_led.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_bt.h"
+#include "ositech_timer.h"
+#include "ositech_led.h"
+
+extern char **environ;
+
+static void LedActivityCheck(void *arg);
+static void LedRetry(void *arg);
+
+static struct {
+	int backend;
+	char path[LED_PATH_LENG];
+	int brightness_fd;	// sysfs only, kept open
+	int trigger_fd;		// sysfs only, kept open
+	int helper_fd;		// exec only, the modes to the titan3_led helper
+	pid_t helper_pid;
+	int mode;			// mode requested by the caller
+	int hw_mode;		// mode shown by the LED
+	int pending;		// mode the helper was too busy to take, -1 if none
+	unsigned int transitions;	// stub only, the transitions applied
+	int activity;		// data activity blink is running
+	unsigned long bytes;		// transfer byte counter
+	unsigned long bytes_seen;
+	bt_timer_t activity_timer;
+	bt_timer_t retry_timer;
+	pthread_mutex_t lock;
+} led = {
+	.backend = LED_BACKEND_EXEC,
+	.brightness_fd = -1,
+	.trigger_fd = -1,
+	.helper_fd = -1,
+	.mode = -1,
+	.hw_mode = -1,
+	.pending = -1,
+	.activity_timer = {.cb = LedActivityCheck},
+	.retry_timer = {.cb = LedRetry},
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/***********************************************************************
+* Description:
+* Start the helper shell that runs "titan3_led bt N" for every mode read
+* from its stdin. It's started once by LedInit() and fed over a socket, so
+* a transition costs the daemon one send() instead of a spawn and a wait.
+* The helper only keeps stdin, stdout and stderr, every other fd of the
+* daemon (listener, MRx and HCI sockets...) is closed in the child.
+*
+* Calling Arguments:
+* Name			Description
+* None
+*
+* Return Value:
+* 0: success
+* -1: fail
+******************************************************************************/
+static int LedHelperStart(void) {
+	char *argv[] = {"sh", "-c", LED_HELPER_SCRIPT, NULL};
+	posix_spawn_file_actions_t actions;
+	struct dirent *entry;
+	DIR *fd_dir;
+	int sv[2];
+	int fd, res;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+		return -1;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+	if((fd_dir = opendir(LED_FD_DIR)) != NULL) {
+		while((entry = readdir(fd_dir)) != NULL) {
+			if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+				continue;
+			fd = atoi(entry->d_name);
+			if(fd > STDERR_FILENO && fd != dirfd(fd_dir))
+				posix_spawn_file_actions_addclose(&actions, fd);
+		}
+		closedir(fd_dir);
+	}
+	res = posix_spawn(&led.helper_pid, LED_HELPER_SHELL, &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(sv[1]);
+	if(res != 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s posix_spawn() %s failed\n", __FUNCTION__, LED_HELPER_SHELL);
+		close(sv[0]);
+		return -1;
+	}
+	led.helper_fd = sv[0];
+	return 0;
+}
+
+static void LedHelperStop(void) {
+	int status;
+
+	if(led.helper_fd < 0)
+		return;
+	close(led.helper_fd);
+	led.helper_fd = -1;
+	while(waitpid(led.helper_pid, &status, 0) < 0 && errno == EINTR);
+}
+
+/***********************************************************************
+* Description:
+* Give the mode to the titan3_led helper. A helper that went away isn't
+* started again from here, the LED stays as it is.
+*
+* Calling Arguments:
+* Name			Description
+* mode		the LED mode
+*
+* Return Value:
+* 0: success
+* LED_APPLY_AGAIN: the helper is busy, the mode is to be sent again
+* -1: fail
+******************************************************************************/
+static int LedExecApply(const int mode) {
+	char mode_string[8] = {};
+	int leng;
+
+	if(led.helper_fd < 0)
+		return -1;
+
+	leng = snprintf(mode_string, sizeof(mode_string), "%d\n", mode);
+	if(send(led.helper_fd, mode_string, leng, MSG_NOSIGNAL | MSG_DONTWAIT) == leng)
+		return 0;
+	if(errno == EAGAIN || errno == EWOULDBLOCK)
+		return LED_APPLY_AGAIN;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s mode %d is not given to %s -- %s\n", __FUNCTION__, mode, LED_EXEC_CMD, strerror(errno));
+	LedHelperStop();
+	return -1;
+}
+
+static int LedSysfsWrite(const int fd, const char *value) {
+	if(fd < 0)
+		return -1;
+	if(pwrite(fd, value, strlen(value), 0) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s write() %s -- %s\n", __FUNCTION__, value, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+// delay_on/delay_off only exist once the timer trigger is set, open them on demand.
+static void LedSysfsFlash(const unsigned int msec) {
+	char fullpath[LED_PATH_LENG+16] = {};
+	char value[16] = {};
+	const char *delay[] = {"delay_on", "delay_off"};
+	int fd, i;
+
+	LedSysfsWrite(led.trigger_fd, "timer");
+	snprintf(value, sizeof(value), "%u", msec);
+	for(i = 0; i < 2; i++) {
+		snprintf(fullpath, sizeof(fullpath), "%s/%s", led.path, delay[i]);
+		if((fd = open(fullpath, O_WRONLY)) < 0)
+			continue;
+		LedSysfsWrite(fd, value);
+		close(fd);
+	}
+}
+
+static int LedSysfsApply(const int mode) {
+	switch(mode) {
+		case BT_LED_OFF:
+			LedSysfsWrite(led.trigger_fd, "none");
+			return LedSysfsWrite(led.brightness_fd, "0");
+		case BT_LED_SOLID:
+			LedSysfsWrite(led.trigger_fd, "none");
+			return LedSysfsWrite(led.brightness_fd, "255");
+		case BT_LED_FLASH_DISCOVERABLE:
+			LedSysfsFlash(LED_FLASH_DISCOV_MS);
+			return 0;
+		case BT_LED_FLASH_INQ:
+			LedSysfsFlash(LED_FLASH_INQ_MS);
+			return 0;
+		case BT_LED_DATA_ACTIVITY:
+			LedSysfsFlash(LED_FLASH_DATA_MS);
+			return 0;
+	}
+	return -1;
+}
+
+/***********************************************************************
+* Description:
+* Drive the LED into the given mode. Redundant transitions are dropped
+* here, so the callers never have to remember what the LED is showing.
+* The mode is only taken as shown once the backend applied it, a mode
+* the helper was too busy to take is sent again from the timer wheel.
+* Called with led.lock held.
+*
+* Calling Arguments:
+* Name			Description
+* mode		the LED mode
+*
+* Return Value:
+* none
+******************************************************************************/
+static void LedApply(const int mode) {
+	int res;
+
+	if(mode == led.hw_mode) {
+		led.pending = -1;
+		return;
+	}
+
+	switch(led.backend) {
+		case LED_BACKEND_SYSFS:
+			res = LedSysfsApply(mode);
+			break;
+		case LED_BACKEND_STUB:
+			printf("[LED] %d -> %d\n", led.hw_mode, mode);
+			led.transitions++;
+			res = 0;
+			break;
+		case LED_BACKEND_EXEC:
+		default:
+			res = LedExecApply(mode);
+			break;
+	}
+
+	if(res == LED_APPLY_AGAIN) {
+		led.pending = mode;
+		TimerStart(&led.retry_timer, LED_RETRY_MS);
+		return;
+	}
+	led.pending = -1;
+	if(res == 0)
+		led.hw_mode = mode;
+}
+
+// the helper was busy, send the last mode again unless a later one went through
+static void LedRetry(void *arg) {
+	pthread_mutex_lock(&led.lock);
+	if(led.pending >= 0)
+		LedApply(led.pending);
+	pthread_mutex_unlock(&led.lock);
+}
+
+/***********************************************************************
+* Description:
+* Periodic check of the data activity, called from the timer wheel. The
+* LED keeps blinking as long as the byte counter moves and goes back to
+* the requested mode once the transfer stalls.
+******************************************************************************/
+static void LedActivityCheck(void *arg) {
+	pthread_mutex_lock(&led.lock);
+	if(led.mode == BT_LED_SOLID && led.bytes != led.bytes_seen) {
+		led.bytes_seen = led.bytes;
+		TimerStart(&led.activity_timer, LED_ACTIVITY_POLL);
+	} else {
+		led.activity = 0;
+		LedApply(led.mode);
+	}
+	pthread_mutex_unlock(&led.lock);
+}
+
+/***********************************************************************
+* Description:
+* Select the LED backend, once at start before any other thread is
+* created. titan3_led through its helper is the default, the sysfs LED is
+* only used when led.backend=sysfs and led.path= are both set.
+*
+* Calling Arguments:
+* Name			Description
+* backend		LED_BACKEND_EXEC, LED_BACKEND_SYSFS or LED_BACKEND_STUB
+* path		the sysfs directory of the LED (LED_BACKEND_SYSFS only)
+*
+* Return Value:
+* 0: success
+* -1: the sysfs LED can't be opened and titan3_led is used instead, or
+*	the titan3_led helper can't be started
+******************************************************************************/
+int LedInit(const int backend, const char *path) {
+	char fullpath[LED_PATH_LENG+16] = {};
+	int res = 0;
+
+	pthread_mutex_lock(&led.lock);
+	led.backend = backend;
+	led.hw_mode = -1;
+	led.pending = -1;
+
+	if(backend == LED_BACKEND_SYSFS) {
+		snprintf(led.path, sizeof(led.path), "%s", path ? path : "");
+		snprintf(fullpath, sizeof(fullpath), "%s/brightness", led.path);
+		led.brightness_fd = strlen(led.path) ? open(fullpath, O_WRONLY | O_CLOEXEC) : -1;
+		snprintf(fullpath, sizeof(fullpath), "%s/trigger", led.path);
+		led.trigger_fd = strlen(led.path) ? open(fullpath, O_WRONLY | O_CLOEXEC) : -1;
+		if(led.brightness_fd < 0 || led.trigger_fd < 0) {
+			printf("The sysfs LED \"%s\" can't be opened. Using %s.\n", led.path, LED_EXEC_CMD);
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s open() \"%s\" failed. Using %s\n", __FUNCTION__, led.path, LED_EXEC_CMD);
+			if(led.brightness_fd >= 0) close(led.brightness_fd);
+			if(led.trigger_fd >= 0) close(led.trigger_fd);
+			led.brightness_fd = -1;
+			led.trigger_fd = -1;
+			led.backend = LED_BACKEND_EXEC;
+			res = -1;
+		}
+	}
+	if(led.backend == LED_BACKEND_EXEC) {
+		if(led.helper_fd < 0 && LedHelperStart() < 0)
+			res = -1;
+	} else
+		LedHelperStop();
+	pthread_mutex_unlock(&led.lock);
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: LED backend %d\n", __FUNCTION__, led.backend);
+	return res;
+}
+
+void LedSetMode(const int mode) {
+	pthread_mutex_lock(&led.lock);
+	led.mode = mode;
+	// a running data activity blink ends by itself on the next check
+	if(!led.activity || mode != BT_LED_SOLID)
+		LedApply(mode);
+	pthread_mutex_unlock(&led.lock);
+}
+
+/***********************************************************************
+* Description:
+* Account transferred bytes. Only the first call of a burst takes the lock,
+* the others are a single add on the byte counter.
+*
+* Calling Arguments:
+* Name			Description
+* bytes		number of bytes transferred
+*
+* Return Value:
+* none
+******************************************************************************/
+void LedDataActivity(const unsigned int bytes) {
+	__sync_fetch_and_add(&led.bytes, bytes);
+	if(led.activity || led.mode != BT_LED_SOLID)
+		return;
+
+	pthread_mutex_lock(&led.lock);
+	if(!led.activity && led.mode == BT_LED_SOLID) {
+		led.activity = 1;
+		led.bytes_seen = led.bytes;
+		LedApply(BT_LED_DATA_ACTIVITY);
+		TimerStart(&led.activity_timer, LED_ACTIVITY_POLL);
+	}
+	pthread_mutex_unlock(&led.lock);
+}
+
+// stub only: number of transitions the LED went through
+unsigned int LedStubTransitions(void) {
+	unsigned int transitions;
+
+	pthread_mutex_lock(&led.lock);
+	transitions = led.transitions;
+	pthread_mutex_unlock(&led.lock);
+	return transitions;
+}
@@ -0,0 +1,43 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_led.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_LED_H
+#define __OSITECH_LED_H
+
+// LED backends
+#define LED_BACKEND_EXEC	0	// titan3_led bt N, run by a helper shell, the default
+#define LED_BACKEND_SYSFS	1	// /sys/class/leds/<led> given by led.path
+#define LED_BACKEND_STUB	2	// off-target, only records the transitions
+
+#define LED_EXEC_CMD	"titan3_led"
+#define LED_HELPER_SHELL	"/bin/sh"
+#define LED_HELPER_SCRIPT	"while read m; do " LED_EXEC_CMD " bt $m; done"
+#define LED_PATH_LENG	64
+#define LED_FD_DIR		"/proc/self/fd"	// fds closed in the helper
+
+#define LED_APPLY_AGAIN	1		// the helper is busy, send the mode again
+#define LED_RETRY_MS	100
+
+#define LED_ACTIVITY_POLL	100	// ms between two checks of the byte counter
+#define LED_FLASH_DISCOV_MS	500
+#define LED_FLASH_INQ_MS	100
+#define LED_FLASH_DATA_MS	50
+
+extern int LedInit(const int backend, const char *path);
+extern void LedSetMode(const int mode);
+extern void LedDataActivity(const unsigned int bytes);
+extern unsigned int LedStubTransitions(void);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		cache of the names of the remote devices, kept in
+*				remotenames of the adaptor. The names read by the
+*				inquiries and the pairings are given before any name
+*				request, and a name read long ago is read again in the
+*				background. The names reach the flash from a thread of
+*				the cache woken by the timer.
+* File Name:			ositech_names.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "config.h"
+#include "hci_info.h"
+#include "ositech_bt.h"
+#include "ositech_budget.h"
+#include "ositech_timer.h"
+#include "ositech_trust.h"
+#include "ositech_inquiry.h"
+#include "ositech_discovery.h"
+#include "ositech_names.h"
+
+#define NAMES_PATH_LENG		64		// the paths of hci_info.c
+#define NAMES_SLOTS			256		// power of 2, twice NAMES_MAX
+#define NAMES_FILE			"remotenames"	// "<addr> <time read> <name>" per line
+#define NAMES_LINE_LENG		(BT_ADDR_LENGTH + BT_NAME_LENGTH + 24)
+
+typedef struct name_entry {
+	bdaddr_t bdaddr;
+	time_t refreshed;	// the name was read
+	time_t saved;		// refreshed as kept on the flash
+	time_t checked;		// a refresh was asked, in memory only
+	char name[BT_NAME_LENGTH];
+} name_entry;
+
+/*
+ the names in the order added. slots is an open addressing hash of the
+ address to index+1 of entry, 0 for a free slot. It's built again when a
+ name gives way.
+*/
+static struct name_cache {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	char path[NAMES_PATH_LENG];	// "" until loaded
+	name_entry entry[NAMES_MAX];
+	unsigned int num;
+	unsigned short slots[NAMES_SLOTS];
+	int dirty;			// names not on the flash yet
+	bt_timer_t timer;
+	int timer_init;
+	int exit_hook;
+	int saver;			// the save thread is running, else the names are saved as changed
+	bdaddr_t queue[NAMES_REFRESH_QUEUE];	// names to read again
+	int nqueue;
+	// the timer only wakes the save thread, the sync may take long on the flash
+	pthread_mutex_t due_lock;
+	pthread_cond_t due_cond;
+	int due;
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.due_lock = PTHREAD_MUTEX_INITIALIZER,
+	.due_cond = PTHREAD_COND_INITIALIZER,
+};
+static pthread_once_t refresh_once = PTHREAD_ONCE_INIT;
+
+static unsigned int AddrSlot(const bdaddr_t *bdaddr) {
+	uint64_t key = 0;
+	int i;
+
+	for(i = 0; i < 6; i++)
+		key = (key << 8) | bdaddr->b[i];
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (NAMES_SLOTS - 1);
+}
+
+static name_entry *FindName(const bdaddr_t *bdaddr) {
+	unsigned int slot;
+
+	for(slot = AddrSlot(bdaddr); cache.slots[slot]; slot = (slot + 1) & (NAMES_SLOTS - 1)) {
+		if(!bacmp(&cache.entry[cache.slots[slot] - 1].bdaddr, bdaddr))
+			return &cache.entry[cache.slots[slot] - 1];
+	}
+	return NULL;
+}
+
+static void LinkName(const unsigned int index) {
+	unsigned int slot;
+
+	for(slot = AddrSlot(&cache.entry[index].bdaddr); cache.slots[slot]; slot = (slot + 1) & (NAMES_SLOTS - 1))
+		;
+	cache.slots[slot] = index + 1;
+}
+
+// a new name, the one read the longest ago gives way when full
+static name_entry *AddName(const bdaddr_t *bdaddr) {
+	name_entry *entry;
+	unsigned int i, oldest = 0;
+
+	if(cache.num < NAMES_MAX) {
+		entry = &cache.entry[cache.num];
+		memset(entry, 0, sizeof(*entry));
+		bacpy(&entry->bdaddr, bdaddr);
+		LinkName(cache.num++);
+		return entry;
+	}
+
+	for(i = 1; i < cache.num; i++) {
+		if(cache.entry[i].refreshed < cache.entry[oldest].refreshed)
+			oldest = i;
+	}
+	entry = &cache.entry[oldest];
+	memset(entry, 0, sizeof(*entry));
+	bacpy(&entry->bdaddr, bdaddr);
+	memset(cache.slots, 0, sizeof(cache.slots));
+	for(i = 0; i < cache.num; i++)
+		LinkName(i);
+	return entry;
+}
+
+// write the names to remotenames, through a copy synced before it replaces the file
+static void NamesSave(void) {
+	char tmppath[NAMES_PATH_LENG + 1];
+	char addr[BT_ADDR_LENGTH];
+	FILE *file_stream;
+	unsigned int i;
+
+	if(!cache.dirty || !strlen(cache.path))
+		return;
+
+	snprintf(tmppath, sizeof(tmppath), "%s~", cache.path);
+	if((file_stream = fopen(tmppath, "w")) == NULL) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - fopen() %s failed %s\n", __FUNCTION__, tmppath, strerror(errno));
+		return;
+	}
+	for(i = 0; i < cache.num; i++) {
+		ba2str(&cache.entry[i].bdaddr, addr);
+		fprintf(file_stream, "%s %lu %s\n", addr, (unsigned long)cache.entry[i].refreshed, cache.entry[i].name);
+	}
+	if(fflush(file_stream) != 0 || fsync(fileno(file_stream)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - write %s failed %s\n", __FUNCTION__, tmppath, strerror(errno));
+		fclose(file_stream);
+		unlink(tmppath);
+		return;
+	}
+	fclose(file_stream);
+	if(rename(tmppath, cache.path) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - rename() %s failed %s\n", __FUNCTION__, tmppath, strerror(errno));
+		unlink(tmppath);
+		return;
+	}
+	for(i = 0; i < cache.num; i++)
+		cache.entry[i].saved = cache.entry[i].refreshed;
+	cache.dirty = 0;
+}
+
+// on the timer thread, the save is left to the save thread
+static void NamesSyncTimeout(void *arg) {
+	pthread_mutex_lock(&cache.due_lock);
+	cache.due = 1;
+	pthread_cond_signal(&cache.due_cond);
+	pthread_mutex_unlock(&cache.due_lock);
+}
+
+static void *SaveThread(void *arg) {
+	while(1) {
+		pthread_mutex_lock(&cache.due_lock);
+		while(!cache.due)
+			pthread_cond_wait(&cache.due_cond, &cache.due_lock);
+		cache.due = 0;
+		pthread_mutex_unlock(&cache.due_lock);
+
+		NamesFlush();
+	}
+	return NULL;
+}
+
+static int SaveStart(void) {
+	pthread_t thread;
+	pthread_attr_t attr;
+	int ret = 0;
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, SaveThread, NULL) != 0) {
+		perror("pthread_create() of the name save failed");
+		ret = -1;
+	}
+	pthread_attr_destroy(&attr);
+	return ret;
+}
+
+static void NamesAtExit(void) {
+	NamesFlush();
+}
+
+/***********************************************************************
+* Description:
+* Load remotenames of the adaptor in use, called with the lock held. The
+* names of another adaptor are saved first.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* none
+******************************************************************************/
+static void NamesOpen(void) {
+	char path[NAMES_PATH_LENG] = {};
+	char line[NAMES_LINE_LENG];
+	char *pname, *pend;
+	bdaddr_t bdaddr;
+	unsigned long refreshed;
+	name_entry *entry;
+	FILE *file_stream;
+
+	if(!cache.timer_init) {
+		TimerInit(&cache.timer, NamesSyncTimeout, NULL);
+		cache.saver = (SaveStart() == 0);
+		cache.timer_init = 1;
+	}
+	if(!cache.exit_hook)
+		cache.exit_hook = !atexit(NamesAtExit);
+
+	GetBTFilePath(path, NAMES_FILE);
+	if(!strcmp(path, cache.path))
+		return;
+
+	NamesSave();
+	cache.num = 0;
+	cache.dirty = 0;
+	memset(cache.slots, 0, sizeof(cache.slots));
+	snprintf(cache.path, sizeof(cache.path), "%s", path);
+
+	if((file_stream = fopen(path, "r")) != NULL) {
+		while(fgets(line, sizeof(line), file_stream)) {
+			line[strcspn(line, "\r\n")] = '\0';
+			if(strlen(line) < BT_ADDR_LENGTH || line[BT_ADDR_LENGTH - 1] != ' ')
+				continue;
+			line[BT_ADDR_LENGTH - 1] = '\0';
+			if(str2ba(line, &bdaddr) < 0)
+				continue;
+			refreshed = strtoul(line + BT_ADDR_LENGTH, &pend, 10);
+			if(*pend != ' ')
+				continue;
+			pname = pend + 1;
+			if((entry = FindName(&bdaddr)) == NULL)
+				entry = AddName(&bdaddr);
+			entry->refreshed = entry->saved = (time_t)refreshed;
+			snprintf(entry->name, sizeof(entry->name), "%s", pname);
+		}
+		fclose(file_stream);
+	}
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %u names\n", __FUNCTION__, path, cache.num);
+}
+
+static void RefreshResult(const inq_dev *dev, void *arg) {
+	char addr[BT_ADDR_LENGTH];
+
+	ba2str(&dev->bdaddr, addr);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: name of %s %s\n", __FUNCTION__, addr, (dev->name_state == INQ_NAME_DONE) ? "read again" : "not read");
+}
+
+// read the names of the queue again, while no OBEX link is up: DiscoveryPause() cancels the names left
+static void *RefreshThread(void *arg) {
+	inq_dev devs[NAMES_REFRESH_QUEUE];
+	int ndevs, dev_id, i;
+
+	while(1) {
+		pthread_mutex_lock(&cache.lock);
+		while(!cache.nqueue)
+			pthread_cond_wait(&cache.cond, &cache.lock);
+		memset(devs, 0, sizeof(devs));
+		for(i = 0; i < cache.nqueue; i++) {
+			bacpy(&devs[i].bdaddr, &cache.queue[i]);
+			devs[i].pscan_rep_mode = INQ_PSCAN_REP_MODE_R2;
+		}
+		ndevs = cache.nqueue;
+		cache.nqueue = 0;
+		pthread_mutex_unlock(&cache.lock);
+
+		if((dev_id = DiscoveryBackgroundBegin()) >= 0) {
+			InqResolveNames(dev_id, devs, ndevs, INQ_RUN_BACKGROUND, RefreshResult, NULL);	// the names go to NamesPut()
+			DiscoveryBackgroundEnd();
+		}
+	}
+	return NULL;
+}
+
+static void RefreshStart(void) {
+	pthread_t thread;
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, RefreshThread, NULL) != 0)
+		perror("pthread_create() of the name refresh failed");
+	pthread_attr_destroy(&attr);
+}
+
+/***********************************************************************
+* Description:
+* Get the name of a remote device without a name request. The cache is
+* looked up first, then the names read by bluetoothd. A name older than
+* NAMES_REFRESH_S is given and read again in the background.
+*
+* Calling Arguments:
+* Name			Description
+* bdaddr	the device
+* name		buffer of the name
+* name_leng	size of name
+*
+* Return Value:
+* 0: success
+* -1: the name isn't known
+******************************************************************************/
+int NamesGet(const bdaddr_t *bdaddr, char *name, const int name_leng) {
+	char addr[BT_ADDR_LENGTH];
+	name_entry *entry;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&cache.lock);
+	NamesOpen();
+	if((entry = FindName(bdaddr)) != NULL) {
+		snprintf(name, name_leng, "%s", entry->name);
+		if(now - ((entry->checked > entry->refreshed) ? entry->checked : entry->refreshed) > NAMES_REFRESH_S &&
+			cache.nqueue < NAMES_REFRESH_QUEUE) {
+			entry->checked = now;
+			bacpy(&cache.queue[cache.nqueue++], bdaddr);
+			pthread_once(&refresh_once, RefreshStart);
+			pthread_cond_signal(&cache.cond);
+		}
+		pthread_mutex_unlock(&cache.lock);
+		return 0;
+	}
+	pthread_mutex_unlock(&cache.lock);
+
+	ba2str(bdaddr, addr);
+	if(TrustInqName(addr, name, name_leng) < 0)
+		return -1;
+	NamesPut(bdaddr, name);
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Keep the name read from a remote device. A new or changed name is synced
+* to the flash by the save thread, woken by the timer, with the names
+* which follow. The same name
+* read again only moves the time it was read, which goes to the flash once
+* it's NAMES_STAMP_S ahead of the one kept there: every discovery gives
+* the names of the EIR again, the file isn't rewritten for them.
+*
+* Calling Arguments:
+* Name			Description
+* bdaddr	the device
+* name		the name, "" is not kept
+*
+* Return Value:
+* none
+******************************************************************************/
+void NamesPut(const bdaddr_t *bdaddr, const char *name) {
+	char copy[BT_NAME_LENGTH];
+	name_entry *entry;
+	int changed = 0;
+
+	if(name == NULL || !strlen(name))
+		return;
+
+	pthread_mutex_lock(&cache.lock);
+	NamesOpen();
+	if((entry = FindName(bdaddr)) == NULL) {
+		entry = AddName(bdaddr);
+		changed = 1;
+	}
+	entry->refreshed = time(NULL);
+	entry->checked = 0;
+	snprintf(copy, sizeof(copy), "%s", name);
+	copy[strcspn(copy, "\r\n")] = '\0';
+	if(strcmp(entry->name, copy)) {
+		snprintf(entry->name, sizeof(entry->name), "%s", copy);
+		changed = 1;
+	}
+	if(changed || entry->refreshed - entry->saved >= NAMES_STAMP_S) {
+		cache.dirty = 1;
+		if(!cache.saver || (!TimerPending(&cache.timer) && TimerStart(&cache.timer, NAMES_SYNC_MS) < 0))
+			NamesSave();
+	}
+	pthread_mutex_unlock(&cache.lock);
+}
+
+void NamesFlush(void) {
+	pthread_mutex_lock(&cache.lock);
+	NamesSave();
+	pthread_mutex_unlock(&cache.lock);
+}
@@ -0,0 +1,31 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_names.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_NAMES_H
+#define __OSITECH_NAMES_H
+
+#include <bluetooth/bluetooth.h>
+
+#define NAMES_MAX			128				// remote names kept, the one read the longest ago gives way
+#define NAMES_REFRESH_S		(24*60*60)		// a name older than this is read again in the background
+#define NAMES_SYNC_MS		5000			// the cache reaches the flash at most this late
+#define NAMES_STAMP_S		(60*60)			// the time a name was read again is kept on the flash this coarsely
+#define NAMES_REFRESH_QUEUE	8				// names waiting to be read again
+
+extern int NamesGet(const bdaddr_t *bdaddr, char *name, const int name_leng);
+extern void NamesPut(const bdaddr_t *bdaddr, const char *name);
+extern void NamesFlush(void);
+
+#endif
@@ -14,6 +14,8 @@
 * Changes:
 **********************************************************************/
 
+#define _GNU_SOURCE	// POLLRDHUP
+#define _FILE_OFFSET_BITS 64	// files beyond 2GB
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -23,11 +25,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include <debuglog.h>
-#include <semaphore.h>
-#include <time.h>
-#include <signal.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
@@ -50,168 +54,180 @@
 #include "config.h"
 #include "ositech_bt.h"
 #include "sdp_op.h"
+#include "ositech_timer.h"
+#include "ositech_event.h"
+#include "ositech_stats.h"
+#include "ositech_led.h"
+#include "ositech_digest.h"
+#include "ositech_arena.h"
+#include "ositech_budget.h"
+#include "ositech_discovery.h"
 
 #define FTP_ARG_BUFF_SIZE	512
 #define ERROR_RECV	-1
 
 #define STREAM_CHUNK 4096
-#define ONE_SECOND 	1
-
-typedef struct pthread_arg {
-	obexftp_client_t *client;
-	int sockfd;
-	int thread_exit;
-} dir_arg;
-
-typedef struct pthread_timer_arg {
-	obexftp_client_t **client;
-//	uint8_t count_down;
-	uint timeout;
-	uint8_t timer_exit;
-	int led_org;
-	sem_t start_timer;
-	sem_t stop_timer;
+#define ONE_SECOND 	1000
+#define OBEX_SYNC_TIMEOUT	20	// second without any OBEX packet
+#define OBEX_CANCEL_TIMEOUT	2	// second to wait for the ABORT response
+#define FTP_IDLE_TIMEOUT	0x100	// cause of the cancellation token fired by the inactivity timer
+
+#define MRX_LENG_SIZE	16		// the length line of a MRx data chunk
+#define MRX_PIPE_FILL	OBEX_MAXIMUM_MTU	// a whole OBEX packet, the MTU negotiated at CONNECT is never above
+#define MRX_PIPE_SLACK	(2*4096)	// the pipe pages partly read by obexftp and partly written
+
+// cancellation token of a FTP session.
+typedef struct ftp_cancel_token {
+	int efd;		// eventfd, readable once the token is fired
+	int watch_fd;	// MRx socket watched during the request, -1 if none
+	int watch_cmd;	// the MRx socket can be read for ABORT/ATH
+	int cause;		// BT_FTP_ABORT, BT_FTP_HANG or FTP_IDLE_TIMEOUT, 0 if not cancelled
+} ftp_cancel;
+
+/*
+ MRx data stream of a PUT. The MRx framing (length, "?", data, "!") is handled
+ here, and the data is handed to the OBEX layer through a pipe, which
+ obexftp reads as a plain file.
+*/
+typedef struct mrx_data_stream {
+	int sockfd;		// MRx socket
+	int pipefd[2];	// [0] read by obexftp, [1] filled from the MRx
+	int eof;		// "0" received, or the stream failed
+	int fill;		// bytes kept in the pipe ahead of obexftp
+	int pipe_size;	// capacity of the pipe
+	int leng;		// length of the current MRx chunk
+	int left;		// bytes of the current MRx chunk still in the MRx socket
+	unsigned long long ask;	// StatsNow() of the "?" of the current chunk
+	char *buf;
+	int buf_size;	// a bigger MRx chunk goes through buf in several pieces
+} mrx_stream;
+
+/*
+ context of a FTP session. It's kept in the infocb_data of the obexftp client,
+ so every request sent on the connection can reach it.
+*/
+typedef struct ftp_session_ctx {
+	ftp_cancel cancel;
+	const char *addr;	// BT address of the peer
+	mrx_stream *stream;	// PUT from the MRx in progress, NULL otherwise
+	xfer_stats *stats;	// transfer being measured, NULL otherwise
+	xfer_digest *digest;	// digest of the PUT data, NULL if none
+	arena_t arena;		// memory of the FTP command in progress
+} ftp_ctx;
+
+/*
+ link used by the OBEX client. Bluetooth in the field, OBEX over TCP or an
+ already connected socket (socketpair) to run against OBEX_peer_simulator.
+*/
+static struct {
+	int type;		// OBEX_TRANS_BLUETOOTH, OBEX_TRANS_INET or OBEX_TRANS_FD
+	char host[OBEX_HOST_LENG];
+	int port;
+	int fd;
+} obex_link = {
+	.type = OBEX_TRANS_BLUETOOTH,
+	.port = OBEX_INET_PORT,
+	.fd = -1,
+};
+
+// digest reported with the PUT result, digest.type= of bt_obex.conf
+static int put_digest = DIGEST_CRC32;
+
+static void CancelFire(ftp_cancel *cancel, const int cause);
+static int SendObexRequest(obexftp_client_t *cli, obex_object_t *object);
+static int SendObexRequestStats(obexftp_client_t *cli, obex_object_t *object, xfer_stats *stats);
+
+typedef struct ftp_timer_arg {
+	ftp_cancel *cancel;
+	bt_timer_t timer;
 } timer_arg;
 
-static int bt_data_activity;
+/*********************************************************************** 
+* Description:
+* Info callback of the obexftp client. Every progress event of a transfer
+* feeds the data activity blink of the Bluetooth LED.
+* 
+* Calling Arguments: 
+* Name			Description 
+* event		OBEXFTP_EV_*
+* buf		event data
+* len		length of the event data
+* data		the ftp_ctx of the session, may be NULL
+*
+* Return Value: 
+* none
+******************************************************************************/
+static void ObexInfoCallback(int event, const char *buf, int len, void *data) {
+	if(event == OBEXFTP_EV_PROGRESS || event == OBEXFTP_EV_BODY)
+		LedDataActivity(len > 0 ? len : 1);
+}
+
+static ftp_cancel *CliCancel(obexftp_client_t *cli) {
+	ftp_ctx *ctx = (ftp_ctx *)cli->infocb_data;
 
-static void ResetBTLED(union sigval sig) {
-//	printf("ResetBTLED timeout\n");
-	bt_data_activity = 0;
+	return ctx ? &ctx->cancel : NULL;
 }
 
-void *SetBTLedinDataActive(void *arg) {
-	struct itimerspec itv;
-	struct sigevent sev;
-	timer_t bt_led_timer;
-	int timeout_nanosec = 100000000;
-	char reset_data[512] = {};
-	int fd, rd_sz;
-	int led_mode = BT_LED_DATA_ACTIVITY;
-	int *thead_exit = (int *)arg;
-
-	// set bt led into act mode
-	SetBTLed(BT_LED_DATA_ACTIVITY);
-	bt_data_activity = 1;
-	usleep(75000);
-	
-	// create timer
-	sev.sigev_notify = SIGEV_THREAD;
-	sev.sigev_notify_function = ResetBTLED;
-	sev.sigev_notify_attributes = NULL;
-	if(timer_create(CLOCK_REALTIME, &sev, &bt_led_timer) < 0) {
-		perror("SetBTLedinDataActive: timer_create() failed");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: timer_create() failed.\n", __FUNCTION__);
-		goto end;
-	}
+static xfer_stats *CliStats(obexftp_client_t *cli) {
+	ftp_ctx *ctx = (ftp_ctx *)cli->infocb_data;
 
-	// start timer
-	itv.it_value.tv_sec = 0;
-	itv.it_value.tv_nsec = timeout_nanosec;
-	itv.it_interval.tv_sec = 0;
-	itv.it_interval.tv_nsec = 0;
+	return ctx ? ctx->stats : NULL;
+}
 
-	if(timer_settime(bt_led_timer, 0, &itv, NULL) < 0) {
-		perror("SetBTLedinDataActive: timer_settime() failed");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s(%d): timer_settime() failed.\n", __FUNCTION__, __LINE__);
-		goto end1;
-	}
+/*********************************************************************** 
+* Description:
+* memory needed by a request. Within a FTP session it's taken from the
+* session arena and given back all at once after the FTP command, so
+* CliFree() does nothing. Without a session it's the heap.
+* 
+* Calling Arguments: 
+* Name			Description 
+* cli		pointer to contain the connection infomation
+* size		bytes requested
+*
+* Return Value: 
+* the memory, NULL if fail
+******************************************************************************/
+static void *CliAlloc(obexftp_client_t *cli, const size_t size) {
+	ftp_ctx *ctx = (ftp_ctx *)cli->infocb_data;
 
-	if((fd = open(BT_LED_STATE_FIFO, O_RDONLY | O_NONBLOCK)) < 0) {
-		perror("SetBTLedinDataActive: open() failed");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: open() failed.\n", __FUNCTION__);
-		goto end1;
-	}
+	return ctx ? ArenaAlloc(&ctx->arena, size) : malloc(size);
+}
 
+static void CliFree(obexftp_client_t *cli, void *p) {
+	if(cli->infocb_data == NULL)
+		free(p);
+}
 
+/*********************************************************************** 
+* Description:
+* Inactivity timeout of the FTP session, called from the timer wheel. The
+* timer is only running while the session is waiting for the next command.
+* Only the session thread touches the connection, the timeout fires the
+* cancellation token to wake it up in ObexWaitCmd().
+* 
+* Calling Arguments: 
+* Name			Description 
+* argument		the timer_arg of the session
+*
+* Return Value: 
+* none
+******************************************************************************/
+static void ObexTimeout(void *argument) {
+	timer_arg *ftp_timer = (timer_arg *)argument;
 
-	while(*thead_exit == 0) {
-		rd_sz = read(fd, reset_data, sizeof(reset_data));
-		// if BT date act string is received then reset the timer to keep the BT led running in data act mode.
-		if (rd_sz) {
-			if (!bt_data_activity) {
-				bt_data_activity = 1;
-			}
-			itv.it_value.tv_sec = 0;
-			itv.it_value.tv_nsec = timeout_nanosec;
-			if(timer_settime(bt_led_timer, 0, &itv, NULL) < 0) {
-				perror("SetBTLedinDataActive: timer_settime() failed");
-				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s(%d): timer_settime() failed.\n", __FUNCTION__, __LINE__);
-				break;
-			}
-			rd_sz = 0;
-		}
-		// if BT date act string is not received then the timer will be expired, and  the BT led back to solid
-		if(!bt_data_activity && led_mode == BT_LED_DATA_ACTIVITY) {
-			SetBTLed(BT_LED_SOLID);
-			led_mode = BT_LED_SOLID;
-		} else if(bt_data_activity && led_mode == BT_LED_SOLID) {
-			SetBTLed(BT_LED_DATA_ACTIVITY);
-			led_mode = BT_LED_DATA_ACTIVITY;
-		} 
-	}
+	CancelFire(ftp_timer->cancel, FTP_IDLE_TIMEOUT);
+}
 
-	close(fd);
-	
-end1:
-	timer_delete(bt_led_timer);
-end:
-	// set bt led back to solid
-	SetBTLed(BT_LED_SOLID);
-	pthread_exit(NULL);
+// stop the inactivity timer before a FTP command touches the connection.
+static void ObexTimerHold(timer_arg *ftp_timer) {
+	TimerStop(&ftp_timer->timer);
 }
 
-void *ObexTimer(void *argument) {
-	timer_arg *ftp_timer = (timer_arg *)argument;
-	obexftp_client_t *cli = *(ftp_timer->client);
-//	uint timeout = ftp_timer->timeout;
-//	uint8_t count = 0;
-	int led_org = ftp_timer->led_org;
-	struct timespec timer;
-	int error;
-
-	while (1) {
-		clock_gettime(CLOCK_REALTIME, &timer);
-  		timer.tv_sec += ftp_timer->timeout;
-//		printf("Start Timer\n");
-		if(sem_timedwait(&ftp_timer->stop_timer, &timer) < 0) {
-			error = errno;
-			if(error == ETIMEDOUT) {
-				printf("Timeout! Release BT connection\n");
-				ReleasBTConnection(cli);
-				*(ftp_timer->client) = NULL;
-				break;
-			}
-		} else {
-			if(ftp_timer->timer_exit) {
-//				printf("Terminate Timer\n");
-				break;
-			} else {
-//				printf("Stop Timer\n");
-				sem_wait(&ftp_timer->start_timer);
-			}
-		}
-/*		if (count >= timeout) {
-			printf("Timeout! Release BT connection\n");
-			ReleasBTConnection(cli);
-			*(ftp_timer->client) = NULL;
-			break;
-		}
-		
-		if(ftp_timer->count_down) {
-//			if(!(count%10)) printf("Start Timer %d.\n", count);
-			count += 1;
-		} else {
-//			printf("Stop Timer\n");
-			count = 0;
-		}
-		
-		sleep(ONE_SECOND);
-*/	}
-	
-	SetBTLed(led_org);
-//	printf("Exit From %s\n", __FUNCTION__);
-	pthread_exit(NULL);
+// re-start the inactivity timer once the FTP command is done.
+static void ObexTimerRelease(timer_arg *ftp_timer, obexftp_client_t *cli, const uint inactive_timeout) {
+	if(cli)
+		TimerStart(&ftp_timer->timer, inactive_timeout*ONE_SECOND);
 }
 
 /*********************************************************************** 
@@ -253,6 +269,48 @@ static void Int2String(int value, char *p) {
 }
 
 /* connect with given uuid. re-connect every time */
+/*********************************************************************** 
+* Description:
+* OBEX CONNECT on an already connected socket. obexftp only knows how to
+* connect its own transports, so the FD transport is set up here and the
+* CONNECT is sent like any other request. The Connection ID of the response
+* is picked up by the obexftp client.
+* 
+* Calling Arguments: 
+* Name			Description 
+* cli		pointer to contain the connection infomation
+* uuid		the target uuid
+* uuid_len	the length of the uuid
+*
+* Return Value: 
+* >= 0: success
+* < 0: error
+******************************************************************************/
+static int CliConnectFd(obexftp_client_t *cli, const uint8_t *uuid, int uuid_len)
+{
+	obex_object_t *object;
+	obex_headerdata_t hv;
+	int res;
+
+	if (obex_link.fd < 0)
+		return -EINVAL;
+
+	// only once, the retries reuse the transport
+	if (OBEX_GetFD(cli->obexhandle) < 0 && FdOBEX_TransportSetup(cli->obexhandle, obex_link.fd, obex_link.fd, 0) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s FdOBEX_TransportSetup() fd %d failed\n", __FUNCTION__, obex_link.fd);
+		return -ENOTCONN;
+	}
+
+	if ((object = OBEX_ObjectNew(cli->obexhandle, OBEX_CMD_CONNECT)) == NULL)
+		return -ENOMEM;
+	hv.bs = uuid;
+	(void) OBEX_ObjectAddHeader(cli->obexhandle, object, OBEX_HDR_TARGET, hv, uuid_len, OBEX_FL_FIT_ONE_PACKET);
+
+	cli->finished = 1;
+	res = SendObexRequest(cli, object);
+	return (res > 0) ? 0 : -1;
+}
+
 /*********************************************************************** 
 * Description:
 * connect to the device with the given uuid
@@ -276,7 +334,7 @@ static int cli_connect_uuid(const char *device, const int channel, unsigned char
 	obexftp_client_t *cli = NULL;
 
 	/* Open */
-	cli = obexftp_open (OBEX_TRANS_BLUETOOTH, NULL, NULL, NULL);
+	cli = obexftp_open (obex_link.type, NULL, ObexInfoCallback, NULL);
 	if(cli == NULL) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s Error: obexftp_open() Failed\n", __FUNCTION__);
 		fprintf(stderr, "Error opening obexftp-client\n");
@@ -286,7 +344,13 @@ static int cli_connect_uuid(const char *device, const int channel, unsigned char
 
 	for (retry = 0; retry < 3; retry++) {
 		/* Connect */
-		if ((res = obexftp_connect_uuid (cli, device, channel, uuid, uuid_len)) >= 0) {
+		if (obex_link.type == OBEX_TRANS_FD)
+			res = CliConnectFd(cli, uuid, uuid_len);
+		else if (obex_link.type == OBEX_TRANS_INET)
+			res = obexftp_connect_uuid (cli, obex_link.host, obex_link.port, uuid, uuid_len);
+		else
+			res = obexftp_connect_uuid (cli, device, channel, uuid, uuid_len);
+		if (res >= 0) {
 			*client = (unsigned char *)cli;
 			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s obexftp_connect_uuid done and success\n", __FUNCTION__);
        		return 1;
@@ -323,9 +387,13 @@ static int CliConnect(const char *device, const int channel, unsigned char **cli
 	const uint8_t *use_uuid = UUID_FBS;
 	int use_uuid_len = sizeof(UUID_FBS);
 
-	if (!cli_connect_uuid(device, channel, client, use_uuid, use_uuid_len))
+	// no inquiry in the background while the link is up, till CliDisconnect()
+	DiscoveryPause();
+	if (!cli_connect_uuid(device, channel, client, use_uuid, use_uuid_len)) {
 //	if (!cli_connect_uuid(device, channel, client))	
+		DiscoveryResume();
 		return -1;
+	}
 
 	return 1;
 }
@@ -351,12 +419,14 @@ static void CliDisconnect(obexftp_client_t *cli)
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: obexftp_disconnect() returns %d\n", __FUNCTION__, res);
 		/* Close */
 		obexftp_close (cli);
+		DiscoveryResume();
 	}
 }
 
 //static obex_object_t *ObexBuildGet (obex_t obex, uint32_t conn, const uint8_t *name, const char *type)
-static obex_object_t *ObexBuildGet (obex_t *obex, uint32_t conn, const uint8_t *name, const char *type)
+static obex_object_t *ObexBuildGet (obexftp_client_t *cli, uint32_t conn, const uint8_t *name, const char *type)
 {
+	obex_t *obex = cli->obexhandle;
 	obex_object_t *object = NULL;
         uint8_t *ucname;
         int ucname_len;
@@ -375,7 +445,7 @@ static obex_object_t *ObexBuildGet (obex_t *obex, uint32_t conn, const uint8_t *
  
 	if (name != NULL) {
 		ucname_len = strlen((char *)name)*2 + 2;
-		ucname = malloc(ucname_len);
+		ucname = CliAlloc(cli, ucname_len);
 		if(ucname == NULL) {
 	                (void) OBEX_ObjectDelete(obex, object);
 		        return NULL;
@@ -384,7 +454,7 @@ static obex_object_t *ObexBuildGet (obex_t *obex, uint32_t conn, const uint8_t *
 		ucname_len = OBEX_CharToUnicode(ucname, name, ucname_len);
 
 		(void) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_NAME, (obex_headerdata_t) (const uint8_t *) ucname, ucname_len, OBEX_FL_FIT_ONE_PACKET);
-		free(ucname);
+		CliFree(cli, ucname);
 	}
 	
 	return object;
@@ -392,14 +462,17 @@ static obex_object_t *ObexBuildGet (obex_t *obex, uint32_t conn, const uint8_t *
 
 /*********************************************************************** 
 * Description:
-* Create an OBEX object according to the given device information
+* Create an OBEX object according to the given device information. The
+* Length header is only 32 bits, it's left out for a file of 4GB or more
+* and for a size unknown in advance.
 *
 * Return Value: 
 * obex_object_t 	pointer to the obex_object
 ******************************************************************************/
 //static obex_object_t *ObexBuildObj (obex_t obex, uint32_t conn, const char *name, const int size)
-static obex_object_t *ObexBuildObj (obex_t *obex, uint32_t conn, const char *name, const int size)
+static obex_object_t *ObexBuildObj (obexftp_client_t *cli, uint32_t conn, const char *name, const unsigned long long size)
 {
+	obex_t *obex = cli->obexhandle;
 	obex_object_t *object = NULL;
 	uint8_t *ucname;
 	int ucname_len;
@@ -412,7 +485,7 @@ static obex_object_t *ObexBuildObj (obex_t *obex, uint32_t conn, const char *nam
 		(void) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_CONNECTION, (obex_headerdata_t) conn, sizeof(uint32_t), OBEX_FL_FIT_ONE_PACKET);
 
 	ucname_len = strlen(name)*2 + 2;
-	ucname = malloc(ucname_len);
+	ucname = CliAlloc(cli, ucname_len);
 	if(ucname == NULL) {
        	(void) OBEX_ObjectDelete(obex, object);
 		return NULL;
@@ -421,10 +494,10 @@ static obex_object_t *ObexBuildObj (obex_t *obex, uint32_t conn, const char *nam
 	ucname_len = OBEX_CharToUnicode(ucname, (uint8_t *)name, ucname_len);
 
 	(void ) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_NAME, (obex_headerdata_t) (const uint8_t *) ucname, ucname_len, 0);
-	free(ucname);
+	CliFree(cli, ucname);
 	
 	
-	if(size) (void) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_LENGTH, (obex_headerdata_t) (uint32_t)size, sizeof(uint32_t), 0);
+	if(size && size <= UINT32_MAX) (void) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_LENGTH, (obex_headerdata_t) (uint32_t)size, sizeof(uint32_t), 0);
 
 	
 	(void) OBEX_ObjectAddHeader(obex, object, OBEX_HDR_BODY,
@@ -437,7 +510,8 @@ static obex_object_t *ObexBuildObj (obex_t *obex, uint32_t conn, const char *nam
 #define REMOTE_FILENAME_LENGTH	512
 static obex_object_t *CreateObexObj_PUT(obexftp_client_t *cli, const char *filename, const int method) {
 	obex_object_t *object;
-	int fd, file_size = 0, cur_pos;
+	unsigned long long file_size = 0;
+	struct stat st;
 	char remotename[REMOTE_FILENAME_LENGTH] = {};
 	char *psplit = NULL;
 	
@@ -449,11 +523,9 @@ static obex_object_t *CreateObexObj_PUT(obexftp_client_t *cli, const char *filen
 	}
 	
 	if(method == FTPFROMFILE) {
-		if((fd = open(filename, O_RDONLY)) < 0)
+		if(stat(filename, &st) < 0)
 			return NULL;
-		cur_pos = lseek(fd, 0, SEEK_CUR);
-		file_size = lseek(fd, 0, SEEK_END);
-		lseek(fd, cur_pos, SEEK_SET);
+		file_size = st.st_size;
 	}
 	psplit = strrchr(filename, '/');
 	if(psplit)
@@ -461,7 +533,7 @@ static obex_object_t *CreateObexObj_PUT(obexftp_client_t *cli, const char *filen
 	else
 		snprintf(remotename, sizeof(remotename), "%s", filename);
 	
-	object = ObexBuildObj(cli->obexhandle, cli->connection_id, remotename, file_size);
+	object = ObexBuildObj(cli, cli->connection_id, remotename, file_size);
 	
 	return object;
 }
@@ -475,65 +547,117 @@ static obex_object_t *CreateObexObj_DIR(obexftp_client_t *cli) {
 		return NULL;
 	
 	cli->infocb(OBEXFTP_EV_SENDING, NULL, 0, cli->infocb_data);
-	object = ObexBuildGet(cli->obexhandle, cli->connection_id, NULL, XOBEX_LISTING);
+	object = ObexBuildGet(cli, cli->connection_id, NULL, XOBEX_LISTING);
 	return object;
 }
 
 /*********************************************************************** 
 * Description:
-* create the socket for the MRx specified ftp connection.
+* set the PUT to read its data from the MRx socket. The MRx stream is
+* pumped into a pipe, and obexftp reads the other end of the pipe as a
+* file (only "fd" is set).
 *
 * Calling Arguments: 
 * Name			Description 
 * cli		pointer to contain the connection infomation
-* sockfd	socket id used to transfer the information between the bluetooth devices.
+* sockfd		the MRx socket
 *
 * Return Value: 
-* -1: error
 * 0: success
+* -1: fail
 ******************************************************************************/
 static int ObexftpfromSocket(obexftp_client_t *cli, const int sockfd)
 {
-	uint8_t *fd = (uint8_t *)malloc(sizeof(uint8_t));
-	if(fd == NULL) {
+	ftp_ctx *ctx = (ftp_ctx *)cli->infocb_data;
+	mrx_stream *stream;
+
+	if(ctx == NULL) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - no FTP session\n", __FUNCTION__);
+		return -1;
+	}
+
+	stream = (mrx_stream *)ArenaAlloc(&ctx->arena, sizeof(mrx_stream));
+	if(stream == NULL) {
 		printf("%s: malloc failed\n", __FUNCTION__);
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - malloc() failed\n", __FUNCTION__);
 		return -1;
 	}
-// if only the "fd" is set, then the api called is cli_fillstream_from_file;
-// if only the "out_data" is set, then the api called is cli_fillstream_from_memory;
-// if both the "fd" and "out_data" are set and equal to each other, then the api called is cli_fillstream_from_socket;
-	cli->fd = sockfd;
-	
-	cli->out_data = fd;
-	*fd = (uint8_t)sockfd;
-/*	printf("cli->outdata(%p) %d %d %d %d\n",cli->out_data,
-								*cli->out_data, 
-								*(cli->out_data+1),
-								*(cli->out_data+2),
-								*(cli->out_data+3));
-*/
+	memset(stream, 0, sizeof(mrx_stream));
+	stream->sockfd = sockfd;
+	stream->buf_size = BudgetGet()->chunk;
+	if((stream->buf = (char *)ArenaAlloc(&ctx->arena, stream->buf_size)) == NULL || pipe(stream->pipefd) < 0) {
+		perror("ObexftpfromSocket: pipe() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pipe() failed\n", __FUNCTION__);
+		return -1;
+	}
+
+	// obexftp reads a whole OBEX packet from the pipe in one go, the pipe must hold a packet at the largest MTU
+	fcntl(stream->pipefd[1], F_SETPIPE_SZ, BudgetGet()->ring);
+	if((stream->pipe_size = fcntl(stream->pipefd[1], F_GETPIPE_SZ)) < MRX_PIPE_FILL + MRX_PIPE_SLACK) {
+		printf("%s: the pipe can't hold %d bytes\n", __FUNCTION__, MRX_PIPE_FILL);
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pipe of %d bytes, %d needed\n", __FUNCTION__, stream->pipe_size, MRX_PIPE_FILL + MRX_PIPE_SLACK);
+		close(stream->pipefd[0]);
+		close(stream->pipefd[1]);
+		return -1;
+	}
+	stream->fill = MRX_PIPE_FILL;
+
+	cli->fd = stream->pipefd[0];
+	cli->out_data = NULL;
+	ctx->stream = stream;
+
 	cache_purge(&cli->cache, NULL);
 
 	return 0;
 }
 
-static int ObexftpfromFile(obexftp_client_t *cli, const char *filename)
+/*********************************************************************** 
+* Description:
+* set the PUT to read its data from a local file. obexftp read()s the
+* descriptor packet by packet with the sequential readahead started now.
+* The file isn't mapped: a file truncated while it's sent must end the PUT
+* with an error, not with a SIGBUS of the daemon.
+*
+* Calling Arguments: 
+* Name			Description 
+* cli		pointer to contain the connection infomation
+* filename	the local file
+* size		store the size of the file when the PUT starts
+*
+* Return Value: 
+* 0: success
+* -1: fail
+******************************************************************************/
+static int ObexftpfromFile(obexftp_client_t *cli, const char *filename, off_t *size)
 {
 // if only the "fd" is set, then the api called is cli_fillstream_from_file;
 // if only the "out_data" is set, then the api called is cli_fillstream_from_memory;
 // if both the "fd" and "out_data" are set and equal to each other, then the api called is cli_fillstream_from_socket;
-	if((cli->fd = open(filename, O_RDONLY, 0))<= 0) {
+	struct stat st;
+	int fd;
+
+	if((fd = open(filename, O_RDONLY | O_LARGEFILE, 0)) < 0) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - open() failed %s\n", __FUNCTION__, strerror(errno));
 		return -1;
 	}
-	
-	cli->out_data = NULL;
+	*size = (fstat(fd, &st) == 0) ? st.st_size : 0;
 
 	cache_purge(&cli->cache, NULL);
 
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);	// start the readahead now
+	cli->fd = fd;
+	cli->out_data = NULL;
+
 	return 0;
 }
+
+// close the file given by ObexftpfromFile() if obexftp didn't read it to the end
+static void ReleaseObexftpFile(obexftp_client_t *cli) {
+	if(cli->fd >= 0)
+		close(cli->fd);
+	cli->fd = -1;
+}
 /*********************************************************************** 
 * Description:
 * release the created Obexftp connection.
@@ -546,152 +670,538 @@ static int ObexftpfromFile(obexftp_client_t *cli, const char *filename)
 * none	
 ******************************************************************************/
 static void ReleaseObexftpSocket(obexftp_client_t *cli) {
-	uint8_t *fd = (uint8_t *)cli->out_data;
+	ftp_ctx *ctx = (ftp_ctx *)cli->infocb_data;
+	mrx_stream *stream = ctx ? ctx->stream : NULL;
 
-	cli->out_data = NULL;
-	free(fd);
-}
+	if(stream == NULL)
+		return;
 
+	if(!stream->eof)
+		close(stream->pipefd[1]);
+	close(stream->pipefd[0]);
+	// stream and its buffer are in the session arena
+	ctx->stream = NULL;
+	cli->fd = -1;
+}
 
-/*
- * Function AbortCmd()
- *
- *    Abort an ongoing request
- *
- */
-static int AbortCmd(obex_t *self)
-{
-	OBEX_CancelRequest(self, 1);	
+// receive exactly leng bytes from the MRx
+static int MrxRecvAll(const int sockfd, char *buf, const int leng, unsigned long long *first_us) {
+	int rd_sz, total = 0;
 
-	return 1;	
+	while(total < leng) {
+		if((rd_sz = recv(sockfd, buf+total, leng-total, 0)) <= 0) {
+			if(rd_sz < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(!total && first_us)
+			*first_us = StatsNow();
+		total += rd_sz;
+	}
+	return total;
 }
 
-// 1: abort received
-// 0: no abort received
-static void *RecvAbort(void *para) {
-	char cmd_string[64];
-	char up_cmd[64];
-	int cmd_leng;
-	int res, cmd, ret = 0;
-	dir_arg *arg = (dir_arg *)para;
-	int sockfd = arg->sockfd;
-	obexftp_client_t *cli = arg->client;
-	fd_set read_set;
-	struct timeval timeout;
-	
-	printf("%s: Only ABORT is allowed\n", __FUNCTION__);
-	
-	while(1) {
-		FD_ZERO(&read_set);
-		FD_SET(sockfd, &read_set);
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 100000;
-	
-		if((res = select(FD_SETSIZE, &read_set, NULL, NULL, &timeout))< 0) {
-			perror("RecvAbort(): select()");
-			break;
-		} else if (res > 0) {
-			if (FD_ISSET(sockfd, &read_set)) {
-				memset(cmd_string, 0, sizeof(cmd_string));
-				read(sockfd, cmd_string, sizeof(cmd_string));
-		
-				// get rid of '\n'
-				if ((cmd_leng = strlen(cmd_string)) > 0) {
-					cmd_leng--;
-					if (cmd_string[cmd_leng] == '\n')  cmd_string[cmd_leng] = '\0';
-				}
-				
-				memset(up_cmd, 0, (cmd_leng+1)*sizeof(char));
-				String2Upper(up_cmd, cmd_string);
-				cmd = GetFTPCMD(up_cmd, NULL, NULL);
-				if(cmd == BT_FTP_ABORT) {
-					printf("Calling AbortCmd\n");
-					if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - Calling AbortCmd\n", __FUNCTION__);
-					AbortCmd(cli->obexhandle);
-					ret = 1;
-					break;
-				} else 
-					printf("Error: only ABORT is accepted within the FTP DIR -RAW\n");
-			}
-		} else {
-			if (arg->thread_exit)
+// receive the line sent by the MRx ahead of a data chunk
+static int MrxRecvLine(const int sockfd, char *line, const int leng) {
+	int pos = 0;
+	char c;
+
+	while(pos < leng - 1) {
+		if(MrxRecvAll(sockfd, &c, 1, NULL) < 0)
+			return -1;
+		if(c == '\r' || c == '\n') {
+			if(pos)
 				break;
+			continue;
 		}
+		line[pos++] = c;
 	}
-	
-//	printf("%s: return\n", __FUNCTION__);
-// 	change dir to the current dir in order to solve the put failure issue after the abort.
-	pthread_exit ((void *)ret);
+	line[pos] = '\0';
+	return pos;
+}
+
+static void MrxStreamEnd(mrx_stream *stream) {
+	if(!stream->eof) {
+		close(stream->pipefd[1]);
+		stream->eof = 1;
+	}
+}
+
+/*********************************************************************** 
+* Description:
+* start the next data chunk of the MRx:
+*	MRx: <length>, daemon: "?", MRx: <data>, daemon: "!"
+* a length of 0 ends the file. ABORT or ATH instead of the length fires the
+* cancellation token of the session. The data itself is pumped by
+* MrxStreamPiece(), as far as the pipe has room for it.
+*
+* Calling Arguments: 
+* Name			Description 
+* ctx		the FTP session
+*
+* Return Value: 
+* >0: bytes of the chunk
+* 0: end of the file
+* -1: the stream failed or is cancelled
+******************************************************************************/
+static int MrxStreamHead(ftp_ctx *ctx) {
+	mrx_stream *stream = ctx->stream;
+	xfer_stats *stats = ctx->stats;
+	char line[MRX_LENG_SIZE] = {};
+	char up_line[MRX_LENG_SIZE] = {};
+	unsigned long long start;
+	int leng;
+
+	start = StatsNow();
+	if(MrxRecvLine(stream->sockfd, line, sizeof(line)) <= 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: MRx socket closed\n", __FUNCTION__);
+		CancelFire(&ctx->cancel, BT_FTP_HANG);
+		goto fail;
+	}
+
+	if(strspn(line, "0123456789") != strlen(line)) {
+		String2Upper(up_line, line);
+		if(!strncmp(up_line, "ABORT", strlen("ABORT")))
+			CancelFire(&ctx->cancel, BT_FTP_ABORT);
+		else if(!strcmp(up_line, "ATH"))
+			CancelFire(&ctx->cancel, BT_FTP_HANG);
+		else
+			printf("%s: invalid data length %s\n", __FUNCTION__, line);
+		goto fail;
+	}
+
+	if((leng = atoi(line)) == 0) {
+		if(stats) stats->mrx_us += StatsNow() - start;
+		MrxStreamEnd(stream);
+		return 0;
+	}
+	if(leng < 0) {
+		printf("%s: invalid data length %s\n", __FUNCTION__, line);
+		goto fail;
+	}
+
+	SendResponse(stream->sockfd, "?");
+	stream->ask = StatsNow();
+	stream->leng = stream->left = leng;
+	if(stats) stats->mrx_us += stream->ask - start;
+	return leng;
+
+fail:
+	MrxStreamEnd(stream);
+	return -1;
+}
+
+/*********************************************************************** 
+* Description:
+* pump the next piece of the current MRx chunk into the pipe, no more
+* than room bytes so the write never blocks. The "!" is answered once the
+* whole chunk is in the pipe.
+*
+* Calling Arguments: 
+* Name			Description 
+* ctx		the FTP session
+* room		free space of the pipe
+*
+* Return Value: 
+* >0: bytes of the piece
+* -1: the stream failed or is cancelled
+******************************************************************************/
+static int MrxStreamPiece(ftp_ctx *ctx, const int room) {
+	mrx_stream *stream = ctx->stream;
+	xfer_stats *stats = ctx->stats;
+	unsigned long long start, first = 0;
+	int piece = stream->left;
+
+	if(piece > stream->buf_size)
+		piece = stream->buf_size;
+	if(piece > room)
+		piece = room;
+
+	start = StatsNow();
+	if(MrxRecvAll(stream->sockfd, stream->buf, piece, (stream->left == stream->leng) ? &first : NULL) < 0) {
+		CancelFire(&ctx->cancel, BT_FTP_HANG);
+		MrxStreamEnd(stream);
+		return -1;
+	}
+	if(stats) {
+		stats->mrx_us += StatsNow() - start;
+		stats->bytes += piece;
+		if(first)
+			StatsAddRtt(stats, first - stream->ask);
+	}
+	// inline, while the piece is still hot in the cache
+	DigestUpdate(ctx->digest, stream->buf, piece);
+
+	if(write(stream->pipefd[1], stream->buf, piece) != piece) {
+		perror("MrxStreamPiece: write() failed");
+		MrxStreamEnd(stream);
+		return -1;
+	}
+
+	if(!(stream->left -= piece)) {
+		SendResponse(stream->sockfd, "!");
+		LedDataActivity(stream->leng);
+	}
+	return piece;
+}
+
+/*********************************************************************** 
+* Description:
+* make sure obexftp finds a whole OBEX packet of data, or the end of the
+* file, in the pipe before the OBEX layer runs. openobex reads the pipe on
+* this thread until its packet is full, so a read that found the pipe
+* short would wait for a pump that never runs.
+*
+* Calling Arguments: 
+* Name			Description 
+* ctx		the FTP session
+*
+* Return Value: 
+* 0: success
+* -1: the stream failed or is cancelled
+******************************************************************************/
+static int MrxStreamFill(ftp_ctx *ctx) {
+	mrx_stream *stream = ctx->stream;
+	int avail = 0;
+
+	while(!stream->eof) {
+		if(ioctl(stream->pipefd[0], FIONREAD, &avail) < 0 || avail >= stream->fill)
+			break;
+		if(!stream->left) {
+			if(MrxStreamHead(ctx) < 0)
+				return -1;
+		} else if(MrxStreamPiece(ctx, stream->pipe_size - MRX_PIPE_SLACK - avail) < 0)	// the pipe counts pages, not bytes
+			return -1;
+	}
+	return 0;
+}
+
+
+/*********************************************************************** 
+* Description:
+* create the cancellation token of a FTP session.
+*
+* Calling Arguments: 
+* Name			Description 
+* cancel		the token
+*
+* Return Value: 
+* 0: success
+* -1: fail
+******************************************************************************/
+static int CancelInit(ftp_cancel *cancel) {
+	memset(cancel, 0, sizeof(ftp_cancel));
+	cancel->watch_fd = -1;
+	if((cancel->efd = eventfd(0, EFD_NONBLOCK)) < 0) {
+		perror("CancelInit: eventfd() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s eventfd() -- %s\n", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static void CancelClose(ftp_cancel *cancel) {
+	if(cancel->efd >= 0)
+		close(cancel->efd);
+	cancel->efd = -1;
+}
+
+/*********************************************************************** 
+* Description:
+* fire the cancellation token. Safe to be called from any thread, the
+* request in progress is cancelled by the thread running ObexftpSync.
+*
+* Calling Arguments: 
+* Name			Description 
+* cancel		the token
+* cause		BT_FTP_ABORT, BT_FTP_HANG or FTP_IDLE_TIMEOUT
+*
+* Return Value: 
+* none
+******************************************************************************/
+static void CancelFire(ftp_cancel *cancel, const int cause) {
+	uint64_t one = 1;
+
+	if(!cancel->cause)
+		cancel->cause = cause;
+	write(cancel->efd, &one, sizeof(one));
+}
+
+// prepare the token for the next request, watch_fd is the MRx socket or -1
+static void CancelArm(ftp_cancel *cancel, const int watch_fd, const int watch_cmd) {
+	uint64_t cnt;
+
+	read(cancel->efd, &cnt, sizeof(cnt));
+	cancel->cause = 0;
+	cancel->watch_fd = watch_fd;
+	cancel->watch_cmd = watch_cmd;
+}
+
+/*********************************************************************** 
+* Description:
+* read the MRx command received while a request is in progress. Only
+* ABORT and ATH are accepted, and a closed socket is taken as ATH.
+*
+* Calling Arguments: 
+* Name			Description 
+* cancel		the token
+*
+* Return Value: 
+* none
+******************************************************************************/
+static void CancelRecvCmd(ftp_cancel *cancel) {
+	char arg[FTP_ARG_BUFF_SIZE] = {};
+	int cmd = RecvCmd(cancel->watch_fd, arg, 1);
+
+	if(cmd <= 0)
+		CancelFire(cancel, BT_FTP_HANG);
+	else if(cmd == BT_FTP_ABORT || cmd == BT_FTP_HANG)
+		CancelFire(cancel, cmd);
+	else
+		printf("Error: only ABORT and ATH are accepted within a FTP request\n");
+}
+
+/*
+ OBEX request run by the poll() loop of the session thread, which waits for
+ its done callback in ObexftpSync().
+*/
+typedef struct obex_request obex_req;
+typedef void (*obex_done_cb)(obexftp_client_t *cli, const int res, void *arg);
+
+struct obex_request {
+	event_loop_t *loop;
+	obexftp_client_t *cli;
+	int fd;
+	obex_done_cb done;
+	void *arg;
+	xfer_stats *stats;		// the transfer being measured, NULL otherwise
+	unsigned long long wait_start;	// StatsNow() of the last packet sent
+};
+
+typedef struct obex_sync_arg {
+	obexftp_client_t *cli;
+	ftp_cancel *cancel;
+	obex_req *req;
+	event_loop_t loop;
+	int cancelling;
+	int done;
+	int res;
+} obex_sync;
+
+static void ObexRequestDone(obex_req *req, const int res) {
+	obexftp_client_t *cli = req->cli;
+
+	EventDel(req->loop, req->fd);
+	req->done(cli, res, req->arg);
+	CliFree(cli, req);
+}
+
+// the OBEX connection is readable, let the OBEX layer process the packet.
+static void ObexRequestInput(int fd, short revents, void *arg) {
+	obex_req *req = (obex_req *)arg;
+	ftp_ctx *ctx = (ftp_ctx *)req->cli->infocb_data;
+	int ret;
+
+	// from the packet sent to the response of the peer, poll() included
+	if(req->stats) {
+		req->stats->obex_us += StatsNow() - req->wait_start;
+		req->stats->packets++;
+	}
+
+	if(ctx && ctx->stream) {
+		// the cancelled PUT must not end on the partial data, leave it to the cancel
+		if(MrxStreamFill(ctx) < 0 && ctx->cancel.cause)
+			return;
+	}
+
+	ret = OBEX_HandleInput(req->cli->obexhandle, 0);
+	if(req->stats)
+		req->wait_start = StatsNow();
+
+	if (ret <= 0) {
+		printf("%s() OBEX_HandleInput = %d\n", __func__, ret);
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OBEX_HandleInput returns ret = %d\n", __FUNCTION__, ret);
+		ObexRequestDone(req, -1);
+	} else if (req->cli->finished)
+		ObexRequestDone(req, req->cli->success ? 1 : 0);
 }
+
 /*********************************************************************** 
 * Description:
-* send the request of the obex synchronization.
+* send the request without waiting for its completion. The OBEX connection
+* is watched by the given event loop, and the done callback is called from
+* the loop once the request is finished.
 *
 * Calling Arguments: 
 * Name			Description 
+* loop		the event loop
 * cli		pointer to contain the connection infomation
+* object		the OBEX request
+* done		completion callback, res is 1: success, 0: fail, -1: error
+* arg		argument given to the callback
+*
+* Return Value: 
+* the request, valid until the done callback returns
+* NULL: fail
+******************************************************************************/
+static obex_req *ObexRequestStart(event_loop_t *loop, obexftp_client_t *cli, obex_object_t *object, obex_done_cb done, void *arg) {
+	obex_req *req;
+
+	if (!cli->finished) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: cli->finished %d\n", __FUNCTION__, cli->finished);
+		return NULL;
+	}
+
+	if((req = (obex_req *)CliAlloc(cli, sizeof(obex_req))) == NULL) {
+		perror("ObexRequestStart: malloc() failed");
+		return NULL;
+	}
+	req->loop = loop;
+	req->cli = cli;
+	req->fd = OBEX_GetFD(cli->obexhandle);
+	req->done = done;
+	req->arg = arg;
+	req->stats = CliStats(cli);
+	if(EventAdd(loop, req->fd, POLLIN, ObexRequestInput, req) < 0) {
+		CliFree(cli, req);
+		return NULL;
+	}
+
+	cli->finished = 0;
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: calling OBEX_Request\n", __FUNCTION__);
+	(void) OBEX_Request(cli->obexhandle, object);
+	req->wait_start = StatsNow();
+
+	return req;
+}
+
+/*********************************************************************** 
+* Description:
+* cancel the request in progress. An OBEX ABORT is sent to the remote
+* device, and the request completes as failed on the ABORT response.
+*
+* Calling Arguments: 
+* Name			Description 
+* req		the request
+*
+* Return Value: 
+* none
+******************************************************************************/
+static void ObexRequestCancel(obex_req *req) {
+	printf("Cancel the OBEX request\n");
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: Calling OBEX_CancelRequest\n", __FUNCTION__);
+	OBEX_CancelRequest(req->cli->obexhandle, 1);
+}
+
+static void ObexSyncDone(obexftp_client_t *cli, const int res, void *arg) {
+	obex_sync *sync = (obex_sync *)arg;
+
+	sync->done = 1;
+	sync->res = res;
+	EventLoopStop(&sync->loop);
+}
+
+// the cancellation token is fired, stop the loop to wait for the ABORT response only.
+static void ObexSyncCancel(int fd, short revents, void *arg) {
+	obex_sync *sync = (obex_sync *)arg;
+
+	EventDel(&sync->loop, fd);
+	if(sync->cancel->watch_fd >= 0)
+		EventDel(&sync->loop, sync->cancel->watch_fd);
+	sync->cancelling = 1;
+	ObexRequestCancel(sync->req);
+	EventLoopStop(&sync->loop);
+}
+
+static void ObexSyncWatch(int fd, short revents, void *arg) {
+	obex_sync *sync = (obex_sync *)arg;
+
+	if(revents & (POLLRDHUP | POLLHUP | POLLERR))
+		CancelFire(sync->cancel, BT_FTP_HANG);
+	else
+		CancelRecvCmd(sync->cancel);
+}
+
+/*********************************************************************** 
+* Description:
+* wait for the completion of the request. The OBEX connection, the
+* cancellation token and the MRx socket are all watched by the poll()
+* loop of this request, so a cancel is handled as soon as it is fired.
+*
+* Calling Arguments: 
+* Name			Description 
+* sync		the request being waited for
 *
 * Return Value: 
 * 1: success
+* 0: fail or cancelled
 * < 0: faile
 ******************************************************************************/
-static int ObexftpSync(obexftp_client_t *cli)
+static int ObexftpSync(obex_sync *sync)
 {
+	obexftp_client_t *cli = sync->cli;
+	struct pollfd pfd;
 	int ret;
-	
-	while(!cli->finished) {
-		ret = OBEX_HandleInput(cli->obexhandle, 20);
-		
-		if (ret <= 0) {
-			printf("%s() OBEX_HandleInput = %d\n", __func__, ret);
-			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OBEX_HandleInput returns ret = %d\n", __FUNCTION__, ret);
-			return -1;
+
+	while(!sync->done) {
+		ret = EventLoopRun(&sync->loop, sync->cancelling ? OBEX_CANCEL_TIMEOUT*ONE_SECOND : OBEX_SYNC_TIMEOUT*ONE_SECOND);
+		if(ret == EVENT_STOP)
+			continue;
+
+		if(sync->cancelling) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: no ABORT response, cancel the request locally\n", __FUNCTION__);
+			OBEX_CancelRequest(cli->obexhandle, 0);
+			cli->finished = 1;
+		} else {
+			printf("%s() OBEX request timeout\n", __func__);
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OBEX request timeout\n", __FUNCTION__);
 		}
+		ObexRequestDone(sync->req, -1);
 	}
 
-//	printf("%s() Done success=%d\n", __func__, cli->success);
-//	printf("%s() Finished=%d\n", __func__, cli->finished);  
-	if(cli->success)
-		return 1;
-	else
-		return 0;
+	if(!sync->cancelling)
+		return sync->res;
+
+	// drain what's left of the cancelled request, so the next one starts on a clean connection
+	pfd.fd = OBEX_GetFD(cli->obexhandle);
+	pfd.events = POLLIN;
+	while(poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+		if(OBEX_HandleInput(cli->obexhandle, 0) <= 0)
+			break;
+	}
+	cli->success = 0;
+	return 0;
 }
 
 static int SendObexRequest(obexftp_client_t *cli, obex_object_t *object) {
-	int res;
-	int led_thread_exit = 0;
-	pthread_t led_thread_id;
+	return SendObexRequestStats(cli, object, CliStats(cli));
+}
+
+// the request measured into stats, a client without FTP session included
+static int SendObexRequestStats(obexftp_client_t *cli, obex_object_t *object, xfer_stats *stats) {
+	obex_sync sync;
+	ftp_cancel *cancel = CliCancel(cli);
 	
 	if (!cli->finished) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: cli->finished %d\n", __FUNCTION__, cli->finished);
 		return -EBUSY;
 	}
-	cli->finished = 0;
 
-	// create a fifo
-/*	if (!access(BT_LED_STATE_FIFO, F_OK))
-		unlink(BT_LED_STATE_FIFO);
-	
-	if(mkfifo(BT_LED_STATE_FIFO, 0777) < 0) {
-		perror("SetBTLedinDataActive: mkfifo() failed");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: mkfifo() failed.\n", __FUNCTION__);
-		return -1;
+	memset(&sync, 0, sizeof(obex_sync));
+	sync.cli = cli;
+	sync.cancel = cancel;
+	EventLoopInit(&sync.loop);
+	if(cancel) {
+		EventAdd(&sync.loop, cancel->efd, POLLIN, ObexSyncCancel, &sync);
+		if(cancel->watch_fd >= 0)
+			EventAdd(&sync.loop, cancel->watch_fd, cancel->watch_cmd ? (POLLIN | POLLRDHUP) : POLLRDHUP, ObexSyncWatch, &sync);
 	}
-	
-	pthread_create(&led_thread_id, NULL, SetBTLedinDataActive, (void *)&led_thread_exit);
-*/	
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: calling OBEX_Request\n", __FUNCTION__);
-	(void) OBEX_Request(cli->obexhandle, object);
 
-	res = ObexftpSync (cli);
-	led_thread_exit = 1;
+	if((sync.req = ObexRequestStart(&sync.loop, cli, object, ObexSyncDone, &sync)) == NULL)
+		return -1;
+	sync.req->stats = stats;
 
-/*	pthread_join(led_thread_id, NULL);
-	
-	if (!access(BT_LED_STATE_FIFO, F_OK))
-		unlink(BT_LED_STATE_FIFO);
-*/
-	return res;
+	return ObexftpSync(&sync);
 }
 
 /*********************************************************************** 
@@ -704,14 +1214,19 @@ static int SendObexRequest(obexftp_client_t *cli, obex_object_t *object) {
 * filename 	the name of the sending file
 * sockfd		the socket id of the socket being used to send the file if it's given otherwise the 
 *			file transmission will be used
+* addr		the remote device for STAT when cli has no FTP session, may be NULL
 *
 * Return Value: 
 * >=0: bytes of sending out
 * < 0: fail
 ******************************************************************************/
-int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method, const int sockfd) {
+int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method, const int sockfd, const char *addr) {
 	int res;
 	obex_object_t *obj = CreateObexObj_PUT(cli, filename, method);
+	ftp_ctx *ctx;
+	xfer_stats stats;
+	struct stat st;
+	off_t file_size = 0;
 
 	if (cli == NULL) {
 		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: cli is NULL\n", __FUNCTION__);
@@ -729,15 +1244,98 @@ int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method,
 			return -1;
 		}
 	} else if(method == FTPFROMFILE){
-		if(ObexftpfromFile(cli, filename) < 0) {
+		if(ObexftpfromFile(cli, filename, &file_size) < 0) {
 			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - set FTP from file failed.\n", __FUNCTION__);
 			return -1;
 		}
 	}
 	
-	res = SendObexRequest(cli, obj);
+	StatsReset(&stats);
+	ctx = (ftp_ctx *)cli->infocb_data;
+	if(ctx)
+		ctx->stats = &stats;
+	stats.wall_us = StatsNow();
+
+	// obexftp asks for the first data while the request is being sent
+	if(method == FTPFROMSOCKET && MrxStreamFill(ctx) < 0) {
+		OBEX_ObjectDelete(cli->obexhandle, obj);
+		ctx->stats = NULL;
+		ReleaseObexftpSocket(cli);
+		return ctx->cancel.cause ? 0 : -1;
+	}
+
+	res = SendObexRequestStats(cli, obj, &stats);
 	
+	stats.wall_us = StatsNow() - stats.wall_us;
+	// the MRx stream counts its own bytes, a file is as far as obexftp read it
+	if(method == FTPFROMFILE) {
+		if(cli->fd >= 0)
+			stats.bytes = lseek(cli->fd, 0, SEEK_CUR);
+		else if(stat(filename, &st) == 0)	// obexftp closes the file at its end
+			stats.bytes = st.st_size;
+		// obexftp takes the early end of a truncated file as the end of the body
+		if(res > 0 && stats.bytes < file_size) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - %s truncated to %llu of %llu bytes while sent\n", __FUNCTION__, filename, stats.bytes, (unsigned long long)file_size);
+			res = -1;
+		}
+	}
+	if(ctx)
+		ctx->stats = NULL;
+	StatsCommit(ctx ? ctx->addr : addr, &stats);
 	if(method == FTPFROMSOCKET) ReleaseObexftpSocket(cli);
+	if(method == FTPFROMFILE) ReleaseObexftpFile(cli);
+	return res;
+}
+
+/***********************************************************************
+* Description:
+* PUT data already in memory. The data is read by obexftp in place, several
+* clients can send the same buffer at the same time.
+*
+* Calling Arguments:
+* Name			Description
+* cli		pointer to contain the connection infomation
+* remotename	the name of the file on the remote device
+* data		the data, must stay valid until the function returns
+* size		length of the data
+* addr		the remote device, for STAT
+*
+* Return Value:
+* 1: success
+* 0: fail
+* < 0: error
+******************************************************************************/
+int FTPTransBuffer(obexftp_client_t *cli, const char *remotename, const uint8_t *data, const uint32_t size, const char *addr) {
+	obex_object_t *obj;
+	xfer_stats stats;
+	int res;
+
+	if (cli == NULL) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: cli is NULL\n", __FUNCTION__);
+		return -1;
+	}
+
+	if((obj = ObexBuildObj(cli, cli->connection_id, remotename, size)) == NULL) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - Create obex_object_t failed.\n", __FUNCTION__);
+		return -1;
+	}
+
+	cache_purge(&cli->cache, NULL);
+	cli->fd = -1;
+	cli->out_data = data;
+	cli->out_size = size;
+	cli->out_pos = 0;
+
+	StatsReset(&stats);
+	stats.wall_us = StatsNow();
+	res = SendObexRequestStats(cli, obj, &stats);
+	stats.wall_us = StatsNow() - stats.wall_us;
+	stats.bytes = cli->out_pos;
+	StatsCommit(addr, &stats);
+
+	cli->out_data = NULL;
+	cli->out_size = 0;
+	cli->out_pos = 0;
 	return res;
 }
 
@@ -759,18 +1357,17 @@ int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method,
 static int SetDir(obexftp_client_t *cli, const char *name, const int create) {
 	obex_object_t *object;
 	int res;
-	int name_leng = strlen(name)*sizeof(char);
+	int name_leng = strlen(name)*sizeof(char) + 1;
 	char token[] = "/";
 	char *ptmp = NULL;
-	char *pname = (char *)malloc(name_leng);
+	char *pname = (char *)CliAlloc(cli, name_leng);
 
 	if(!pname) {
 		printf("Error: %s(%d) malloc()\n", __FUNCTION__, __LINE__);
 		res = -1;
 		goto end;
 	}
-	memset(pname, 0, name_leng);
-	snprintf(pname, name_leng+1, "%s", name);
+	snprintf(pname, name_leng, "%s", name);
 
 	if (!strcmp(pname, "\\")) 
 		memset(pname, 0, name_leng);
@@ -794,7 +1391,7 @@ static int SetDir(obexftp_client_t *cli, const char *name, const int create) {
 		} while((ptmp = strtok(NULL, token)));
 	}
 	
-	free(pname);
+	CliFree(cli, pname);
 
 end:	
 	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s returns res = %d.\n", __FUNCTION__, res);
@@ -854,6 +1451,7 @@ int ListDir(obexftp_client_t *cli) {
 }
 
 #define LISTFOLDER_XML	"/tmp/bt_ftp_dir.xml"
+#define DIR_XML_LINE_SIZE	512
 /* if the DIR-RAW command is issued, create the "bt_ftp_dir.xml" file for storing the folder listing */
 int CreateDirXML(void) {
 	int fd = open(LISTFOLDER_XML, O_RDWR | O_CREAT | O_TRUNC);
@@ -875,47 +1473,58 @@ void DelDirXML(void) {
 }
 
 
+static void DirXMLLine(const int sockfd, const int display, const char *pline) {
+	if(!*pline)
+		return;
+	if(display == DISPLAY_DIR_XML) printf("%s\n", pline);
+	if(sockfd >= 0) SendResponse(sockfd, pline);
+}
+
+/*********************************************************************** 
+* Description:
+* send the folder listing line by line. The file is read through a fixed
+* buffer, whatever its size.
+*
+* Calling Arguments: 
+* Name			Description 
+* sockfd		the MRx socket, < 0 if none
+* display		DISPLAY_DIR_XML to print the listing
+*
+* Return Value: 
+* 1: success
+* 0: no listing
+******************************************************************************/
 int GetDirXML(const int sockfd, const int display) {
-	char *buf = NULL;
-	int file_size = 0;
-	int cur_pos;
-	int buf_len;
-	const char tok[2] = "\n";
-	char *pstring = NULL;
+	char buf[DIR_XML_LINE_SIZE];
+	int fill = 0, rd_sz;
+	char *pline, *pend;
 	
 	int fd = open(LISTFOLDER_XML, O_RDONLY);
 	if (fd < 0)
 		return 0;
 
-	cur_pos = lseek(fd, 0, SEEK_CUR);
-	file_size = lseek(fd, 0, SEEK_END);
-	lseek(fd, cur_pos, SEEK_SET);
-	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s file_size = %d\n", __FUNCTION__, LISTFOLDER_XML, file_size);
-	if (file_size > 0) {
-		file_size += 1;
-		buf = (char *)malloc(file_size*sizeof(char));
-		if (!buf) {
-			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: Error -- SendFolderListing malloc()\n", __FUNCTION__);
-			perror("SendFolderListing malloc()");
-			return 0;
+	while(1) {
+		if((rd_sz = read(fd, buf+fill, sizeof(buf)-1-fill)) > 0)
+			fill += rd_sz;
+		buf[fill] = '\0';
+		pline = buf;
+		while((pend = strchr(pline, '\n')) != NULL) {
+			*pend = '\0';
+			DirXMLLine(sockfd, display, pline);
+			pline = pend + 1;
 		}
-		memset(buf, 0, file_size*sizeof(char));
-	} else
-		return 0;
-
-	buf_len = read(fd, buf, file_size*sizeof(char));
-//	printf("file size %d\n", buf_len);
-	pstring = strtok(buf, tok);
-	if(pstring) {
-		if(display == DISPLAY_DIR_XML) printf("%s\n", pstring);
-		if(sockfd >= 0) SendResponse(sockfd, pstring);
-		while((pstring =  strtok(NULL, tok))) {
-			if(display == DISPLAY_DIR_XML) printf("%s\n", pstring);
-			if(sockfd >= 0) SendResponse(sockfd, pstring);
+		fill -= pline - buf;
+		memmove(buf, pline, fill);
+		buf[fill] = '\0';
+		// the end of the file, or a line longer than the buffer which is sent in pieces
+		if(rd_sz <= 0 || fill == sizeof(buf)-1) {
+			DirXMLLine(sockfd, display, buf);
+			fill = 0;
+			if(rd_sz <= 0)
+				break;
 		}
 	}
 
-	free(buf);
 	close(fd);
 
 	return 1;
@@ -925,36 +1534,13 @@ int GetDirXML(const int sockfd, const int display) {
 // 0: being abort;
 // -1: error
 static int GetDirContent(obexftp_client_t *cli, const int sockfd) {
-	dir_arg arg;
-	pthread_t child_thread_id;
-	void *ret;
+	ftp_cancel *cancel = CliCancel(cli);
 	int res;
 	
-	memset(&arg, 0, sizeof(dir_arg));
-	arg.sockfd = sockfd;
-	arg.client = cli;
-	arg.thread_exit = 0;
-
-	if(pthread_create(&child_thread_id, NULL, RecvAbort, (void *)&arg) < 0) {
-		perror("ListDir(): pthread_create()");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pthread_create() failed.\n", __FUNCTION__);
-		return -1;
-	}
-	
-	res = ListDir(cli);
-	arg.thread_exit = 1;
-
-	if(pthread_join(child_thread_id, &ret) < 0) {
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pthread_join() failed.\n", __FUNCTION__);
-		perror("ListDir(): pthread_join()");	
-	}
-	// if ret = 0, then no ABORT is received
-	// if ret = 1, then there is an ABORT is received.
-	
-	if ((int)ret == 1) {
-		ChangeDir(cli, ".");
+	ListDir(cli);
+	// the DIR -RAW is answered by the listing, unless it's cancelled
+	if (cancel && cancel->cause)
 		res = 0;
-	}	
 	else
 		res = 1;
 	
@@ -962,6 +1548,101 @@ static int GetDirContent(obexftp_client_t *cli, const int sockfd) {
 	return res;
 }
 
+/*********************************************************************** 
+* Description:
+* finish a cancelled FTP request. An ABORT is answered to the MRx, and an
+* ATH or a closed MRx socket releases the BT connection.
+*
+* Calling Arguments: 
+* Name			Description 
+* cli		pointer to contain the connection infomation
+* cancel		the cancellation token of the session
+* sockfd		the MRx socket
+* led_org		the LED before the session, restored on a hang up
+*
+* Return Value: 
+* 0: the FTP session goes on
+* 1: the FTP session is hung up
+******************************************************************************/
+static int CancelReply(obexftp_client_t **cli, ftp_cancel *cancel, const int sockfd, const int led_org) {
+	int cause = cancel->cause;
+
+	CancelArm(cancel, -1, 0);
+	if(cause == BT_FTP_ABORT) {
+		// change dir to the current dir in order to solve the put failure issue after the abort.
+		ChangeDir(*cli, ".");
+		SendFTPResponse(sockfd, BT_FTP_SERVICE_SUCCESS);
+		return 0;
+	}
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP session is hung up\n", __FUNCTION__);
+	ReleasBTConnection(*cli);
+	*cli = NULL;
+	SetBTLed(led_org);
+	return 1;
+}
+
+/*********************************************************************** 
+* Description:
+* select the link of the OBEX client.
+*
+* Calling Arguments: 
+* Name			Description 
+* spec		"bt", "inet:<host>[:<port>]" or "fd:<socket>"
+*
+* Return Value: 
+* 0: success
+* -1: the spec is invalid, the link is not changed
+******************************************************************************/
+int ObexSetTransport(const char *spec) {
+	char host[OBEX_HOST_LENG] = {};
+	const char *pvalue;
+	char *pport;
+	int port = OBEX_INET_PORT;
+
+	if (!strncmp(spec, OBEX_TRANSPORT_KEY_BT, strlen(OBEX_TRANSPORT_KEY_BT))) {
+		obex_link.type = OBEX_TRANS_BLUETOOTH;
+	} else if (!strncmp(spec, OBEX_TRANSPORT_KEY_INET ":", strlen(OBEX_TRANSPORT_KEY_INET ":"))) {
+		pvalue = spec + strlen(OBEX_TRANSPORT_KEY_INET ":");
+		snprintf(host, sizeof(host), "%s", pvalue);
+		host[strcspn(host, "\r\n")] = '\0';
+		if ((pport = strrchr(host, ':')) != NULL) {
+			*pport++ = '\0';
+			port = atoi(pport);
+		}
+		if (!strlen(host) || port <= 0)
+			goto invalid;
+		snprintf(obex_link.host, sizeof(obex_link.host), "%s", host);
+		obex_link.port = port;
+		obex_link.type = OBEX_TRANS_INET;
+	} else if (!strncmp(spec, OBEX_TRANSPORT_KEY_FD ":", strlen(OBEX_TRANSPORT_KEY_FD ":"))) {
+		pvalue = spec + strlen(OBEX_TRANSPORT_KEY_FD ":");
+		if (*pvalue < '0' || *pvalue > '9')
+			goto invalid;
+		obex_link.fd = atoi(pvalue);
+		obex_link.type = OBEX_TRANS_FD;
+	} else
+		goto invalid;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OBEX transport %d\n", __FUNCTION__, obex_link.type);
+	return 0;
+
+invalid:
+	printf("Invalid OBEX transport %s\n", spec);
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s invalid OBEX transport %s\n", __FUNCTION__, spec);
+	return -1;
+}
+
+// DIGEST_NONE, DIGEST_CRC32 or DIGEST_SHA256
+void ObexSetDigest(const int type) {
+	put_digest = type;
+}
+
+// 1: the OBEX client goes over Bluetooth, SDP and link keys apply
+int ObexTransportIsBT(void) {
+	return obex_link.type == OBEX_TRANS_BLUETOOTH;
+}
+
 int EstablisBTConnection(const char *device, const int channel, unsigned char **client) {
 	printf("Connecting...\n");
 	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: Connecting...\n", __FUNCTION__);
@@ -1089,6 +1770,53 @@ int SearchBTwithObex(const char *addr, int *res_channel)
 
 	return res;
 }
+/*********************************************************************** 
+* Description:
+* wait for the next FTP command of the MRx. An inactivity timeout fired
+* meanwhile releases the BT connection here, on the session thread, and
+* the session goes on waiting as the MRx still has to QUIT or hang up.
+*
+* Calling Arguments: 
+* Name			Description 
+* sockfd		the MRx socket
+* cancel		the cancellation token of the session
+* cli		the connection, set to NULL once released
+* led_org		the LED before the session
+*
+* Return Value: 
+* 1: the MRx socket is readable
+* -1: poll() failed
+******************************************************************************/
+static int ObexWaitCmd(const int sockfd, ftp_cancel *cancel, obexftp_client_t **cli, const int led_org) {
+	struct pollfd pfd[2];
+
+	while(1) {
+		pfd[0].fd = sockfd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = cancel->efd;
+		pfd[1].events = POLLIN;
+		if(poll(pfd, 2, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			perror("ObexWaitCmd: poll() failed");
+			return -1;
+		}
+
+		if(pfd[1].revents & POLLIN) {
+			if(cancel->cause == FTP_IDLE_TIMEOUT && *cli) {
+				printf("Timeout! Release BT connection\n");
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP session is inactive, release BT connection\n", __FUNCTION__);
+				ReleasBTConnection(*cli);
+				*cli = NULL;
+				SetBTLed(led_org);
+			}
+			CancelArm(cancel, -1, 0);
+		}
+		if(pfd[0].revents)
+			return 1;
+	}
+}
+
 /*********************************************************************** 
 * Description:
 * the loop of receiving FTP command from the MRx
@@ -1104,41 +1832,57 @@ int SearchBTwithObex(const char *addr, int *res_channel)
 * Note: If there is no connection for a minute, the FTP session should be quit. A DISCONNECT
 * OBEX request would be sent to the remote BT device to shut down the current connected FTP session.
 ******************************************************************************/
-int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inactive_timeout, const int led_org) {
+int StartFTPSession(const int cli_sockfd, unsigned char *client, const char *addr, const uint inactive_timeout, const int led_org) {
 	int cmd = -1;
 	int ftp_quit = 0;
 	int ftp_res;
 
 	char arg[FTP_ARG_BUFF_SIZE] = {};
 	obexftp_client_t *cli = (obexftp_client_t *)client;
-	pthread_t timer_thread_id;
 	timer_arg ftp_timer;
+	ftp_ctx ctx;
+	xfer_digest digest;
 	
+	memset(&ctx, 0, sizeof(ftp_ctx));
+	if(CancelInit(&ctx.cancel) < 0) {
+		SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_INTERNAL_SERVER_ERROR);
+		return -1;
+	}
+	ctx.addr = addr;
+	ArenaInit(&ctx.arena, BudgetGet()->session);
+	cli->infocb_data = &ctx;
+
 	printf("Start FTP session\n");
 	SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
 	printf("------------\n");
 
-	ftp_timer.timeout = inactive_timeout;	// two mins
-	ftp_timer.timer_exit = 0;
-	ftp_timer.client = &cli;
-	ftp_timer.led_org = led_org;
-	sem_init(&ftp_timer.start_timer, 0, 0);
-	sem_init(&ftp_timer.stop_timer, 0, 0);
+	ftp_timer.cancel = &ctx.cancel;
+	TimerInit(&ftp_timer.timer, ObexTimeout, (void *)&ftp_timer);
 
-	if(pthread_create(&timer_thread_id, NULL, ObexTimer, (void *)&ftp_timer) < 0) {
-		perror("StartFTPSession(): pthread_create()");
-		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pthread_create() failed.\n", __FUNCTION__);
+	if(TimerStart(&ftp_timer.timer, inactive_timeout*ONE_SECOND) < 0) {
+		perror("StartFTPSession(): TimerStart()");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - TimerStart() failed.\n", __FUNCTION__);
+		cli->infocb_data = NULL;
+		ArenaRelease(&ctx.arena);
+		CancelClose(&ctx.cancel);
 		return -1;
 	}
 	
-	while((cmd = RecvCmd(cli_sockfd, arg, 1)) > 0) {
+	while(ObexWaitCmd(cli_sockfd, &ctx.cancel, &cli, led_org) > 0 && (cmd = RecvCmd(cli_sockfd, arg, 1)) > 0) {
 		switch (cmd) {
 			case BT_FTP_CD:
 				printf("CD %s\n", arg);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - CD.\n", __FUNCTION__);
-				sem_post(&ftp_timer.stop_timer);
+				ObexTimerHold(&ftp_timer);
+				CancelArm(&ctx.cancel, cli_sockfd, 1);
 				ftp_res = ChangeDir(cli, arg);
-				sem_post(&ftp_timer.start_timer);
+				if(ctx.cancel.cause) {
+					ftp_quit = CancelReply(&cli, &ctx.cancel, cli_sockfd, led_org);
+					ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
+					break;
+				}
+				CancelArm(&ctx.cancel, -1, 0);
+				ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: ChangeDir() returns ftp_res = %d\n", __FUNCTION__, ftp_res);
 				if (ftp_res > 0)
 					SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
@@ -1148,9 +1892,16 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 			case BT_FTP_MD:
 				printf("MD %s\n", arg);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - MD.\n", __FUNCTION__);
-				sem_post(&ftp_timer.stop_timer);
+				ObexTimerHold(&ftp_timer);
+				CancelArm(&ctx.cancel, cli_sockfd, 1);
 				ftp_res = MakeDir(cli, arg);
-				sem_post(&ftp_timer.start_timer);
+				if(ctx.cancel.cause) {
+					ftp_quit = CancelReply(&cli, &ctx.cancel, cli_sockfd, led_org);
+					ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
+					break;
+				}
+				CancelArm(&ctx.cancel, -1, 0);
+				ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: MakeDir() returns ftp_res = %d\n", __FUNCTION__, ftp_res);
 				if (ftp_res > 0)
 					SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
@@ -1170,14 +1921,42 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 					SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
 					break;
 				}
+			case BT_FTP_STAT:
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - STAT.\n", __FUNCTION__);
+				StatsReport(cli_sockfd, NULL);
+				{
+					char arena_string[FTP_ARG_BUFF_SIZE] = {};
+					int heap = ArenaHeapCalls();
+					int leng;
+
+					leng = snprintf(arena_string, sizeof(arena_string), "ARENA size=%u peak=%u overflows=%u mallocs=%u",
+						(unsigned int)ctx.arena.size, (unsigned int)ctx.arena.peak, ctx.arena.overflows, ctx.arena.mallocs);
+					if(heap >= 0)	// the ARENA_HEAP_COUNT build
+						snprintf(arena_string+leng, sizeof(arena_string)-leng, " heap=%d", heap);
+					SendResponse(cli_sockfd, arena_string);
+					BudgetReport(arena_string, sizeof(arena_string));
+					SendResponse(cli_sockfd, arena_string);
+				}
+				SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
+				break;
 			case BT_FTP_PUT:
 				{
 					if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - PUT.\n", __FUNCTION__);
 					printf("Start to transmit file [%s]\n", arg);
 					SendResponse(cli_sockfd, "!");
-					sem_post(&ftp_timer.stop_timer);
-					ftp_res = FTPTransFile(cli, arg, FTPFROMSOCKET, cli_sockfd);
-					sem_post(&ftp_timer.start_timer);
+					ObexTimerHold(&ftp_timer);
+					CancelArm(&ctx.cancel, cli_sockfd, 0);
+					DigestInit(&digest, put_digest);
+					ctx.digest = (put_digest != DIGEST_NONE) ? &digest : NULL;
+					ftp_res = FTPTransFile(cli, arg, FTPFROMSOCKET, cli_sockfd, NULL);
+					ctx.digest = NULL;
+					if(ctx.cancel.cause) {
+						ftp_quit = CancelReply(&cli, &ctx.cancel, cli_sockfd, led_org);
+						ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
+						break;
+					}
+					CancelArm(&ctx.cancel, -1, 0);
+					ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
 					if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTPTransFile() returns ftp_res = %d\n", __FUNCTION__, ftp_res);
 					/* 
 					When the FTP is started, the socket is read by the openobex layer. However,
@@ -1190,9 +1969,16 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 						char buff[BUFFER_SIZE] = {};
 						memset(buff, 0, sizeof(buff));
 						
-						RecvSocketMsg(cli->fd, buff, sizeof(buff));	
+						RecvSocketMsg(cli_sockfd, buff, sizeof(buff));	
 					}
-					if (ftp_res > 0)
+					if (ftp_res > 0 && put_digest != DIGEST_NONE) {
+						char digest_string[DIGEST_STRING_LENG] = {};
+
+						if(DigestFinal(&digest, digest_string, sizeof(digest_string)) > 0)
+							SendFTPResponseDetail(cli_sockfd, BT_FTP_SERVICE_SUCCESS, digest_string);
+						else
+							SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
+					} else if (ftp_res > 0)
 						SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
 					else if (ftp_res < 0)
 						SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_INTERNAL_SERVER_ERROR);
@@ -1208,10 +1994,17 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 				CreateDirXML();
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - DIR -RAW.\n", __FUNCTION__);
 				printf("Get folder listing\n");
-				sem_post(&ftp_timer.stop_timer);
+				ObexTimerHold(&ftp_timer);
+				CancelArm(&ctx.cancel, cli_sockfd, 1);
 				//ftp_res =ListDir(cli, cli_sockfd);
 				ftp_res = GetDirContent(cli, cli_sockfd);
-				sem_post(&ftp_timer.start_timer);
+				if(ctx.cancel.cause) {
+					ftp_quit = CancelReply(&cli, &ctx.cancel, cli_sockfd, led_org);
+					ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
+					break;
+				}
+				CancelArm(&ctx.cancel, -1, 0);
+				ObexTimerRelease(&ftp_timer, cli, inactive_timeout);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: ListDir() returns ftp_res = %d\n", __FUNCTION__, ftp_res);
 				if (ftp_res > 0) {
 					GetDirXML(cli_sockfd, 0);
@@ -1225,24 +2018,32 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 				break;
 			case BT_FTP_QUIT:
 				ftp_quit = 1;
-				ftp_timer.timer_exit = 1;
-				sem_post(&ftp_timer.stop_timer);
-				if(pthread_join(timer_thread_id, NULL) < 0) {
-					debuglog(LOG_INFO, "[libositech_obex.so] Error: %s - pthread_join() failed.\n", __FUNCTION__);
-					perror("StartFTPSession(): pthread_join()");	
-				}
+				ObexTimerHold(&ftp_timer);
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - QUIT.\n", __FUNCTION__);
 				printf("Quit FTP session\n");
 				if(cli) {
 					ReleasBTConnection(cli);
 					cli = NULL;
 				}
+				SetBTLed(led_org);
 				SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
 				break;
 			case BT_FTP_ABORT:
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - ABORT.\n", __FUNCTION__);
 				SendFTPResponse(cli_sockfd, BT_FTP_SERVICE_SUCCESS);
 				break;
+			case BT_FTP_HANG:
+				// ATH within the FTP session, the BTDOWN is sent by the caller
+				ftp_quit = 1;
+				ObexTimerHold(&ftp_timer);
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command - ATH.\n", __FUNCTION__);
+				printf("Hang up FTP session\n");
+				if(cli) {
+					ReleasBTConnection(cli);
+					cli = NULL;
+				}
+				SetBTLed(led_org);
+				break;
 			default:	
 				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: FTP command is unknown.\n", __FUNCTION__);
 				printf("Unknown FTP command\n");
@@ -1256,10 +2057,15 @@ int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inac
 		}
 		printf("------------\n");
 		memset(arg, 0, sizeof(arg));
+		ArenaReset(&ctx.arena);
 	}
 	
-	sem_destroy(&ftp_timer.start_timer);
-	sem_destroy(&ftp_timer.stop_timer);
+	TimerStop(&ftp_timer.timer);
+	if(cli)
+		cli->infocb_data = NULL;
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: arena peak %u bytes, %u overflows\n", __FUNCTION__, (unsigned int)ctx.arena.peak, ctx.arena.overflows);
+	ArenaRelease(&ctx.arena);
+	CancelClose(&ctx.cancel);
 	return 1;
 }
 
@@ -31,6 +31,8 @@
 #define	BT_FTP_PUT	0xB5
 #define 	BT_FTP_DIR	0xB6
 #define	BT_FTP_ABORT	0xB7
+#define	BT_FTP_HANG	0xB8
+#define	BT_FTP_STAT	0xB9
 
 // BT FTP response
 #define BT_FTP_SERVICE_SUCCESS		200
@@ -50,7 +52,14 @@
 // BT FTP DIR command: print out the dir result
 #define DISPLAY_DIR_XML 1
 
-extern int StartFTPSession(const int cli_sockfd, unsigned char *client, const uint inactive_timeout, const int led_org);
+// OBEX over TCP
+#define OBEX_INET_PORT	650
+#define OBEX_HOST_LENG	64
+
+extern int StartFTPSession(const int cli_sockfd, unsigned char *client, const char *addr, const uint inactive_timeout, const int led_org);
+extern int ObexSetTransport(const char *spec);
+extern int ObexTransportIsBT(void);
+extern void ObexSetDigest(const int type);
 extern int EstablisBTConnection(const char *device, const int channel, unsigned char **client);
 extern int SearchBTwithObex(const char *addr, int *res_channel);
 extern void ReleasBTConnection(obexftp_client_t *cli);
@@ -60,7 +69,8 @@ extern int ListDir(obexftp_client_t *cli);
 extern void DelDirXML(void);
 extern int CreateDirXML(void);
 extern int GetDirXML(const int sockfd, const int display);
-extern int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method, const int sockfd);
+extern int FTPTransFile(obexftp_client_t *cli, const char *filename, const int method, const int sockfd, const char *addr);
+extern int FTPTransBuffer(obexftp_client_t *cli, const char *remotename, const uint8_t *data, const uint32_t size, const char *addr);
 //extern int SendResponse(const int sockfd, const char *resp_string);
 
 #endif
\ No newline at end of file
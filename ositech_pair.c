@@ -0,0 +1,464 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		pairing of AT+BTW off the connection handler. A
+*				thread pages the device, requests the authentication
+*				and reads the name while the link is up. The MRx gets
+*				"OK" right away and "PAIR <code> <addr>" when it's done.
+*				The PIN Code Request and the Secure Simple Pairing
+*				confirmation are only answered by the system agent of
+*				bluetoothd, with the PIN of PINCODE_FILE: the thread
+*				watches them for the progress lines, it never replies.
+* File Name:			ositech_pair.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+#include "config.h"
+#include "ositech_bt.h"
+#include "ositech_budget.h"
+#include "ositech_stats.h"
+#include "ositech_communication.h"
+#include "ositech_inquiry.h"
+#include "ositech_discovery.h"
+#include "ositech_names.h"
+#include "ositech_pair.h"
+
+#define PAIR_EVENT_SIZE			(HCI_MAX_EVENT_SIZE + 1)
+#define PAIR_STATUS_PAGE_TIMEOUT	0x04	// Page Timeout of Connection Complete
+#define PAIR_STATUS_CONN_EXISTS	0x0B	// ACL Connection Already Exists
+#define PAIR_PKT_TYPE	(HCI_DM1 | HCI_DM3 | HCI_DM5 | HCI_DH1 | HCI_DH3 | HCI_DH5)
+
+static struct pair_state {
+	pthread_mutex_t lock;
+	int running;
+	int cli;					// the MRx, -1 once it's gone
+	int progress;				// "PAIRING" lines to the MRx
+	bdaddr_t bdaddr;
+	char addr[BT_ADDR_LENGTH];
+	char tag[BT_ADDR_LENGTH];	// the address as the MRx gave it
+	unsigned long long start;	// StatsNow() of AT+BTW
+} pair = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cli = -1,
+};
+
+typedef struct pair_session {
+	int dd;
+	int connected;
+	uint16_t handle;
+	int res;					// PAIR_*, -1 until the authentication is done
+	inq_dev dev;				// the page scan mode, clock offset and name
+	int name_lock;				// InqTryLock() taken for the name request
+	unsigned long long deadline;	// StatsNow() of the page or the authentication timeout
+	unsigned long long page_us;		// AT+BTW to Connection Complete
+} pair_session;
+
+// a line to the MRx, unless it's gone
+static void PairSend(const char *line) {
+	pthread_mutex_lock(&pair.lock);
+	if(pair.cli >= 0)
+		SendResponse(pair.cli, line);
+	pthread_mutex_unlock(&pair.lock);
+}
+
+// "PAIRING <addr> <stage> <ms since AT+BTW>"
+static void PairProgress(const char *stage) {
+	char line[64] = {};
+	unsigned long long ms = (StatsNow() - pair.start) / 1000;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %s at %llu ms\n", __FUNCTION__, pair.addr, stage, ms);
+	if(!pair.progress)
+		return;
+	snprintf(line, sizeof(line), "PAIRING %s %s %llu", pair.tag, stage, ms);
+	PairSend(line);
+}
+
+// the handle of the ACL link up to the device, if any
+static int PairConnHandle(const int dd, const bdaddr_t *bdaddr, uint16_t *handle) {
+	struct hci_conn_info_req *cr;
+	int ret = -1;
+
+	if((cr = malloc(sizeof(*cr) + sizeof(struct hci_conn_info))) == NULL)
+		return -1;
+	memset(cr, 0, sizeof(*cr) + sizeof(struct hci_conn_info));
+	bacpy(&cr->bdaddr, bdaddr);
+	cr->type = ACL_LINK;
+	if(ioctl(dd, HCIGETCONNINFO, (unsigned long)cr) == 0) {
+		*handle = cr->conn_info->handle;
+		ret = 0;
+	}
+	free(cr);
+	return ret;
+}
+
+// the link is up, the authentication and the name request go out together
+static void PairConnected(pair_session *sess) {
+	auth_requested_cp ap;
+	remote_name_req_cp np;
+
+	sess->connected = 1;
+	sess->page_us = StatsNow() - pair.start;
+	sess->deadline = StatsNow() + PAIR_AUTH_TIMEOUT_MS * 1000ULL;
+	PairProgress("CONNECTED");
+
+	ap.handle = htobs(sess->handle);
+	if(hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_AUTH_REQUESTED, AUTH_REQUESTED_CP_SIZE, &ap) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s Authentication Requested failed %s\n", __FUNCTION__, strerror(errno));
+		sess->res = PAIR_FAILED;
+		return;
+	}
+
+	if(sess->dev.name_state != INQ_NAME_NONE)
+		return;
+	// an inquiry or a name session would take the Command Status of this request
+	if(InqTryLock() < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: the adaptor is reading names, the name is not read\n", __FUNCTION__);
+		sess->dev.name_state = INQ_NAME_FAILED;
+		return;
+	}
+	sess->name_lock = 1;
+	memset(&np, 0, sizeof(np));
+	bacpy(&np.bdaddr, &pair.bdaddr);
+	np.pscan_rep_mode = sess->dev.pscan_rep_mode;
+	np.clock_offset = sess->dev.clock_offset;
+	if(hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_REMOTE_NAME_REQ, REMOTE_NAME_REQ_CP_SIZE, &np) < 0) {
+		sess->dev.name_state = INQ_NAME_FAILED;
+		InqUnlock();
+		sess->name_lock = 0;
+		return;
+	}
+	sess->dev.name_state = INQ_NAME_PENDING;
+	sess->dev.deadline = StatsNow() + INQ_NAME_TIMEOUT_MS * 1000ULL;
+}
+
+static void PairEvent(pair_session *sess, const unsigned char *buf, const int len) {
+	const hci_event_hdr *hdr = (const hci_event_hdr *)(buf + 1);
+	const unsigned char *ptr = buf + 1 + HCI_EVENT_HDR_SIZE;
+	const evt_cmd_status *cs;
+	const evt_conn_complete *cc;
+	const evt_auth_complete *ac;
+	const evt_disconn_complete *dc;
+	const evt_remote_name_req_complete *rn;
+
+	if(len < 1 + HCI_EVENT_HDR_SIZE || buf[0] != HCI_EVENT_PKT || len < 1 + HCI_EVENT_HDR_SIZE + hdr->plen)
+		return;
+
+	switch(hdr->evt) {
+		case EVT_CMD_STATUS:
+			cs = (const evt_cmd_status *)ptr;
+			if(hdr->plen < EVT_CMD_STATUS_SIZE || !cs->status)
+				break;
+			if(btohs(cs->opcode) == cmd_opcode_pack(OGF_LINK_CTL, OCF_CREATE_CONN) && !sess->connected) {
+				// a link of another process, the pairing goes over it
+				if(cs->status == PAIR_STATUS_CONN_EXISTS && PairConnHandle(sess->dd, &pair.bdaddr, &sess->handle) == 0) {
+					PairConnected(sess);
+					break;
+				}
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the page is refused, status 0x%2.2x\n", __FUNCTION__, cs->status);
+				sess->res = PAIR_FAILED;
+			} else if(btohs(cs->opcode) == cmd_opcode_pack(OGF_LINK_CTL, OCF_AUTH_REQUESTED) && sess->connected && sess->res < 0) {
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the authentication is refused, status 0x%2.2x\n", __FUNCTION__, cs->status);
+				sess->res = PAIR_FAILED;
+			}
+			break;
+		case EVT_CONN_COMPLETE:
+			cc = (const evt_conn_complete *)ptr;
+			if(hdr->plen < EVT_CONN_COMPLETE_SIZE || sess->connected || cc->link_type != ACL_LINK || bacmp(&cc->bdaddr, &pair.bdaddr))
+				break;
+			if(cc->status) {
+				if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the page failed, status 0x%2.2x\n", __FUNCTION__, cc->status);
+				sess->res = (cc->status == PAIR_STATUS_PAGE_TIMEOUT) ? PAIR_TIMEOUT : PAIR_FAILED;
+				break;
+			}
+			sess->handle = btohs(cc->handle);
+			PairConnected(sess);
+			break;
+		// answered by the system agent
+		case EVT_PIN_CODE_REQ:
+			if(hdr->plen >= EVT_PIN_CODE_REQ_SIZE && !bacmp(&((const evt_pin_code_req *)ptr)->bdaddr, &pair.bdaddr))
+				PairProgress("PIN");
+			break;
+		case EVT_USER_CONFIRM_REQUEST:
+			if(hdr->plen >= EVT_USER_CONFIRM_REQUEST_SIZE && !bacmp(&((const evt_user_confirm_request *)ptr)->bdaddr, &pair.bdaddr))
+				PairProgress("CONFIRM");
+			break;
+		case EVT_AUTH_COMPLETE:
+			ac = (const evt_auth_complete *)ptr;
+			if(hdr->plen < EVT_AUTH_COMPLETE_SIZE || !sess->connected || btohs(ac->handle) != sess->handle || sess->res >= 0)
+				break;
+			if(ac->status && debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the authentication failed, status 0x%2.2x\n", __FUNCTION__, ac->status);
+			sess->res = ac->status ? PAIR_FAILED : PAIR_OK;
+			break;
+		case EVT_DISCONN_COMPLETE:
+			dc = (const evt_disconn_complete *)ptr;
+			if(hdr->plen < EVT_DISCONN_COMPLETE_SIZE || !sess->connected || btohs(dc->handle) != sess->handle || sess->res >= 0)
+				break;
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s the link is down, reason 0x%2.2x\n", __FUNCTION__, dc->reason);
+			sess->res = PAIR_FAILED;
+			break;
+		case EVT_REMOTE_NAME_REQ_COMPLETE:
+			rn = (const evt_remote_name_req_complete *)ptr;
+			if(hdr->plen < 1 + (int)sizeof(bdaddr_t) || sess->dev.name_state != INQ_NAME_PENDING || bacmp(&rn->bdaddr, &pair.bdaddr))
+				break;
+			if(rn->status || hdr->plen < EVT_REMOTE_NAME_REQ_COMPLETE_SIZE) {
+				sess->dev.name_state = INQ_NAME_FAILED;
+				break;
+			}
+			memcpy(sess->dev.name, rn->name, sizeof(sess->dev.name) - 1);
+			sess->dev.name[sizeof(sess->dev.name) - 1] = '\0';
+			sess->dev.name_state = INQ_NAME_DONE;
+			NamesPut(&pair.bdaddr, sess->dev.name);
+			PairProgress("NAME");
+			break;
+	}
+}
+
+/***********************************************************************
+* Description:
+* Page the device and authenticate it. A device seen lately by the
+* discovery is paged with its page scan mode and clock offset, and a link
+* already up is authenticated without a page. The name is read once the
+* link is up, unless the names cache has it.
+*
+* Calling Arguments:
+* Name			Description
+* sess		the pairing, the name is left in sess->dev
+*
+* Return Value:
+* PAIR_OK, PAIR_TIMEOUT or PAIR_FAILED
+******************************************************************************/
+static int PairRun(pair_session *sess) {
+	unsigned char buf[PAIR_EVENT_SIZE];
+	struct hci_filter nf;
+	struct pollfd pfd;
+	create_conn_cp cp;
+	create_conn_cancel_cp ccp;
+	unsigned long long now, deadline;
+	int dev_id, len;
+
+	if((dev_id = hci_get_route(&pair.bdaddr)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_get_route() local BT device Failed\n", __FUNCTION__);
+		return PAIR_FAILED;
+	}
+	if((sess->dd = hci_open_dev(dev_id)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: hci_open_dev() local BT device Failed\n", __FUNCTION__);
+		return PAIR_FAILED;
+	}
+	hci_filter_clear(&nf);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &nf);
+	hci_filter_set_event(EVT_CMD_STATUS, &nf);
+	hci_filter_set_event(EVT_CONN_COMPLETE, &nf);
+	hci_filter_set_event(EVT_DISCONN_COMPLETE, &nf);
+	hci_filter_set_event(EVT_AUTH_COMPLETE, &nf);
+	hci_filter_set_event(EVT_PIN_CODE_REQ, &nf);
+	hci_filter_set_event(EVT_USER_CONFIRM_REQUEST, &nf);
+	hci_filter_set_event(EVT_REMOTE_NAME_REQ_COMPLETE, &nf);
+	if(setsockopt(sess->dd, SOL_HCI, HCI_FILTER, &nf, sizeof(nf)) < 0) {
+		perror("HCI filter setup failed");
+		hci_close_dev(sess->dd);
+		return PAIR_FAILED;
+	}
+
+	sess->res = -1;
+	if(DiscoveryLookup(&pair.bdaddr, &sess->dev) < 0) {
+		memset(&sess->dev, 0, sizeof(sess->dev));
+		bacpy(&sess->dev.bdaddr, &pair.bdaddr);
+		sess->dev.pscan_rep_mode = INQ_PSCAN_REP_MODE_R2;
+	} else
+		sess->dev.clock_offset = htobs(btohs(sess->dev.clock_offset) | 0x8000);	// Clock_Offset_Valid_Flag
+	sess->dev.name_state = (NamesGet(&pair.bdaddr, sess->dev.name, sizeof(sess->dev.name)) == 0) ? INQ_NAME_DONE : INQ_NAME_NONE;
+
+	if(PairConnHandle(sess->dd, &pair.bdaddr, &sess->handle) == 0)
+		PairConnected(sess);
+	else {
+		memset(&cp, 0, sizeof(cp));
+		bacpy(&cp.bdaddr, &pair.bdaddr);
+		cp.pkt_type = htobs(PAIR_PKT_TYPE);
+		cp.pscan_rep_mode = sess->dev.pscan_rep_mode;
+		cp.clock_offset = sess->dev.clock_offset;
+		cp.role_switch = SLAVE_ROLE;
+		if(hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_CREATE_CONN, CREATE_CONN_CP_SIZE, &cp) < 0) {
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s Create Connection failed %s\n", __FUNCTION__, strerror(errno));
+			hci_close_dev(sess->dd);
+			return PAIR_FAILED;
+		}
+		sess->deadline = StatsNow() + PAIR_CONN_TIMEOUT_MS * 1000ULL;
+		PairProgress("PAGE");
+	}
+
+	// the name is waited for after the authentication, up to its own timeout
+	pfd.fd = sess->dd;
+	pfd.events = POLLIN;
+	while(sess->res < 0 || (sess->res == PAIR_OK && sess->dev.name_state == INQ_NAME_PENDING)) {
+		now = StatsNow();
+		deadline = (sess->res < 0) ? sess->deadline : sess->dev.deadline;
+		if(deadline <= now) {
+			if(sess->res >= 0) {
+				sess->dev.name_state = INQ_NAME_FAILED;
+				break;
+			}
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s no %s in time\n", __FUNCTION__, sess->connected ? "Authentication Complete" : "Connection Complete");
+			if(!sess->connected) {
+				bacpy(&ccp.bdaddr, &pair.bdaddr);
+				hci_send_cmd(sess->dd, OGF_LINK_CTL, OCF_CREATE_CONN_CANCEL, CREATE_CONN_CANCEL_CP_SIZE, &ccp);
+			}
+			sess->res = PAIR_TIMEOUT;
+			break;
+		}
+		if(poll(&pfd, 1, (int)((deadline - now + 999) / 1000)) < 0) {
+			if(errno == EINTR)
+				continue;
+			sess->res = PAIR_FAILED;
+			break;
+		}
+		if(pfd.revents & POLLIN) {
+			if((len = read(sess->dd, buf, sizeof(buf))) > 0)
+				PairEvent(sess, buf, len);
+		} else if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			sess->res = PAIR_FAILED;
+			break;
+		}
+		// the name is in, the inquiries needn't wait for the authentication
+		if(sess->name_lock && sess->dev.name_state != INQ_NAME_PENDING) {
+			InqUnlock();
+			sess->name_lock = 0;
+		}
+	}
+
+	hci_close_dev(sess->dd);
+	if(sess->name_lock) {
+		InqUnlock();
+		sess->name_lock = 0;
+	}
+	return sess->res;
+}
+
+// "PAIR <code> <addr>[ 00]", the paired device is kept with its name
+static void PairFinish(pair_session *sess) {
+	char resp[128] = {};
+	char bt_addr[BT_ADDR_LENGTH] = {};
+	char *pstring = NULL;
+	int string_leng;
+
+	if(sess->res == PAIR_OK) {
+		if(sess->dev.name_state != INQ_NAME_DONE) {
+			snprintf(bt_addr, sizeof(bt_addr), "%s", pair.addr);
+			AddrStringRmColumn(bt_addr);
+			snprintf(sess->dev.name, sizeof(sess->dev.name), "*%s", bt_addr);	// using *+btaddress
+		}
+		string_leng = strlen(pair.addr) + strlen(sess->dev.name) + 3;	// format of "bt_addr,friendlyname\n\0"
+		if((pstring = malloc(string_leng)) != NULL) {
+			snprintf(pstring, string_leng, "%s,%s\n", pair.addr, sess->dev.name);
+			UpdatePairedDevice(pair.addr, pstring);
+			free(pstring);
+		}
+	}
+
+	PairProgress("DONE");
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s PAIR %d in %llu ms, page %llu ms\n", __FUNCTION__, pair.addr, sess->res,
+		(StatsNow() - pair.start) / 1000, sess->page_us / 1000);
+	snprintf(resp, sizeof(resp), "PAIR %d %s%s", sess->res, pair.tag, (sess->res == PAIR_OK) ? " 00" : "");
+	PairSend(resp);
+}
+
+static void *PairThread(void *arg) {
+	pair_session sess;
+	int led_org;
+
+	memset(&sess, 0, sizeof(sess));
+	led_org = GetCurBTLed();
+	SetBTLed(BT_LED_SOLID);
+	// the page and the authentication don't share the air with the discovery
+	DiscoveryPause();
+	sess.res = PairRun(&sess);
+	DiscoveryResume();
+	PairFinish(&sess);
+	SetBTLed(led_org);
+
+	pthread_mutex_lock(&pair.lock);
+	pair.running = 0;
+	pthread_mutex_unlock(&pair.lock);
+	return NULL;
+}
+
+/***********************************************************************
+* Description:
+* Start the pairing of AT+BTW in a thread. "OK" is sent to the MRx before
+* any line of the pairing, "PAIRING <addr> <stage> <ms>" follow when
+* asked for, and "PAIR <code> <addr>" ends it.
+*
+* Calling Arguments:
+* Name			Description
+* cli		the socket of the MRx
+* addr		the address of the device, with ':'
+* tag		the address as the MRx gave it, for the lines sent back
+* progress	1 for the "PAIRING" lines
+*
+* Return Value:
+* 0: started
+* -1: a pairing is running
+* -2: the thread can't be started
+******************************************************************************/
+int PairStart(const int cli, const char *addr, const char *tag, const int progress) {
+	pthread_t thread;
+	pthread_attr_t attr;
+	int ret = 0;
+
+	pthread_mutex_lock(&pair.lock);
+	if(pair.running) {
+		pthread_mutex_unlock(&pair.lock);
+		return -1;
+	}
+	str2ba(addr, &pair.bdaddr);
+	snprintf(pair.addr, sizeof(pair.addr), "%s", addr);
+	snprintf(pair.tag, sizeof(pair.tag), "%s", tag);
+	pair.cli = cli;
+	pair.progress = progress;
+	pair.start = StatsNow();
+
+	// the thread sends nothing until the lock is given up
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&thread, &attr, PairThread, NULL) != 0) {
+		perror("pthread_create() of the pairing failed");
+		ret = -2;
+	} else {
+		pair.running = 1;
+		SendResponse(cli, "OK");	// start pairing
+	}
+	pthread_attr_destroy(&attr);
+	pthread_mutex_unlock(&pair.lock);
+	return ret;
+}
+
+// the MRx is gone, the running pairing sends nothing more to it
+void PairDetach(const int cli) {
+	pthread_mutex_lock(&pair.lock);
+	if(pair.cli == cli)
+		pair.cli = -1;
+	pthread_mutex_unlock(&pair.lock);
+}
@@ -0,0 +1,30 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_pair.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_PAIR_H
+#define __OSITECH_PAIR_H
+
+#define PAIR_CONN_TIMEOUT_MS	25000	// the page, as long as hci_create_connection() was given
+#define PAIR_AUTH_TIMEOUT_MS	30000	// the PIN or the confirmation is entered on the remote device
+
+// <code> of "PAIR <code> <addr>"
+#define PAIR_OK			0
+#define PAIR_TIMEOUT	1
+#define PAIR_FAILED		2
+
+extern int PairStart(const int cli, const char *addr, const char *tag, const int progress);
+extern void PairDetach(const int cli);
+
+#endif
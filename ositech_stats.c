@@ -0,0 +1,184 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		throughput and stage latency of the FTP transfers
+* File Name:			ositech_stats.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_communication.h"
+#include "ositech_stats.h"
+
+typedef struct peer_stats {
+	char addr[STATS_ADDR_LENG];
+	unsigned int transfers;
+	unsigned long long last_use;
+	xfer_stats total;
+} peer_stats;
+
+static xfer_stats last_xfer;
+static int last_valid;
+static peer_stats peers[STATS_MAX_PEERS];
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// monotonic time in usec
+unsigned long long StatsNow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void StatsReset(xfer_stats *stats) {
+	memset(stats, 0, sizeof(xfer_stats));
+}
+
+void StatsAddRtt(xfer_stats *stats, const unsigned long long rtt_us) {
+	unsigned long long ms = rtt_us / 1000;
+	int i = 0;
+
+	while(ms && i < STATS_RTT_BUCKETS - 1) {
+		ms >>= 1;
+		i++;
+	}
+	stats->rtt_hist[i]++;
+}
+
+static void StatsAdd(xfer_stats *total, const xfer_stats *stats) {
+	int i;
+
+	total->bytes += stats->bytes;
+	total->wall_us += stats->wall_us;
+	total->mrx_us += stats->mrx_us;
+	total->obex_us += stats->obex_us;
+	total->packets += stats->packets;
+	for(i = 0; i < STATS_RTT_BUCKETS; i++)
+		total->rtt_hist[i] += stats->rtt_hist[i];
+}
+
+/*********************************************************************** 
+* Description:
+* Keep the statistics of a finished transfer as the last transfer, and add
+* them to the aggregates of the peer. The least recently used peer is
+* replaced once the table is full.
+*
+* Calling Arguments: 
+* Name			Description 
+* addr		BT address of the peer, may be NULL
+* stats		the statistics of the transfer
+*
+* Return Value: 
+* none
+******************************************************************************/
+void StatsCommit(const char *addr, const xfer_stats *stats) {
+	peer_stats *peer = NULL;
+	int i;
+
+	pthread_mutex_lock(&stats_lock);
+	last_xfer = *stats;
+	last_valid = 1;
+
+	if(addr && strlen(addr)) {
+		for(i = 0; i < STATS_MAX_PEERS; i++) {
+			if(!strcasecmp(peers[i].addr, addr)) {
+				peer = &peers[i];
+				break;
+			}
+			if(!peer || peers[i].last_use < peer->last_use)
+				peer = &peers[i];
+		}
+		if(strcasecmp(peer->addr, addr)) {
+			memset(peer, 0, sizeof(peer_stats));
+			snprintf(peer->addr, sizeof(peer->addr), "%s", addr);
+		}
+		peer->transfers++;
+		peer->last_use = StatsNow();
+		StatsAdd(&peer->total, stats);
+	}
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static void StatsSend(const int sockfd, const char *tag, const xfer_stats *stats, const unsigned int transfers) {
+	char line[RESP_BUFF_SIZE/2] = {};
+	int leng, i;
+	unsigned long long daemon_us = 0;
+
+	// neither blocked on the MRx nor waiting for the peer: spent in titan_obex
+	if(stats->wall_us > stats->mrx_us + stats->obex_us)
+		daemon_us = stats->wall_us - stats->mrx_us - stats->obex_us;
+
+	leng = snprintf(line, sizeof(line), "%s", tag);
+	if(transfers)
+		leng += snprintf(line+leng, sizeof(line)-leng, " transfers=%u", transfers);
+	snprintf(line+leng, sizeof(line)-leng, " bytes=%llu wall_ms=%llu mrx_ms=%llu obex_ms=%llu daemon_ms=%llu packets=%u avg_packet=%llu kbps=%llu",
+		stats->bytes, stats->wall_us/1000, stats->mrx_us/1000, stats->obex_us/1000, daemon_us/1000, stats->packets,
+		stats->packets ? stats->bytes/stats->packets : 0,
+		stats->wall_us ? stats->bytes*8*1000/stats->wall_us : 0);
+	SendResponse(sockfd, line);
+
+	leng = snprintf(line, sizeof(line), "%s RTT_MS", tag);
+	for(i = 0; i < STATS_RTT_BUCKETS; i++)
+		leng += snprintf(line+leng, sizeof(line)-leng, " %s%u:%u", (i == STATS_RTT_BUCKETS-1) ? ">=" : "<",
+			(i == STATS_RTT_BUCKETS-1) ? 1 << (i-1) : 1 << i, stats->rtt_hist[i]);
+	SendResponse(sockfd, line);
+}
+
+/*********************************************************************** 
+* Description:
+* Send the statistics of the last transfer and the aggregates of the peers
+* to the MRx. One line per item, e.g.
+*	LAST bytes=1048576 wall_ms=5210 mrx_ms=830 obex_ms=4230 daemon_ms=150 ...
+*	LAST RTT_MS <1:250 <2:6 ...
+*	PEER 00:11:22:33:44:55 transfers=3 bytes=...
+*
+* Calling Arguments: 
+* Name			Description 
+* sockfd		the MRx socket
+* addr		only report this peer, all peers if NULL
+*
+* Return Value: 
+* number of reported peers
+******************************************************************************/
+int StatsReport(const int sockfd, const char *addr) {
+	char tag[STATS_ADDR_LENG+8] = {};
+	peer_stats snap[STATS_MAX_PEERS];
+	xfer_stats last;
+	int i, valid, num = 0;
+
+	// the MRx may be slow to read, don't hold up the transfers committing
+	pthread_mutex_lock(&stats_lock);
+	last = last_xfer;
+	valid = last_valid;
+	memcpy(snap, peers, sizeof(snap));
+	pthread_mutex_unlock(&stats_lock);
+
+	if(valid)
+		StatsSend(sockfd, "LAST", &last, 0);
+	for(i = 0; i < STATS_MAX_PEERS; i++) {
+		if(!snap[i].transfers)
+			continue;
+		if(addr && strcasecmp(snap[i].addr, addr))
+			continue;
+		snprintf(tag, sizeof(tag), "PEER %s", snap[i].addr);
+		StatsSend(sockfd, tag, &snap[i].total, snap[i].transfers);
+		num++;
+	}
+
+	return num;
+}
@@ -0,0 +1,38 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_stats.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_STATS_H
+#define __OSITECH_STATS_H
+
+#define STATS_RTT_BUCKETS	12	// <1ms, <2ms, <4ms ... >=1024ms
+#define STATS_MAX_PEERS	8
+#define STATS_ADDR_LENG	18
+
+typedef struct xfer_stats {
+	unsigned long long bytes;
+	unsigned long long wall_us;		// whole transfer
+	unsigned long long mrx_us;		// blocked on the MRx socket
+	unsigned long long obex_us;		// waiting for the OBEX peer, packet sent to its response
+	unsigned int packets;			// OBEX packets
+	unsigned int rtt_hist[STATS_RTT_BUCKETS];	// MRx "?" to first data byte
+} xfer_stats;
+
+extern unsigned long long StatsNow(void);
+extern void StatsReset(xfer_stats *stats);
+extern void StatsAddRtt(xfer_stats *stats, const unsigned long long rtt_us);
+extern void StatsCommit(const char *addr, const xfer_stats *stats);
+extern int StatsReport(const int sockfd, const char *addr);
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		hashed timer wheel shared by every timeout of the daemon
+* File Name:			ositech_timer.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <debuglog.h>
+
+#include "config.h"
+#include "ositech_timer.h"
+#include "ositech_budget.h"
+
+#define TIMER_SLOT_MASK	(TIMER_WHEEL_SLOTS - 1)
+
+static bt_timer_t *wheel[TIMER_WHEEL_SLOTS];
+static unsigned long cur_tick;
+static unsigned int num_pending;
+static int wheel_armed;
+static int timer_fd = -1;
+static bt_timer_t *running;
+static pthread_t wheel_thread_id;
+static pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wheel_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t wheel_once = PTHREAD_ONCE_INIT;
+
+/***********************************************************************
+* Description:
+* Start or stop the tick of the wheel. The timerfd only ticks while there
+* is at least one pending timer, so an idle daemon is never woken up.
+*
+* Calling Arguments:
+* Name			Description
+* None
+*
+* Return Value:
+* None
+******************************************************************************/
+static void WheelUpdateArm(void) {
+	struct itimerspec itv;
+
+	if((num_pending > 0) == wheel_armed)
+		return;
+
+	memset(&itv, 0, sizeof(itv));
+	if(num_pending) {
+		itv.it_value.tv_nsec = TIMER_TICK_MS * 1000000;
+		itv.it_interval.tv_nsec = TIMER_TICK_MS * 1000000;
+	}
+	if(timerfd_settime(timer_fd, 0, &itv, NULL) < 0) {
+		perror("WheelUpdateArm: timerfd_settime() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: timerfd_settime() failed.\n", __FUNCTION__);
+		return;
+	}
+	wheel_armed = (num_pending > 0);
+}
+
+static void WheelLink(bt_timer_t *timer) {
+	bt_timer_t **pslot = &wheel[timer->expire & TIMER_SLOT_MASK];
+
+	timer->pprev = NULL;
+	timer->pnext = *pslot;
+	if(*pslot)
+		(*pslot)->pprev = timer;
+	*pslot = timer;
+	timer->pending = 1;
+	num_pending++;
+}
+
+static void WheelUnlink(bt_timer_t *timer) {
+	if(timer->pprev)
+		timer->pprev->pnext = timer->pnext;
+	else
+		wheel[timer->expire & TIMER_SLOT_MASK] = timer->pnext;
+	if(timer->pnext)
+		timer->pnext->pprev = timer->pprev;
+
+	timer->pnext = NULL;
+	timer->pprev = NULL;
+	timer->pending = 0;
+	num_pending--;
+}
+
+/***********************************************************************
+* Description:
+* Walk the slot of every elapsed tick and run the expired callbacks with
+* the wheel unlocked, so a callback is free to start or stop any timer
+* including its own.
+*
+* Calling Arguments:
+* Name			Description
+* expirations		number of elapsed ticks
+*
+* Return Value:
+* None
+******************************************************************************/
+static void WheelDispatch(uint64_t expirations) {
+	bt_timer_t *timer, *pnext;
+
+	pthread_mutex_lock(&wheel_lock);
+	while(expirations--) {
+		cur_tick++;
+		timer = wheel[cur_tick & TIMER_SLOT_MASK];
+		while(timer) {
+			pnext = timer->pnext;
+			// timers hashed into this slot but due in a later round are skipped
+			if((long)(timer->expire - cur_tick) <= 0) {
+				WheelUnlink(timer);
+				running = timer;
+				pthread_mutex_unlock(&wheel_lock);
+				timer->cb(timer->arg);
+				pthread_mutex_lock(&wheel_lock);
+				running = NULL;
+				pthread_cond_broadcast(&wheel_cond);
+				// the slot may have been changed by the callback, walk it again
+				pnext = wheel[cur_tick & TIMER_SLOT_MASK];
+			}
+			timer = pnext;
+		}
+	}
+	WheelUpdateArm();
+	pthread_mutex_unlock(&wheel_lock);
+}
+
+// the thread of the timer wheel
+static void *TimerService(void *arg) {
+	uint64_t expirations;
+
+	while(1) {
+		if(read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+			if(errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("TimerService: read() failed");
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s read() -- %s\n", __FUNCTION__, strerror(errno));
+			break;
+		}
+		WheelDispatch(expirations);
+	}
+
+	pthread_exit(NULL);
+}
+
+static void TimerServiceInit(void) {
+	pthread_attr_t attr;
+
+	if((timer_fd = timerfd_create(CLOCK_MONOTONIC, 0)) < 0) {
+		perror("TimerServiceInit: timerfd_create() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s timerfd_create() -- %s\n", __FUNCTION__, strerror(errno));
+		return;
+	}
+
+	pthread_attr_init(&attr);
+	BudgetThreadAttr(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if(pthread_create(&wheel_thread_id, &attr, TimerService, NULL) != 0) {
+		perror("TimerServiceInit: pthread_create() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s pthread_create() failed.\n", __FUNCTION__);
+		pthread_attr_destroy(&attr);
+		close(timer_fd);
+		timer_fd = -1;
+		return;
+	}
+	pthread_attr_destroy(&attr);
+}
+
+/***********************************************************************
+* Description:
+* Prepare a timer. The bt_timer_t is owned by the caller (usually embedded
+* in a session), the wheel never allocates memory.
+*
+* Calling Arguments:
+* Name			Description
+* timer		the timer
+* cb		function called from the wheel thread on expiry
+* arg		argument given to the callback
+*
+* Return Value:
+* None
+******************************************************************************/
+void TimerInit(bt_timer_t *timer, bt_timer_cb cb, void *arg) {
+	memset(timer, 0, sizeof(*timer));
+	timer->cb = cb;
+	timer->arg = arg;
+}
+
+/***********************************************************************
+* Description:
+* (Re)start the timer to expire msec from now. The wheel thread is started
+* by the first caller.
+*
+* Calling Arguments:
+* Name			Description
+* timer		the timer
+* msec		timeout in millisecond, rounded up to TIMER_TICK_MS
+*
+* Return Value:
+* 0: success
+* -1: the timer service is not available
+******************************************************************************/
+int TimerStart(bt_timer_t *timer, const unsigned int msec) {
+	unsigned long ticks = (msec + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+
+	pthread_once(&wheel_once, TimerServiceInit);
+	if(timer_fd < 0)
+		return -1;
+
+	if(!ticks)
+		ticks = 1;
+
+	pthread_mutex_lock(&wheel_lock);
+	if(timer->pending)
+		WheelUnlink(timer);
+	timer->expire = cur_tick + ticks;
+	WheelLink(timer);
+	WheelUpdateArm();
+	pthread_mutex_unlock(&wheel_lock);
+
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Stop the timer. If its callback is running on the wheel thread, wait for
+* it to return, so the caller may release the timer afterwards.
+*
+* Calling Arguments:
+* Name			Description
+* timer		the timer
+*
+* Return Value:
+* None
+******************************************************************************/
+void TimerStop(bt_timer_t *timer) {
+	pthread_mutex_lock(&wheel_lock);
+	if(timer->pending) {
+		WheelUnlink(timer);
+		WheelUpdateArm();
+	}
+	if(timer_fd >= 0 && !pthread_equal(pthread_self(), wheel_thread_id)) {
+		while(running == timer)
+			pthread_cond_wait(&wheel_cond, &wheel_lock);
+	}
+	pthread_mutex_unlock(&wheel_lock);
+}
+
+int TimerPending(bt_timer_t *timer) {
+	int pending;
+
+	pthread_mutex_lock(&wheel_lock);
+	pending = timer->pending;
+	pthread_mutex_unlock(&wheel_lock);
+
+	return pending;
+}
@@ -0,0 +1,38 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_timer.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_TIMER_H
+#define __OSITECH_TIMER_H
+
+#define TIMER_TICK_MS		50
+#define TIMER_WHEEL_SLOTS	256	// must be power of 2
+
+typedef void (*bt_timer_cb)(void *arg);
+
+typedef struct bt_timer {
+	struct bt_timer *pnext;
+	struct bt_timer *pprev;
+	unsigned long expire;	// absolute tick of expiry
+	bt_timer_cb cb;
+	void *arg;
+	int pending;
+} bt_timer_t;
+
+extern void TimerInit(bt_timer_t *timer, bt_timer_cb cb, void *arg);
+extern int TimerStart(bt_timer_t *timer, const unsigned int msec);
+extern void TimerStop(bt_timer_t *timer);
+extern int TimerPending(bt_timer_t *timer);
+
+#endif
@@ -0,0 +1,651 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+ /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description: 		trusted devices in memory. linkkeys, paireddevice and
+*				names of the adaptor are read once into a table indexed
+*				by the device address, and read again only when one of
+*				them, or the journal replayed over paireddevice, is
+*				changed by someone else.
+* File Name:			ositech_trust.c
+* Last Modified:
+* Changes:
+**********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <debuglog.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "config.h"
+#include "hci_info.h"
+#include "ositech_bt.h"
+#include "ositech_arena.h"
+#include "ositech_stats.h"
+#include "ositech_journal.h"
+#include "ositech_trust.h"
+
+#define TRUST_PATH_LENG		64		// the paths of hci_info.c
+#define TRUST_ADDR_LENG		17		// xx:xx:xx:xx:xx:xx
+#define TRUST_MIN_SLOTS		64
+#define TRUST_NAMES_SIZE	4096	// first arena of the names, grows with the files
+#define TRUST_EVENT_SIZE	(sizeof(struct inotify_event) + NAME_MAX + 1)
+#define TRUST_BENCH_DIR		"/tmp/trust_bench"
+
+// which file a device comes from
+#define TRUST_LINKKEY	0x1		// linkkeys: trusted
+#define TRUST_PAIRED	0x2		// paireddevice: name read at pairing
+#define TRUST_NAMED		0x4		// names: name read by an inquiry
+
+#define TRUST_FILES		3
+#define TRUST_JOURNAL	"journal"	// appended to by wl_bluetooth_tool, never closed by the writer
+
+typedef struct trust_dev {
+	uint64_t key;		// the 6 bytes of the address
+	uint8_t flags;
+	const char *paired_name;
+	const char *inq_name;
+} trust_dev;
+
+/*
+ the devices in the order of the files, linkkeys first, so a list is a walk
+ of devs. slots is an open addressing hash of the address to index+1 of
+ devs, 0 for a free slot. A removed device keeps its entry without flags
+ until the next load.
+*/
+typedef struct trust_store {
+	pthread_mutex_t lock;
+	char dir[TRUST_PATH_LENG];	// "" until loaded
+	int loaded;
+	int dirty;			// inotify saw a change of the files
+	int inotify_fd;
+	int wd;				// -1: no watch, every lookup loads the files
+	trust_dev *devs;
+	unsigned int ndevs;
+	unsigned int cap;
+	unsigned int *slots;
+	unsigned int nslots;	// power of 2
+	arena_t names;
+} trust_store;
+
+static const char *trust_files[TRUST_FILES] = {
+	"linkkeys",
+	"paireddevice",
+	"names",
+};
+static const uint8_t trust_file_flag[TRUST_FILES] = {
+	TRUST_LINKKEY,
+	TRUST_PAIRED,
+	TRUST_NAMED,
+};
+
+static trust_store store = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.inotify_fd = -1,
+	.wd = -1,
+};
+static const char *bench_dir = NULL;	// the files of TrustBench() rather than the adaptor
+
+static int HexValue(const char c) {
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// xx:xx:xx:xx:xx:xx at the start of line into key, 0: success, -1: not an address
+static int ParseAddrKey(const char *line, const size_t leng, uint64_t *key) {
+	int i, hi, lo;
+
+	if(leng < TRUST_ADDR_LENG)
+		return -1;
+	*key = 0;
+	for(i = 0; i < 6; i++) {
+		if((hi = HexValue(line[i*3])) < 0 || (lo = HexValue(line[i*3+1])) < 0)
+			return -1;
+		if(i < 5 && line[i*3+2] != ':')
+			return -1;
+		*key = (*key << 8) | (hi << 4) | lo;
+	}
+	return 0;
+}
+
+static void KeyToAddr(const uint64_t key, char *addr) {
+	snprintf(addr, BT_ADDR_LENGTH, "%2.2X:%2.2X:%2.2X:%2.2X:%2.2X:%2.2X",
+		(unsigned int)(key >> 40) & 0xff, (unsigned int)(key >> 32) & 0xff,
+		(unsigned int)(key >> 24) & 0xff, (unsigned int)(key >> 16) & 0xff,
+		(unsigned int)(key >> 8) & 0xff, (unsigned int)key & 0xff);
+}
+
+static unsigned int KeySlot(const uint64_t key, const unsigned int nslots) {
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (nslots - 1);
+}
+
+static trust_dev *FindDev(const uint64_t key) {
+	unsigned int slot;
+
+	if(!store.nslots)
+		return NULL;
+	for(slot = KeySlot(key, store.nslots); store.slots[slot]; slot = (slot + 1) & (store.nslots - 1)) {
+		if(store.devs[store.slots[slot] - 1].key == key)
+			return &store.devs[store.slots[slot] - 1];
+	}
+	return NULL;
+}
+
+// keep the hash at most half full
+static int GrowSlots(const unsigned int ndevs) {
+	unsigned int nslots = store.nslots ? store.nslots : TRUST_MIN_SLOTS;
+	unsigned int *slots, i, slot;
+
+	while(ndevs * 2 > nslots)
+		nslots <<= 1;
+	if(nslots == store.nslots)
+		return 0;
+	if((slots = (unsigned int *)calloc(nslots, sizeof(unsigned int))) == NULL)
+		return -1;
+	for(i = 0; i < store.ndevs; i++) {
+		for(slot = KeySlot(store.devs[i].key, nslots); slots[slot]; slot = (slot + 1) & (nslots - 1))
+			;
+		slots[slot] = i + 1;
+	}
+	free(store.slots);
+	store.slots = slots;
+	store.nslots = nslots;
+	return 0;
+}
+
+static trust_dev *AddDev(const uint64_t key) {
+	trust_dev *dev, *devs;
+	unsigned int slot, cap;
+
+	if((dev = FindDev(key)))
+		return dev;
+	if(store.ndevs == store.cap) {
+		cap = store.cap ? store.cap * 2 : TRUST_MIN_SLOTS / 2;
+		if((devs = (trust_dev *)realloc(store.devs, cap * sizeof(trust_dev))) == NULL)
+			return NULL;
+		store.devs = devs;
+		store.cap = cap;
+	}
+	if(GrowSlots(store.ndevs + 1) < 0)
+		return NULL;
+
+	dev = &store.devs[store.ndevs];
+	memset(dev, 0, sizeof(trust_dev));
+	dev->key = key;
+	for(slot = KeySlot(key, store.nslots); store.slots[slot]; slot = (slot + 1) & (store.nslots - 1))
+		;
+	store.slots[slot] = ++store.ndevs;
+	return dev;
+}
+
+// copy of the name of a line, from after the separator of the address to the end of line
+static const char *CopyName(const char *name, size_t leng) {
+	char *copy;
+
+	while(leng && (name[leng-1] == '\n' || name[leng-1] == '\r'))
+		leng--;
+	if(leng >= BT_NAME_LENGTH)
+		leng = BT_NAME_LENGTH - 1;
+	if((copy = (char *)ArenaAlloc(&store.names, leng + 1)) == NULL)
+		return NULL;
+	memcpy(copy, name, leng);
+	copy[leng] = '\0';
+	return copy;
+}
+
+/***********************************************************************
+* Description:
+* Parse one file of the adaptor into the table. The file is mapped and
+* walked once, every line is "<address><separator><rest>". bluetoothd
+* rewrites its files in place under flock(LOCK_EX), the parse holds
+* LOCK_SH as the textfile readers of bluetoothd do, so the file can't be
+* truncated under the mapping.
+*
+* Calling Arguments:
+* Name			Description
+* dir		the directory of the files, with the trailing '/'
+* index		which of trust_files
+*
+* Return Value:
+* number of devices of the file
+******************************************************************************/
+static int LoadFile(const char *dir, const int index) {
+	char fullpath[TRUST_PATH_LENG] = {};
+	const char *map, *line, *eol, *end;
+	trust_dev *dev;
+	struct stat st;
+	uint64_t key;
+	int fd, count = 0;
+
+	snprintf(fullpath, sizeof(fullpath), "%s%s", dir, trust_files[index]);
+	if((fd = open(fullpath, O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	if(flock(fd, LOCK_SH) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s flock() %s failed %s\n", __FUNCTION__, fullpath, strerror(errno));
+		close(fd);
+		return 0;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size <= 0 ||
+		(map = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);		// the lock goes with the descriptor
+		return 0;
+	}
+
+	end = map + st.st_size;
+	for(line = map; line < end; line = eol + 1) {
+		if((eol = (const char *)memchr(line, '\n', end - line)) == NULL)
+			eol = end;
+		if(ParseAddrKey(line, eol - line, &key) < 0 || (dev = AddDev(key)) == NULL)
+			continue;
+		dev->flags |= trust_file_flag[index];
+		if(trust_file_flag[index] == TRUST_PAIRED && eol - line > TRUST_ADDR_LENG)
+			dev->paired_name = CopyName(line + TRUST_ADDR_LENG + 1, eol - line - TRUST_ADDR_LENG - 1);
+		else if(trust_file_flag[index] == TRUST_NAMED && eol - line > TRUST_ADDR_LENG)
+			dev->inq_name = CopyName(line + TRUST_ADDR_LENG + 1, eol - line - TRUST_ADDR_LENG - 1);
+		count++;
+	}
+	munmap((void *)map, st.st_size);
+	close(fd);
+	return count;
+}
+
+// a record of the journal over paireddevice
+static void ReplayPaired(const char *addr, const char *name, void *arg) {
+	trust_dev *dev;
+	uint64_t key;
+	unsigned int i;
+
+	if(!addr) {
+		for(i = 0; i < store.ndevs; i++)
+			store.devs[i].flags &= ~TRUST_PAIRED;
+		return;
+	}
+	if(ParseAddrKey(addr, strlen(addr), &key) < 0)
+		return;
+	if(!name) {
+		if((dev = FindDev(key)))
+			dev->flags &= ~TRUST_PAIRED;
+	} else if((dev = AddDev(key))) {
+		dev->flags |= TRUST_PAIRED;
+		dev->paired_name = CopyName(name, strlen(name));
+	}
+}
+
+/*
+ watch the directory of the files, changes by bluetoothd and by hand mark the
+ table dirty. The journal is kept open by its writers, its records are only
+ seen by IN_MODIFY.
+*/
+static void WatchDir(const char *dir) {
+	if(store.inotify_fd < 0 && (store.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error: %s inotify_init1() failed %s\n", __FUNCTION__, strerror(errno));
+		return;
+	}
+	if(store.wd >= 0)
+		inotify_rm_watch(store.inotify_fd, store.wd);
+	store.wd = inotify_add_watch(store.inotify_fd, dir,
+		IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF);
+	if(store.wd < 0 && debuglog_enable)
+		debuglog(LOG_INFO, "[libositech_obex.so] %s: no watch on %s (%s), the files are read for every lookup\n", __FUNCTION__, dir, strerror(errno));
+}
+
+// events of the watch so far, without blocking
+static void DrainEvents(void) {
+	char buf[TRUST_EVENT_SIZE * 8] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+	int i;
+
+	while((len = read(store.inotify_fd, buf, sizeof(buf))) > 0) {
+		for(p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if(ev->wd != store.wd)		// a watch dropped by WatchDir()
+				continue;
+			// the directory itself is gone, it is watched again by the next load
+			if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				store.dirty = 1;
+				store.wd = -1;
+				continue;
+			}
+			for(i = 0; ev->len && i < TRUST_FILES; i++) {
+				if(!strcmp(ev->name, trust_files[i]))
+					store.dirty = 1;
+			}
+			if(ev->len && !bench_dir && !strcmp(ev->name, TRUST_JOURNAL))
+				store.dirty = 1;
+		}
+	}
+}
+
+/***********************************************************************
+* Description:
+* Bring the table up to date before a lookup, called with the lock held.
+* The files are read again when the adaptor has changed, when inotify saw
+* a change, or when the directory can't be watched.
+*
+* Calling Arguments:
+* Name			Description
+* none
+*
+* Return Value:
+* none
+******************************************************************************/
+static void TrustSync(void) {
+	char dir[TRUST_PATH_LENG] = {};
+	unsigned long long start;
+	int i, count[TRUST_FILES];
+
+	if(bench_dir)
+		snprintf(dir, sizeof(dir), "%s/", bench_dir);
+	else
+		GetBTFilePath(dir, "");		// STORAGEDIR/<adaptor>/, from memory
+
+	if(store.inotify_fd >= 0 && store.wd >= 0)
+		DrainEvents();
+	if(store.loaded && !store.dirty && store.wd >= 0 && !strcmp(dir, store.dir))
+		return;
+
+	start = StatsNow();
+	if(strcmp(dir, store.dir) || store.wd < 0) {
+		snprintf(store.dir, sizeof(store.dir), "%s", dir);
+		WatchDir(dir);
+	}
+	// drained after the watch is in place, so no change is lost between the two
+	store.dirty = 0;
+	if(store.inotify_fd >= 0 && store.wd >= 0)
+		DrainEvents();
+
+	store.ndevs = 0;
+	if(store.slots)
+		memset(store.slots, 0, store.nslots * sizeof(unsigned int));
+	if(!store.names.base)
+		ArenaInit(&store.names, TRUST_NAMES_SIZE);
+	else
+		ArenaReset(&store.names);
+	for(i = 0; i < TRUST_FILES; i++)
+		count[i] = LoadFile(dir, i);
+	// paireddevice is only brought up to date by the compaction of the journal
+	if(!bench_dir)
+		JournalReplayPaired(ReplayPaired, NULL);
+	store.loaded = 1;
+
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: %s %d linkkeys, %d paired, %d names in %llu us\n", __FUNCTION__,
+		dir, count[0], count[1], count[2], StatsNow() - start);
+}
+
+static trust_dev *LookupDev(const char *addr) {
+	uint64_t key;
+
+	if(!addr || ParseAddrKey(addr, strlen(addr), &key) < 0)
+		return NULL;
+	TrustSync();
+	return FindDev(key);
+}
+
+/***********************************************************************
+* Description:
+* Check if the device has a link key, that is, it is paired.
+*
+* Calling Arguments:
+* Name			Description
+* addr		xx:xx:xx:xx:xx:xx
+*
+* Return Value:
+* 0:	not trusted
+* 1: 	trusted
+******************************************************************************/
+int TrustIsLinked(const char *addr) {
+	trust_dev *dev;
+	int linked;
+
+	pthread_mutex_lock(&store.lock);
+	dev = LookupDev(addr);
+	linked = (dev && (dev->flags & TRUST_LINKKEY)) ? 1 : 0;
+	pthread_mutex_unlock(&store.lock);
+	return linked;
+}
+
+static int CopyOutName(const char *addr, char *name, const int name_leng, const uint8_t flag) {
+	const char *found = NULL;
+	trust_dev *dev;
+
+	pthread_mutex_lock(&store.lock);
+	if((dev = LookupDev(addr)) && (dev->flags & flag))
+		found = (flag == TRUST_PAIRED) ? dev->paired_name : dev->inq_name;
+	if(found)
+		snprintf(name, name_leng, "%s", found);
+	pthread_mutex_unlock(&store.lock);
+	return found ? 0 : -1;
+}
+
+// name of the device in paireddevice, 0: found, -1: not found
+int TrustPairedName(const char *addr, char *name, const int name_leng) {
+	return CopyOutName(addr, name, name_leng, TRUST_PAIRED);
+}
+
+// name of the device in names, 0: found, -1: not found
+int TrustInqName(const char *addr, char *name, const int name_leng) {
+	return CopyOutName(addr, name, name_leng, TRUST_NAMED);
+}
+
+/***********************************************************************
+* Description:
+* Walk the trusted devices in the order of linkkeys. cb is called with
+* the lock held and must not call back into this file.
+*
+* Calling Arguments:
+* Name			Description
+* cb		called with the address and the paired name, NULL if none
+* arg		given to cb
+*
+* Return Value:
+* number of trusted devices
+******************************************************************************/
+int TrustList(trust_list_cb cb, void *arg) {
+	char addr[BT_ADDR_LENGTH];
+	unsigned int i;
+	int count = 0;
+
+	pthread_mutex_lock(&store.lock);
+	TrustSync();
+	for(i = 0; i < store.ndevs; i++) {
+		if(!(store.devs[i].flags & TRUST_LINKKEY))
+			continue;
+		KeyToAddr(store.devs[i].key, addr);
+		cb(addr, (store.devs[i].flags & TRUST_PAIRED) ? store.devs[i].paired_name : NULL, arg);
+		count++;
+	}
+	pthread_mutex_unlock(&store.lock);
+	return count;
+}
+
+/*
+ own writes of the files. The table is changed at once, the inotify events
+ of the write then read the files again before the next lookup.
+*/
+void TrustSetPaired(const char *addr, const char *name) {
+	trust_dev *dev;
+	uint64_t key;
+
+	if(!addr || ParseAddrKey(addr, strlen(addr), &key) < 0)
+		return;
+	pthread_mutex_lock(&store.lock);
+	TrustSync();
+	if((dev = AddDev(key))) {
+		dev->flags |= TRUST_PAIRED;
+		dev->paired_name = CopyName(name, strlen(name));
+	}
+	pthread_mutex_unlock(&store.lock);
+}
+
+void TrustRemove(const char *addr) {
+	trust_dev *dev;
+
+	pthread_mutex_lock(&store.lock);
+	if((dev = LookupDev(addr)))
+		dev->flags &= ~(TRUST_LINKKEY | TRUST_PAIRED);
+	pthread_mutex_unlock(&store.lock);
+}
+
+void TrustRemoveAll(void) {
+	unsigned int i;
+
+	pthread_mutex_lock(&store.lock);
+	TrustSync();
+	for(i = 0; i < store.ndevs; i++)
+		store.devs[i].flags &= ~(TRUST_LINKKEY | TRUST_PAIRED);
+	pthread_mutex_unlock(&store.lock);
+}
+
+static void BenchCount(const char *addr, const char *name, void *arg) {
+	(*(int *)arg)++;
+}
+
+// one lookup of addr the way it was done before, a walk of the file
+static int BenchScan(const char *fullpath, const char *addr) {
+	char read_buff[BT_NAME_LENGTH] = {};
+	FILE *file_stream;
+	int found = 0;
+
+	if((file_stream = fopen(fullpath, "r")) == NULL)
+		return 0;
+	while(!found && fgets(read_buff, sizeof(read_buff), file_stream))
+		found = !strncasecmp(read_buff, addr, TRUST_ADDR_LENG);
+	fclose(file_stream);
+	return found;
+}
+
+static int BenchWrite(const int entries) {
+	char fullpath[TRUST_PATH_LENG];
+	FILE *file_stream[TRUST_FILES];
+	char addr[BT_ADDR_LENGTH];
+	int i, n;
+
+	mkdir(TRUST_BENCH_DIR, 0755);
+	for(i = 0; i < TRUST_FILES; i++) {
+		snprintf(fullpath, sizeof(fullpath), "%s/%s", TRUST_BENCH_DIR, trust_files[i]);
+		if((file_stream[i] = fopen(fullpath, "w")) == NULL) {
+			while(i--)
+				fclose(file_stream[i]);
+			return -1;
+		}
+	}
+	for(n = 0; n < entries; n++) {
+		KeyToAddr(0x001122000000ULL + n, addr);
+		fprintf(file_stream[0], "%s 0123456789ABCDEF0123456789ABCDEF 0 4\n", addr);
+		fprintf(file_stream[1], "%s,Paired device %d\n", addr, n);
+		fprintf(file_stream[2], "%s Device %d\n", addr, n);
+	}
+	for(i = 0; i < TRUST_FILES; i++)
+		fclose(file_stream[i]);
+	return 0;
+}
+
+/***********************************************************************
+* Description:
+* Benchmark of the table. Files of entries/10 and of entries devices are
+* written in TRUST_BENCH_DIR, and for each the load, a lookup, a list and
+* a lookup by a walk of linkkeys are timed. The lookup and the list per
+* device stay the same when the files grow, the walk of the file doesn't.
+*
+* Calling Arguments:
+* Name			Description
+* entries	devices of the bigger files
+*
+* Return Value:
+* 0: success
+* -1: fail
+******************************************************************************/
+int TrustBench(const int entries) {
+	char fullpath[TRUST_PATH_LENG];
+	char addr[BT_ADDR_LENGTH];
+	unsigned long long start, load_us, find_us, list_us, scan_us;
+	int sizes[2], s, n, i, found, listed, scans;
+
+	if(entries < 10)
+		return -1;
+	sizes[0] = entries / 10;
+	sizes[1] = entries;
+	bench_dir = TRUST_BENCH_DIR;
+
+	printf("%8s %10s %12s %12s %12s\n", "devices", "load us", "lookup ns", "list ns/dev", "scan ns");
+	for(s = 0; s < 2; s++) {
+		if(BenchWrite(sizes[s]) < 0) {
+			perror("TrustBench: fopen()");
+			bench_dir = NULL;
+			return -1;
+		}
+
+		pthread_mutex_lock(&store.lock);
+		store.loaded = 0;
+		start = StatsNow();
+		TrustSync();
+		load_us = StatsNow() - start;
+		pthread_mutex_unlock(&store.lock);
+
+		found = 0;
+		start = StatsNow();
+		for(n = 0; n < sizes[1]; n++) {
+			KeyToAddr(0x001122000000ULL + (n % sizes[s]), addr);
+			found += TrustIsLinked(addr);
+		}
+		find_us = StatsNow() - start;
+
+		listed = 0;
+		start = StatsNow();
+		TrustList(BenchCount, &listed);
+		list_us = StatsNow() - start;
+
+		// the walk is slow, a few lookups spread over the file are enough
+		snprintf(fullpath, sizeof(fullpath), "%s/%s", TRUST_BENCH_DIR, trust_files[0]);
+		scans = 16;
+		start = StatsNow();
+		for(i = 0; i < scans; i++) {
+			KeyToAddr(0x001122000000ULL + (unsigned int)(((long long)sizes[s] * i) / scans), addr);
+			BenchScan(fullpath, addr);
+		}
+		scan_us = StatsNow() - start;
+
+		printf("%8d %10llu %12llu %12llu %12llu\n", sizes[s], load_us,
+			find_us * 1000 / sizes[1], list_us * 1000 / sizes[s], scan_us * 1000 / scans);
+		if(found != sizes[1] || listed != sizes[s])
+			printf("TrustBench: %d of %d found, %d of %d listed\n", found, sizes[1], listed, sizes[s]);
+	}
+
+	for(i = 0; i < TRUST_FILES; i++) {
+		snprintf(fullpath, sizeof(fullpath), "%s/%s", TRUST_BENCH_DIR, trust_files[i]);
+		unlink(fullpath);
+	}
+	rmdir(TRUST_BENCH_DIR);
+
+	pthread_mutex_lock(&store.lock);
+	bench_dir = NULL;
+	store.loaded = 0;
+	pthread_mutex_unlock(&store.lock);
+	return 0;
+}
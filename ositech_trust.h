@@ -0,0 +1,31 @@
+/*
+ * This file contains proprietary information and is subject to the terms and
+ * conditions defined in file 'OSILICENSE.txt', which is part of this source
+ * code package.
+ */
+
+  /***********************************************************************
+* Original Author: 		Joe Wei
+* File Creation Date: 	Oct/19/2026
+* Project: 			ositech_obex
+* Description:
+* File Name:			ositech_trust.h
+* Last Modified:
+* Changes:
+**********************************************************************/
+#ifndef __OSITECH_TRUST_H
+#define __OSITECH_TRUST_H
+
+// a device of linkkeys, called for every trusted device by TrustList()
+typedef void (*trust_list_cb)(const char *addr, const char *name, void *arg);
+
+extern int TrustIsLinked(const char *addr);
+extern int TrustPairedName(const char *addr, char *name, const int name_leng);
+extern int TrustInqName(const char *addr, char *name, const int name_leng);
+extern int TrustList(trust_list_cb cb, void *arg);
+extern void TrustSetPaired(const char *addr, const char *name);
+extern void TrustRemove(const char *addr);
+extern void TrustRemoveAll(void);
+extern int TrustBench(const int entries);
+
+#endif
@@ -180,3 +180,144 @@ done:
 		return SDP_NO_CARRIER;
 	}
 }
+
+static sdp_session_t *local_sess = NULL;
+static sdp_record_t *obex_rec = NULL;
+static uint8_t obex_channel = DEFAULT_OBEX_CHANNEL;
+
+/*********************************************************************** 
+* Description:
+* Set the RFCOMM channel of the OBEX File Transfer record and open the
+* session to the local SDP server. The session is kept open, as a record
+* only lives as long as the session that registered it.
+* 
+* Calling Arguments: 
+* Name			Description 
+* channel		the RFCOMM channel of the OBEX service, obex.channel
+*
+* Return Value: 
+* 1: success
+* -1: fail, the channel is out of range or there is no SDP server
+******************************************************************************/
+int SdpLocalConnect(const int channel) {
+	if(channel < OBEX_CHANNEL_MIN || channel > OBEX_CHANNEL_MAX) {
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: RFCOMM channel %d is out of range.\n", __FUNCTION__, channel);
+		return SDP_ERROR;
+	}
+	obex_channel = channel;
+	if(local_sess)
+		return SDP_SUCCESS;
+
+	local_sess = sdp_connect(BDADDR_ANY, BDADDR_LOCAL, SDP_RETRY_IF_BUSY);
+	if(!local_sess) {
+		perror("SdpLocalConnect: sdp_connect() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: Failed to connect to the local SDP server.\n", __FUNCTION__);
+		return SDP_ERROR;
+	}
+	return SDP_SUCCESS;
+}
+
+// the OBEX File Transfer record of the Titan on obex_channel
+static sdp_record_t *BuildObexRecord(void) {
+	uint8_t avail = SDP_SERVICE_AVAILABLE;
+	uuid_t root_uuid, ftp_uuid, l2cap_uuid, rfcomm_uuid, obex_uuid;
+	sdp_profile_desc_t profile;
+	sdp_list_t *root, *svclass, *pfseq, *apseq, *aproto, *proto[3];
+	sdp_data_t *ch;
+	sdp_record_t *rec;
+
+	rec = sdp_record_alloc();
+
+	sdp_uuid16_create(&root_uuid, PUBLIC_BROWSE_GROUP);
+	root = sdp_list_append(0, &root_uuid);
+	sdp_set_browse_groups(rec, root);
+
+	sdp_uuid16_create(&ftp_uuid, OBEX_FILETRANS_SVCLASS_ID);
+	svclass = sdp_list_append(0, &ftp_uuid);
+	sdp_set_service_classes(rec, svclass);
+
+	sdp_uuid16_create(&profile.uuid, OBEX_FILETRANS_PROFILE_ID);
+	profile.version = 0x0100;
+	pfseq = sdp_list_append(0, &profile);
+	sdp_set_profile_descs(rec, pfseq);
+
+	sdp_uuid16_create(&l2cap_uuid, L2CAP_UUID);
+	proto[0] = sdp_list_append(0, &l2cap_uuid);
+	apseq = sdp_list_append(0, proto[0]);
+
+	sdp_uuid16_create(&rfcomm_uuid, RFCOMM_UUID);
+	proto[1] = sdp_list_append(0, &rfcomm_uuid);
+	ch = sdp_data_alloc(SDP_UINT8, &obex_channel);
+	proto[1] = sdp_list_append(proto[1], ch);
+	apseq = sdp_list_append(apseq, proto[1]);
+
+	sdp_uuid16_create(&obex_uuid, OBEX_UUID);
+	proto[2] = sdp_list_append(0, &obex_uuid);
+	apseq = sdp_list_append(apseq, proto[2]);
+
+	aproto = sdp_list_append(0, apseq);
+	sdp_set_access_protos(rec, aproto);
+
+	sdp_set_info_attr(rec, "OBEX File Transfer", 0, 0);
+	sdp_attr_replace(rec, SDP_ATTR_SERVICE_AVAILABILITY, sdp_data_alloc(SDP_UINT8, &avail));
+
+	sdp_data_free(ch);
+	sdp_list_free(proto[0], 0);
+	sdp_list_free(proto[1], 0);
+	sdp_list_free(proto[2], 0);
+	sdp_list_free(apseq, 0);
+	sdp_list_free(aproto, 0);
+	sdp_list_free(pfseq, 0);
+	sdp_list_free(svclass, 0);
+	sdp_list_free(root, 0);
+
+	return rec;
+}
+
+/*********************************************************************** 
+* Description:
+* Advertise the OBEX File Transfer record for the FTP session, or take it
+* away when the session ends. As with add_obex_service/del_obex_service,
+* the record is only in the SDP server during a session, it's just
+* registered over the session kept open instead of by a script.
+* 
+* Calling Arguments: 
+* Name			Description 
+* available		1: register the record, 0: unregister it
+*
+* Return Value: 
+* 1: success
+* -1: fail, no session to the SDP server or the server refused
+******************************************************************************/
+int SetObexServiceAvailable(const int available) {
+	if(!local_sess)
+		return SDP_ERROR;
+
+	if(!available) {
+		if(!obex_rec)
+			return SDP_SUCCESS;
+		// the record is freed with its registration, or here when the server refused
+		if(sdp_device_record_unregister(local_sess, BDADDR_ANY, obex_rec) < 0) {
+			perror("SetObexServiceAvailable: sdp_device_record_unregister() failed");
+			if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: Unregister OBEX FTP service failed.\n", __FUNCTION__);
+			sdp_record_free(obex_rec);
+			obex_rec = NULL;
+			return SDP_ERROR;
+		}
+		obex_rec = NULL;
+		return SDP_SUCCESS;
+	}
+
+	if(obex_rec)
+		return SDP_SUCCESS;
+	obex_rec = BuildObexRecord();
+	if(sdp_device_record_register(local_sess, BDADDR_ANY, obex_rec, 0) < 0) {
+		perror("SetObexServiceAvailable: sdp_device_record_register() failed");
+		if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] Error %s: Register OBEX FTP service failed.\n", __FUNCTION__);
+		sdp_record_free(obex_rec);
+		obex_rec = NULL;
+		return SDP_ERROR;
+	}
+	if(debuglog_enable) debuglog(LOG_INFO, "[libositech_obex.so] %s: OBEX FTP service registered on Channel %d, handle 0x%x\n", __FUNCTION__, obex_channel, obex_rec->handle);
+	return SDP_SUCCESS;
+}
@@ -20,7 +20,14 @@
 #define SDP_NO_CARRIER	-2
 #define SDP_SUCCESS		1
 
+// local OBEX File Transfer record, obex.channel
+#define OBEX_CHANNEL_MIN	1
+#define OBEX_CHANNEL_MAX	30
+#define SDP_SERVICE_AVAILABLE	0xff
+
 extern int GetProfileChannel(const char *addr, int profile, int *res_channel);
 extern int BrowseBTServices(const char *addr, sdp_list_t **seq);
 extern int SearchBTService(const char *addr, int profile, sdp_list_t **seq);
+extern int SdpLocalConnect(const int channel);
+extern int SetObexServiceAvailable(const int available);
 #endif
\ No newline at end of file
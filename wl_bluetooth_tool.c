@@ -13,13 +13,16 @@
 * Last Modified:
 * Changes:
 **********************************************************************/
+#define _FILE_OFFSET_BITS 64	// files beyond 2GB
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -38,6 +41,9 @@
 #include "sdp_op.h"
 #include "rfcomm_op.h"
 #include "ositech_bt.h"
+#include "ositech_fanout.h"
+#include "ositech_trust.h"
+#include "ositech_led.h"
 
 
 #define DEBUG_MSG(fmt, ...) do {\
@@ -52,12 +58,16 @@ struct BTdev_info dev_list;
 static struct help_instruct helps[] = {
 	{"-c", "[BT addr]", "Pairing with the BT"},	
 	{"-f", "[BT addr]", "Start OBEX session to the BT"},
+	{"-F", "[file]", "PUT the file to every BT addr given after the options"},
+	{"-l", "[links]", "OBEX sessions at the same time of -F, 7 at most on BT"},
 	{"-d", "[BT addr]", "Start Service on the remote BT device"},
 	{"-i", 0, "Inquiry remote BT device(s)"},
 	{"-n", "[Friendly Name]", "Set the friendly name of the local BT adaptor"},
 	{"-p", "[Pin code]", "Set Pin code for pairing"},
 	{"-r", "[BT addr]", "Remove the pairing with the BT"},	
 	{"-s", "[BT addr]", "Start SERIAL connection to the BT"},
+	{"-t", "[transport]", "OBEX transport of -f: bt, inet:<host>[:<port>] or fd:<socket>"},
+	{"-T", "[devices]", "Benchmark of the trusted device table with up to the given devices"},
 	{"-h", 0, "Help"},
 	{NULL, NULL, NULL}
 };
@@ -258,45 +268,6 @@ static int ValidBTPin(const char *code) {
 		return 1;
 }
 
-/*********************************************************************** 
-* Description:
-* Check if the give address is matched with the reading
-* 
-* Calling Arguments: 
-* Name			Description 
-* reading		the readings from the file
-* addr		the given bluetoothe device address
-*
-* Return Value: 
-* 0:	fail
-* 1: 	success
-******************************************************************************/
-static int MatchBTAddr(char *reading, const char *addr) {
-//	char string[READ_BUFF_LENG] = {};
-	const char dlim[] = ": ";
-	char *ptok;
-	int addr_index = 0;
-	int addr_len = strlen(addr);
-
-//	snprintf(string, BUFF_SIZE*sizeof(char), "%s", reading);
-	ptok = strtok(reading, dlim);
-	if(!strncmp(ptok, addr, strlen(ptok))) { // compare first 2 value of the address
-		addr_index += strlen(ptok)+1;	// strlen("xx:")
-		while((ptok = strtok(NULL, dlim))) {
-			if(!strncmp(ptok, addr+addr_index, strlen(ptok))) {
-				if(addr_index+strlen(ptok)+1 >= addr_len)
-					break;	
-				else 
-					addr_index += strlen(ptok)+1;
-			} else
-				return 0;	
-		}
-	} else
-		return 0;
-
-	return 1;
-}
-
 // 0 fail
 // 1 success
 /*********************************************************************** 
@@ -311,29 +282,7 @@ static int MatchBTAddr(char *reading, const char *addr) {
 * int		result
 ******************************************************************************/
 static int CheckBTLinkKey(const char *bt_addr) {
-	FILE *file_stream;
-	char read_buff[READ_BUFF_LENG] = {};
-	long int file_size = 0;
-	int found = 0;
-
-	if((file_stream = OpenFile("linkkeys", "r")) == NULL)
-		return 0;
-
-	fseek(file_stream, 0, SEEK_END);
-	file_size = ftell(file_stream);
-	fseek(file_stream, 0, SEEK_SET);
-
-	if (file_size <= 0) 
-		goto end;
-	
-	while(fgets(read_buff, sizeof(read_buff), file_stream)) {
-		if((found=MatchBTAddr(read_buff, bt_addr)))
-			break;
-		memset(read_buff, 0, sizeof(read_buff));
-	}
-end:
-	CloseFile(file_stream);
-	return found;
+	return TrustIsLinked(bt_addr);
 }
 
 static void GetBTServiceClassUUID(void *value, void *userdata)
@@ -369,7 +318,7 @@ static int OBEXOption(obexftp_client_t *cli, const char *pcmd, const char *parg)
 		if(MakeDir(cli, parg) == 1)
 			res = 0;
 	} else if(!strcmp(pcmd, "PUT") || !strcmp(pcmd, "put")) {
-		if(FTPTransFile(cli, parg, FTPFROMFILE, 0) > 0)
+		if(FTPTransFile(cli, parg, FTPFROMFILE, 0, NULL) > 0)
 			res = 0;
 	}else if(!strcmp(pcmd, "DIR") || !strcmp(pcmd, "dir")) {
 		CreateDirXML();
@@ -409,46 +358,47 @@ static int RfcommSendString(const int sr_fd, const char *string) {
 // -1: fail
 // 0: success
 static int RfcommSendFile(const int sr_fd, const char *file) {
-	char read_buff[READ_BUFF_LENG] = {};
-	int fd, file_size, cur_pos;
-	int rd_sz, wr_sz; //wr_pos;
-	int rd_sum, wr_sum;
+	char read_buff[RFCOMM_WRITE_SLICE];
+	struct stat st;
+	off_t rd_sum;
+	int fd, rd_sz, wr_sz, wr_sum;
 	int res = -1;
 
 	if((fd = open(file, O_RDONLY)) < 0) {
 		DEBUG_MSG("open %s failed (%s)\n", file, strerror(errno));
 		return -1;
 	}
-	cur_pos = lseek(fd, 0, SEEK_CUR);
-	file_size = lseek(fd, 0, SEEK_END);
-	lseek(fd, cur_pos, SEEK_SET);
+	if(fstat(fd, &st) < 0) {
+		DEBUG_MSG("fstat %s failed (%s)\n", file, strerror(errno));
+		goto end;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
-	rd_sz = 0;
+	// read, not mapped, so a file truncated while it's sent ends with an error
 	rd_sum = 0;
-	while(rd_sum < file_size) {
-		memset(read_buff, 0, sizeof(read_buff));
-		if((rd_sz = read(fd, read_buff, sizeof(read_buff))) < 0) {
-			DEBUG_MSG("read %s failed (%s)\n", file, strerror(errno));
+	while(rd_sum < st.st_size) {
+		if((rd_sz = read(fd, read_buff, sizeof(read_buff))) <= 0) {
+			if(rd_sz < 0 && errno == EINTR)
+				continue;
+			// 0: the file was truncated while being sent
+			DEBUG_MSG("read %s failed (%s)\n", file, rd_sz ? strerror(errno) : "EOF");
 			goto end;
 		}
 		rd_sum += rd_sz;
-		if(rd_sum == file_size && *(read_buff+rd_sz-1) == 0xa)
-			*(read_buff+rd_sz-1) = '\0';
-		
-		wr_sz = 0;
-//		wr_pos = 0;
+		// the trailing new line of the file is sent as a '\0'
+		if(rd_sum >= st.st_size && read_buff[rd_sz-1] == 0xa)
+			read_buff[rd_sz-1] = '\0';
+
 		wr_sum = 0;
-		while(wr_sum < rd_sz) {	// keep writing till all sent or error
-		//	if((wr_sz = write(sr_fd, read_buff+wr_pos, rd_sz-wr_pos)) < 0) {
+		while(wr_sum < rd_sz) {	// keep writing till all sent or error, one RFCOMM frame at most
 			if((wr_sz = write(sr_fd, read_buff+wr_sum, rd_sz-wr_sum)) < 0) {
+				if(errno == EINTR)
+					continue;
 				DEBUG_MSG("write to rfcomm0 failed (%s)\n", strerror(errno));
 				goto end;
 			}
-		
 			wr_sum += wr_sz;
-//			wr_pos = rd_sz - wr_sum;
 		}
-//		rd_sum += rd_sz;
 	}
 	
 	res = 0;
@@ -829,12 +779,13 @@ static int BTToolStart_OBEX(const char *bt_addr, char *obex_cmd) {
 	char *pcmd = NULL;
 	char *parg = NULL;
 
-	if(!CheckBTLinkKey(bt_addr)) {
+	if(!ObexTransportIsBT()) {
+		DEBUG_MSG("%s\n", "OBEX peer is not on Bluetooth, skip pairing and SDP");
+		channel = 0;
+	} else if(!CheckBTLinkKey(bt_addr)) {
 		DEBUG_MSG("%s is NOT paried\n", bt_addr);
 		return -1;
-	}
-	
-	if(SearchBTwithObex(bt_addr, &channel) < 0) {
+	} else if(SearchBTwithObex(bt_addr, &channel) < 0) {
 		DEBUG_MSG("NO OBEX service found on %s\n", bt_addr);
 		goto end;
 	} else
@@ -877,6 +828,42 @@ end:
 	return res;
 }
 
+// -1: fail
+// 	0: success, every peer got the file
+static int BTToolStart_Fanout(const char *file, char *addrs[], const int naddrs, const int max_links) {
+	fanout_result results[FANOUT_MAX_PEERS];
+	int npeers = 0, index, res;
+
+	memset(results, 0, sizeof(results));
+	for(index = 0; index < naddrs; index++) {
+		if(npeers == FANOUT_MAX_PEERS) {
+			DEBUG_MSG("more than %d peers, %s and the rest are left out\n", FANOUT_MAX_PEERS, addrs[index]);
+			break;
+		}
+		if(ObexTransportIsBT() && !CheckBTLinkKey(addrs[index])) {
+			DEBUG_MSG("%s is NOT paried\n", addrs[index]);
+			printf("[BT_tool] %s -- Fail (not paired)\n", addrs[index]);
+			continue;
+		}
+		snprintf(results[npeers].addr, sizeof(results[npeers].addr), "%s", addrs[index]);
+		npeers++;
+	}
+	if(!npeers)
+		return -1;
+
+	if((res = FanoutPut(file, results, npeers, max_links)) < 0) {
+		DEBUG_MSG("CANNOT read %s\n", file);
+		return -1;
+	}
+
+	for(index = 0; index < npeers; index++)
+		printf("[BT_tool] %s -- %s (%s, %u ms)\n", results[index].addr, (results[index].res > 0)?"Success":"Fail",
+			FanoutStageString(results[index].stage), results[index].ms);
+	DEBUG_MSG("%d of %d peers got %s\n", res, npeers, file);
+
+	return (res == naddrs) ? 0 : -1;
+}
+
 // -1: fail
 // 	0: success
 static int BTToolStart_Serial(const char *bt_addr, char *serial_option, int testbed) {
@@ -922,6 +909,9 @@ int main(int argc, char *argv[]) {
 	uint8_t bt_inq = 0;
 	uint8_t service_inq = 0;
 	uint8_t start_obex = 0;
+	uint8_t start_fanout = 0;
+	char fanout_file[CMD_LENG];
+	int fanout_links = 0;
 	uint8_t start_serial = 0;
 	uint8_t testbed = 0;
 	uint8_t rm_dev = 0;
@@ -930,6 +920,7 @@ int main(int argc, char *argv[]) {
 	memset(bt_addr, 0, sizeof(bt_addr));
 	memset(pin_code, 0, sizeof(pin_code));
 	memset(bt_friendly_name, 0, sizeof(bt_friendly_name));
+	memset(fanout_file, 0, sizeof(fanout_file));
 
 	memset(&dev_list, 0, sizeof(dev_list));
 	
@@ -938,8 +929,9 @@ int main(int argc, char *argv[]) {
 		exit(1);
 	}
 	if(DEBUGLOG) debuglog_enable = 1;
+	LedInit(LED_BACKEND_EXEC, NULL);
 	
-	while((opt = getopt(argc, argv, "c:d:f:hip:s:n:r:"))  != -1) {
+	while((opt = getopt(argc, argv, "c:d:f:F:hil:p:s:n:r:t:T:"))  != -1) {
 		switch(opt) {
 			case 'c':
 				strcpy(bt_addr, optarg);
@@ -956,6 +948,14 @@ int main(int argc, char *argv[]) {
 				DEBUG_MSG("OBEX connection with BT address %s\n", bt_addr);
 				start_obex = 1;
 				break;
+			case 'F':
+				snprintf(fanout_file, sizeof(fanout_file), "%s", optarg);
+				DEBUG_MSG("PUT %s to many BT peers\n", fanout_file);
+				start_fanout = 1;
+				break;
+			case 'l':
+				fanout_links = atoi(optarg);
+				break;
 			case 'i':
 				DEBUG_MSG("%s\n", "Inquiry BT peers in the range.");
 				bt_inq = 1;
@@ -977,6 +977,13 @@ int main(int argc, char *argv[]) {
 				DEBUG_MSG("Remove BT device %s\n", bt_addr);
 				rm_dev = 1;
 				break;
+			case 't':
+				DEBUG_MSG("OBEX transport %s\n", optarg);
+				if(ObexSetTransport(optarg) < 0)
+					exit(1);
+				break;
+			case 'T':
+				exit(TrustBench(atoi(optarg)) < 0 ? 1 : 0);
 			case 's':
 				strcpy(bt_addr, optarg);
 				DEBUG_MSG("Serial connection with BT address %s\n", bt_addr);
@@ -1088,6 +1095,30 @@ int main(int argc, char *argv[]) {
 		goto done;
 	}
 
+	if(start_fanout) {
+		int index;
+
+		printf("[BT_tool] Start OBEX PUT of %s to %d peers.\n", fanout_file, argc - optind);
+		led_org = GetCurBTLed();
+		SetBTLed(BT_LED_SOLID);
+
+		for(index = optind; index < argc; index++) {
+			if(ObexTransportIsBT() && !ValidBTAddr(argv[index])) {
+				if(DEBUGLOG) debuglog(LOG_INFO, "[BT_tool] %s: BT address %s is invalid\n", __FUNCTION__, argv[index]);
+				break;
+			}
+		}
+		if(optind >= argc || index < argc)
+			printf("[BT_tool] Done OBEX PUT -- Fail\n");
+		else if(!BTToolStart_Fanout(fanout_file, &argv[optind], argc - optind, fanout_links))
+			printf("[BT_tool] Done OBEX PUT -- Success\n");
+		else
+			printf("[BT_tool] Done OBEX PUT -- Fail\n");
+
+		SetBTLed(led_org);
+		goto done;
+	}
+
 	if(start_serial) {
 		char *serial_option;
 		int option_leng = 0, index;
@@ -30,6 +30,7 @@
 #define READ_BUFF_LENG STRING_LENG*4
 #define UUID_LENGTH 	STRING_LENG*2
 #define CMD_LENG		STRING_LENG*4
+#define RFCOMM_WRITE_SLICE	1013	// one RFCOMM frame at the usual negotiated MTU
 
 #define WL_PINCODE_FILE	"/tmp/BT_pincode"
 #define BT_PEERS_PROFILES_CSV_FILE		"/tmp/BT_peer_profiles.csv"